@@ -0,0 +1,129 @@
+/*
+ * cache
+ *
+ * On-disk stage cache (see cache.h)
+ *
+ * License: Apache
+ */
+
+// standard headers
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <vector>
+
+// POSIX headers
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+// VTK headers
+#include "vtkXMLPolyDataReader.h"
+
+#include "cache.h"
+#include "vtp_writer.h"
+
+using namespace std;
+
+// FNV-1a, 64 bits
+static const uint64_t FNV_OFFSET = 14695981039346656037ULL;
+static const uint64_t FNV_PRIME = 1099511628211ULL;
+
+static uint64_t fnv1a(uint64_t hash, const unsigned char *p, size_t n) {
+	for (size_t i = 0; i < n; i++) {
+		hash ^= p[i];
+		hash *= FNV_PRIME;
+	}
+	return hash;
+}
+
+// whole 8-byte words at a time for the bulk of the file (byte by byte would take seconds per GB)
+static uint64_t fnv1a_words(uint64_t hash, const unsigned char *p, size_t n) {
+	size_t words = n / 8;
+	for (size_t w = 0; w < words; w++) {
+		uint64_t v;
+		memcpy(&v, p + 8 * w, 8);
+		hash ^= v;
+		hash *= FNV_PRIME;
+	}
+	return fnv1a(hash, p + 8 * words, n - 8 * words);
+}
+
+int cache_hash_file(const string& fn, uint64_t& hash) {
+	FILE *in = fopen(fn.c_str(), "rb");
+	if (in == NULL) {
+		cerr << "Unable to read '" << fn << "': " << strerror(errno) << endl;
+		return -1;
+	}
+	// chunks are a multiple of 8 bytes so words line up the same whatever the file size
+	vector<unsigned char> buffer(1 << 22);
+	uint64_t size = 0;
+	hash = FNV_OFFSET;
+	size_t n;
+	while ((n = fread(&buffer[0], 1, buffer.size(), in)) > 0) {
+		hash = fnv1a_words(hash, &buffer[0], n);
+		size += n;
+	}
+	int failed = ferror(in);
+	fclose(in);
+	if (failed) {
+		cerr << "Unable to read '" << fn << "'" << endl;
+		return -1;
+	}
+	hash = fnv1a(hash, reinterpret_cast<const unsigned char *>(&size), sizeof(size));
+	return 0;
+}
+
+string cache_key(const string& description) {
+	uint64_t hash = fnv1a(FNV_OFFSET, reinterpret_cast<const unsigned char *>(description.data()), description.size());
+	ostringstream key;
+	key << hex << setw(16) << setfill('0') << hash;
+	return key.str();
+}
+
+static string cache_file(const string& dir, const string& key) {
+	return dir + "/" + key + ".vtp";
+}
+
+vtkSmartPointer<vtkPolyData> cache_load(const string& dir, const string& key) {
+	string fn = cache_file(dir, key);
+	struct stat st;
+	if (stat(fn.c_str(), &st) != 0)
+		return NULL;
+	vtkSmartPointer<vtkXMLPolyDataReader> reader = vtkSmartPointer<vtkXMLPolyDataReader>::New();
+	if (!reader->CanReadFile(fn.c_str()))
+		return NULL;
+	reader->SetFileName(fn.c_str());
+	reader->Update();
+	if (reader->GetErrorCode() != 0)
+		return NULL;
+	vtkSmartPointer<vtkPolyData> mesh = vtkSmartPointer<vtkPolyData>::New();
+	mesh->ShallowCopy(reader->GetOutput());
+	return mesh;
+}
+
+int cache_store(const string& dir, const string& key, vtkPolyData *mesh) {
+	if (mkdir(dir.c_str(), 0777) != 0 && errno != EEXIST) {
+		cerr << "Unable to create cache directory '" << dir << "': " << strerror(errno) << endl;
+		return -1;
+	}
+	// raw arrays are the quickest to write and read back
+	struct vtp_options opts;
+	opts.compressor = "none";
+	string fn = cache_file(dir, key);
+	ostringstream tmp;
+	tmp << fn << ".tmp" << getpid();
+	if (vtp_write(mesh, tmp.str(), opts) != 0) {
+		remove(tmp.str().c_str());
+		return -1;
+	}
+	if (rename(tmp.str().c_str(), fn.c_str()) != 0) {
+		cerr << "Unable to write '" << fn << "': " << strerror(errno) << endl;
+		remove(tmp.str().c_str());
+		return -1;
+	}
+	return 0;
+}
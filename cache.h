@@ -0,0 +1,37 @@
+/*
+ * cache
+ *
+ * Persistent on-disk cache of the meshes of each pipeline stage, keyed by
+ * the content of the map and the options that determine the stage, so that
+ * later runs resume from the deepest stage already computed
+ *
+ * License: Apache
+ */
+
+#ifndef MESHMAKER_CACHE_H
+#define MESHMAKER_CACHE_H
+
+// standard headers
+#include <cstdint>
+#include <string>
+
+// VTK headers
+#include "vtkSmartPointer.h"
+#include "vtkPolyData.h"
+
+// a 64-bit hash of the size and contents of the file fn; returns 0 on success, otherwise prints the
+// reason and returns -1
+int cache_hash_file(const std::string& fn, uint64_t& hash);
+
+// the cache key (16 hex digits) of a description of everything a stage's output depends on
+std::string cache_key(const std::string& description);
+
+// the mesh stored under key in dir, or NULL if there is none (or it cannot be read)
+vtkSmartPointer<vtkPolyData> cache_load(const std::string& dir, const std::string& key);
+
+// store mesh under key in dir (created if need be) as raw appended VTP; the file appears atomically
+// so that concurrent runs never see part of it. Returns 0 on success, otherwise prints the reason
+// and returns -1
+int cache_store(const std::string& dir, const std::string& key, vtkPolyData *mesh);
+
+#endif
@@ -0,0 +1,193 @@
+/*
+ * components
+ *
+ * Parallel union-find component filter (see components.h)
+ *
+ * License: Apache
+ */
+
+// standard headers
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+// VTK headers
+#include "vtkCellArray.h"
+#include "vtkCellData.h"
+#include "vtkFieldData.h"
+#include "vtkPointData.h"
+#include "vtkPoints.h"
+#include "vtkSMPTools.h"
+
+#include "components.h"
+#include "pool.h"
+
+using namespace std;
+
+// the root of x, halving the path on the way (other threads may be linking roots meanwhile)
+static vtkIdType find_root(pool_vector<atomic<vtkIdType> >& parent, vtkIdType x) {
+	for (;;) {
+		vtkIdType p = parent[x].load(memory_order_relaxed);
+		if (p == x)
+			return x;
+		vtkIdType gp = parent[p].load(memory_order_relaxed);
+		if (gp != p)
+			parent[x].compare_exchange_weak(p, gp, memory_order_relaxed);
+		x = gp;
+	}
+}
+
+// link the roots of a and b, always the higher under the lower so that the result is the same
+// whichever thread wins; a root that has been linked meanwhile is looked up again
+static void unite(pool_vector<atomic<vtkIdType> >& parent, vtkIdType a, vtkIdType b) {
+	for (;;) {
+		a = find_root(parent, a);
+		b = find_root(parent, b);
+		if (a == b)
+			return;
+		if (a < b)
+			swap(a, b);
+		vtkIdType expected = a;
+		if (parent[a].compare_exchange_strong(expected, b, memory_order_relaxed))
+			return;
+	}
+}
+
+vtkSmartPointer<vtkPolyData> filter_components(vtkPolyData *mesh, const struct component_filter& filter, vtkIdType& ncomponents, vtkIdType& nkept,
+		const vector<unsigned short> *groups) {
+	vtkIdType npts = mesh->GetNumberOfPoints();
+	vtkCellArray *polys = mesh->GetPolys();
+	vtkIdType npolys = polys->GetNumberOfCells();
+
+	// points of each polygon (CSR)
+	pool_vector<vtkIdType> offsets(1, 0), conn;
+	offsets.reserve(npolys + 1);
+	conn.reserve(polys->GetNumberOfConnectivityIds());
+	vtkIdType n;
+	const vtkIdType *pts;
+	for (polys->InitTraversal(); polys->GetNextCell(n, pts);) {
+		conn.insert(conn.end(), pts, pts + n);
+		offsets.push_back(conn.size());
+	}
+
+	pool_vector<atomic<vtkIdType> > parent(npts);
+	auto init = [&](vtkIdType first, vtkIdType last) {
+		for (vtkIdType p = first; p < last; p++)
+			parent[p].store(p, memory_order_relaxed);
+	};
+	vtkSMPTools::For(0, npts, init);
+	auto join = [&](vtkIdType first, vtkIdType last) {
+		for (vtkIdType c = first; c < last; c++)
+			for (vtkIdType k = offsets[c] + 1; k < offsets[c + 1]; k++)
+				unite(parent, conn[offsets[c]], conn[k]);
+	};
+	vtkSMPTools::For(0, npolys, join);
+	pool_vector<vtkIdType> root(npts);
+	auto flatten = [&](vtkIdType first, vtkIdType last) {
+		for (vtkIdType p = first; p < last; p++)
+			root[p] = find_root(parent, p);
+	};
+	vtkSMPTools::For(0, npts, flatten);
+
+	// polygons and enclosed volume (sum of the signed volumes of the tetrahedra from the origin to
+	// each triangle of a fan) of each component, numbered by their roots
+	pool_vector<vtkIdType> component(npts, -1);
+	vector<vtkIdType> sizes;
+	vector<unsigned short> group; // of each component
+	vector<double> volumes;
+	vtkPoints *points = mesh->GetPoints();
+	for (vtkIdType c = 0; c < npolys; c++) {
+		if (offsets[c + 1] == offsets[c])
+			continue;
+		vtkIdType r = root[conn[offsets[c]]];
+		if (component[r] < 0) {
+			component[r] = sizes.size();
+			sizes.push_back(0);
+			group.push_back(groups != NULL ? (*groups)[r] : 0);
+			volumes.push_back(0.0);
+		}
+		vtkIdType id = component[r];
+		sizes[id]++;
+		if (filter.min_volume > 0) {
+			double x0[3], x1[3], x2[3];
+			points->GetPoint(conn[offsets[c]], x0);
+			for (vtkIdType k = offsets[c] + 1; k + 1 < offsets[c + 1]; k++) {
+				points->GetPoint(conn[k], x1);
+				points->GetPoint(conn[k + 1], x2);
+				volumes[id] += (x0[0] * (x1[1] * x2[2] - x1[2] * x2[1]) - x0[1] * (x1[0] * x2[2] - x1[2] * x2[0])
+					+ x0[2] * (x1[0] * x2[1] - x1[1] * x2[0])) / 6.0;
+			}
+		}
+	}
+	ncomponents = sizes.size();
+
+	vector<unsigned char> keep(ncomponents, 0);
+	// (group, -polygons, component) so that the largest of each group come first
+	vector<pair<unsigned short, pair<vtkIdType, vtkIdType> > > ranked;
+	for (vtkIdType id = 0; id < ncomponents; id++)
+		if (sizes[id] >= filter.min_polys && fabs(volumes[id]) >= filter.min_volume)
+			ranked.push_back(make_pair(group[id], make_pair(-sizes[id], id)));
+	sort(ranked.begin(), ranked.end());
+	nkept = 0;
+	for (size_t r = 0, rank = 0; r < ranked.size(); r++) {
+		rank = r > 0 && ranked[r].first == ranked[r - 1].first ? rank + 1 : 0;
+		if (filter.largest > 0 && (vtkIdType)rank >= filter.largest)
+			continue;
+		keep[ranked[r].second.second] = 1;
+		nkept++;
+	}
+
+	// the kept polygons with their points renumbered in order
+	pool_vector<vtkIdType> new_id(npts, -1), old_id;
+	vector<vtkIdType> kept_cells;
+	vtkIdType nconn = 0;
+	for (vtkIdType c = 0; c < npolys; c++) {
+		if (offsets[c + 1] == offsets[c] || !keep[component[root[conn[offsets[c]]]]])
+			continue;
+		for (vtkIdType k = offsets[c]; k < offsets[c + 1]; k++) {
+			vtkIdType p = conn[k];
+			if (new_id[p] < 0) {
+				new_id[p] = old_id.size();
+				old_id.push_back(p);
+			}
+		}
+		kept_cells.push_back(c);
+		nconn += offsets[c + 1] - offsets[c];
+	}
+	vtkTypeInt64 *out_offsets, *out_conn;
+	vtkSmartPointer<vtkCellArray> out_polys = pool_cells(kept_cells.size(), nconn, out_offsets, out_conn);
+	out_offsets[0] = 0;
+	for (size_t c = 0; c < kept_cells.size(); c++) {
+		vtkIdType in = kept_cells[c], n = offsets[in + 1] - offsets[in];
+		out_offsets[c + 1] = out_offsets[c] + n;
+		for (vtkIdType k = 0; k < n; k++)
+			out_conn[out_offsets[c] + k] = new_id[conn[offsets[in] + k]];
+	}
+
+	vtkSmartPointer<vtkPolyData> output = vtkSmartPointer<vtkPolyData>::New();
+	vtkSmartPointer<vtkPoints> out_points = pool_points(points->GetDataType(), old_id.size());
+	auto move = [&](vtkIdType first, vtkIdType last) {
+		double x[3];
+		for (vtkIdType p = first; p < last; p++) {
+			points->GetPoint(old_id[p], x);
+			out_points->SetPoint(p, x);
+		}
+	};
+	vtkSMPTools::For(0, (vtkIdType)old_id.size(), move);
+	output->SetPoints(out_points);
+	output->SetPolys(out_polys);
+	output->GetFieldData()->PassData(mesh->GetFieldData());
+	output->GetPointData()->CopyAllocate(mesh->GetPointData(), old_id.size());
+	for (size_t p = 0; p < old_id.size(); p++)
+		output->GetPointData()->CopyData(mesh->GetPointData(), old_id[p], p);
+	// polygons come after verts and lines in cell ids
+	if (mesh->GetCellData()->GetNumberOfArrays() > 0) {
+		vtkIdType first_poly = mesh->GetNumberOfVerts() + mesh->GetNumberOfLines();
+		output->GetCellData()->CopyAllocate(mesh->GetCellData(), kept_cells.size());
+		for (size_t c = 0; c < kept_cells.size(); c++)
+			output->GetCellData()->CopyData(mesh->GetCellData(), first_poly + kept_cells[c], c);
+	}
+	return output;
+}
@@ -0,0 +1,34 @@
+/*
+ * components
+ *
+ * Connected components of a surface from a lock-free parallel union-find
+ * over the points of its polygons, to drop small disconnected islands
+ *
+ * License: Apache
+ */
+
+#ifndef MESHMAKER_COMPONENTS_H
+#define MESHMAKER_COMPONENTS_H
+
+// standard headers
+#include <vector>
+
+// VTK headers
+#include "vtkSmartPointer.h"
+#include "vtkPolyData.h"
+
+struct component_filter {
+	vtkIdType largest = 0; // keep only this many of the components with the most polygons (if > 0)
+	vtkIdType min_polys = 0; // drop components of fewer polygons
+	double min_volume = 0.0; // drop components that enclose less (by the divergence theorem, so only approximate for open components)
+};
+
+// the polygons of mesh (with their points compacted) in the components that pass filter; components
+// are sets of polygons connected through shared points. If groups is given (one per point, e.g. the
+// contour level of each point of a multi-level surface) the largest components are ranked within
+// each group. Other cells are dropped; ncomponents and nkept are set to the number of components
+// found and kept
+vtkSmartPointer<vtkPolyData> filter_components(vtkPolyData *mesh, const struct component_filter& filter, vtkIdType& ncomponents, vtkIdType& nkept,
+		const std::vector<unsigned short> *groups = NULL);
+
+#endif
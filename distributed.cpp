@@ -0,0 +1,192 @@
+/*
+ * distributed
+ *
+ * MPI ranks and the gathering of their pieces (see distributed.h)
+ *
+ * License: Apache
+ */
+
+// standard headers
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <stdexcept>
+
+// VTK headers
+#include "vtkXMLPolyDataReader.h"
+
+#ifdef MESHMAKER_WITH_MPI
+#include <mpi.h>
+#endif
+
+#include "distributed.h"
+#include "vtp_writer.h"
+
+using namespace std;
+
+#ifdef MESHMAKER_WITH_MPI
+// messages are counted in ints, so long strings go in parts
+static const size_t PART = (size_t)1 << 30;
+static const int TAG_SIZE = 1, TAG_PART = 2;
+
+// e.g. in a host of libmeshmaker that does not use MPI itself
+static int mpi_running(void) {
+	int initialized, finalized;
+	MPI_Initialized(&initialized);
+	MPI_Finalized(&finalized);
+	return initialized && !finalized;
+}
+#endif
+
+int distributed_available(void) {
+#ifdef MESHMAKER_WITH_MPI
+	return 1;
+#else
+	return 0;
+#endif
+}
+
+void distributed_init(int *argc, char ***argv) {
+#ifdef MESHMAKER_WITH_MPI
+	int provided;
+	MPI_Init_thread(argc, argv, MPI_THREAD_FUNNELED, &provided);
+#else
+	(void)argc;
+	(void)argv;
+#endif
+}
+
+void distributed_finalize(void) {
+#ifdef MESHMAKER_WITH_MPI
+	if (mpi_running())
+		MPI_Finalize();
+#endif
+}
+
+void distributed_abort(int code) {
+#ifdef MESHMAKER_WITH_MPI
+	if (mpi_running())
+		MPI_Abort(MPI_COMM_WORLD, code);
+#endif
+	exit(code);
+}
+
+int distributed_rank(void) {
+	int rank = 0;
+#ifdef MESHMAKER_WITH_MPI
+	if (mpi_running())
+		MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+#endif
+	return rank;
+}
+
+int distributed_size(void) {
+	int size = 1;
+#ifdef MESHMAKER_WITH_MPI
+	if (mpi_running())
+		MPI_Comm_size(MPI_COMM_WORLD, &size);
+#endif
+	return size;
+}
+
+vector<string> distributed_gather(const string& mine) {
+	vector<string> all;
+	int rank = distributed_rank(), size = distributed_size();
+	if (rank == 0)
+		all.push_back(mine);
+#ifdef MESHMAKER_WITH_MPI
+	// rank 0 takes the strings one rank at a time, so that it holds no more than it is given
+	if (rank != 0) {
+		unsigned long long n = mine.size();
+		MPI_Send(&n, 1, MPI_UNSIGNED_LONG_LONG, 0, TAG_SIZE, MPI_COMM_WORLD);
+		for (size_t at = 0; at < mine.size(); at += PART)
+			MPI_Send(const_cast<char *>(mine.data()) + at, (int)min(PART, mine.size() - at), MPI_BYTE, 0, TAG_PART, MPI_COMM_WORLD);
+		return all;
+	}
+	all.resize(size);
+	for (int r = 1; r < size; r++) {
+		unsigned long long n;
+		MPI_Recv(&n, 1, MPI_UNSIGNED_LONG_LONG, r, TAG_SIZE, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+		all[r].resize((size_t)n);
+		for (size_t at = 0; at < all[r].size(); at += PART)
+			MPI_Recv(&all[r][at], (int)min(PART, all[r].size() - at), MPI_BYTE, r, TAG_PART, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+	}
+#else
+	(void)size;
+#endif
+	return all;
+}
+
+int distributed_encode_mesh(vtkPolyData *mesh, string& vtp) {
+	char *data = NULL;
+	size_t n = 0;
+	FILE *out = open_memstream(&data, &n);
+	if (out == NULL)
+		return -1;
+	struct vtp_options opts;
+	opts.compressor = "none";
+	opts.uint64 = 1;
+	int failed = vtp_write(mesh, out, "the piece of this rank", opts);
+	if (fclose(out) != 0)
+		failed = -1;
+	if (!failed)
+		vtp.assign(data, n);
+	free(data);
+	return failed;
+}
+
+vtkSmartPointer<vtkPolyData> distributed_decode_mesh(const string& vtp) {
+	vtkSmartPointer<vtkXMLPolyDataReader> reader = vtkSmartPointer<vtkXMLPolyDataReader>::New();
+	reader->ReadFromInputStringOn();
+	reader->SetInputString(vtp);
+	reader->Update();
+	if (reader->GetErrorCode() != 0)
+		return NULL;
+	vtkSmartPointer<vtkPolyData> mesh = vtkSmartPointer<vtkPolyData>::New();
+	mesh->ShallowCopy(reader->GetOutput());
+	return mesh;
+}
+
+vector<vtkSmartPointer<vtkPolyData> > distributed_gather_meshes(vtkPolyData *mine) {
+	int rank = distributed_rank();
+	// rank 0 keeps its own mesh as it is
+	string vtp;
+	if (rank != 0 && distributed_encode_mesh(mine, vtp) != 0)
+		throw runtime_error("unable to send the piece of this rank");
+	vector<string> pieces = distributed_gather(vtp);
+	vector<vtkSmartPointer<vtkPolyData> > meshes;
+	for (size_t r = 0; r < pieces.size(); r++) {
+		if (r == 0) {
+			meshes.push_back(mine);
+			continue;
+		}
+		vtkSmartPointer<vtkPolyData> mesh = distributed_decode_mesh(pieces[r]);
+		if (mesh == NULL) {
+			ostringstream reason;
+			reason << "unable to read the piece of rank " << r;
+			throw runtime_error(reason.str());
+		}
+		meshes.push_back(mesh);
+		// the mesh has its own copy of the arrays
+		string().swap(pieces[r]);
+	}
+	return meshes;
+}
+
+int distributed_write_index(const string& fn, const vector<string>& pieces, vtkPolyData *mine) {
+	vector<string> arrays = distributed_gather(pvtp_arrays(mine));
+	if (distributed_rank() != 0)
+		return 0;
+	string summary;
+	for (size_t r = 0; r < arrays.size() && summary.empty(); r++)
+		summary = arrays[r];
+	// the pieces are next to the index
+	vector<string> names(pieces);
+	for (size_t r = 0; r < names.size(); r++) {
+		size_t slash = names[r].find_last_of("/\\");
+		if (slash != string::npos)
+			names[r] = names[r].substr(slash + 1);
+	}
+	return pvtp_write(fn, names, summary);
+}
@@ -0,0 +1,58 @@
+/*
+ * distributed
+ *
+ * The ranks of an MPI run (with -DMESHMAKER_WITH_MPI=ON), each meshing its
+ * own slab of a map, and the gathering of their pieces on rank 0. Built
+ * without MPI there is a single rank and nothing to gather
+ *
+ * License: Apache
+ */
+
+#ifndef MESHMAKER_DISTRIBUTED_H
+#define MESHMAKER_DISTRIBUTED_H
+
+// standard headers
+#include <string>
+#include <vector>
+
+// VTK headers
+#include "vtkSmartPointer.h"
+#include "vtkPolyData.h"
+
+// whether meshmaker was built with MPI
+int distributed_available(void);
+
+// start MPI for the main thread's use (the SMP threads never call it); does nothing without MPI
+void distributed_init(int *argc, char ***argv);
+
+// stop MPI once every rank is done
+void distributed_finalize(void);
+
+// end the run on every rank with code; the other ranks would otherwise wait for this one forever
+void distributed_abort(int code);
+
+// this rank (0 without MPI) and the number of ranks (1 without MPI)
+int distributed_rank(void);
+int distributed_size(void);
+
+// the strings of all ranks in rank order on rank 0, nothing on the others; every rank must call it.
+// Strings may be larger than 2 GB
+std::vector<std::string> distributed_gather(const std::string& mine);
+
+// mesh as the raw appended VTP that distributed_gather_meshes() sends; returns 0, otherwise prints the
+// reason and returns -1
+int distributed_encode_mesh(vtkPolyData *mesh, std::string& vtp);
+
+// the mesh of a VTP from distributed_encode_mesh(), or NULL if it cannot be read
+vtkSmartPointer<vtkPolyData> distributed_decode_mesh(const std::string& vtp);
+
+// the meshes of all ranks in rank order on rank 0 (sent as raw VTP), nothing on the others; every rank
+// must call it. Throws std::runtime_error if a mesh cannot be sent or received
+std::vector<vtkSmartPointer<vtkPolyData> > distributed_gather_meshes(vtkPolyData *mine);
+
+// write fn on rank 0, the .pvtp index of the VTP pieces (one per rank, in the same directory as fn)
+// declaring the arrays of the first piece with any points, given each rank's own piece mine; every rank
+// must call it. Returns 0 on success (and on the other ranks), otherwise prints the reason and returns -1
+int distributed_write_index(const std::string& fn, const std::vector<std::string>& pieces, vtkPolyData *mine);
+
+#endif
@@ -0,0 +1,370 @@
+/*
+ * glb_writer
+ *
+ * Parallel binary glTF writer (see glb_writer.h)
+ *
+ * License: Apache
+ */
+
+// standard headers
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+// VTK headers
+#include "vtkCellArray.h"
+#include "vtkCellData.h"
+#include "vtkDataArray.h"
+#include "vtkFieldData.h"
+#include "vtkFloatArray.h"
+#include "vtkPointData.h"
+#include "vtkPoints.h"
+#include "vtkShortArray.h"
+#include "vtkSMPTools.h"
+#include "vtkUnsignedShortArray.h"
+
+#include "glb_writer.h"
+#include "normals.h"
+
+using namespace std;
+
+// 12-byte header (magic, version, length), then chunks of a length, a type and data padded to 4 bytes
+static const uint32_t GLB_MAGIC = 0x46546C67; // "glTF"
+static const uint32_t GLB_JSON = 0x4E4F534A; // "JSON"
+static const uint32_t GLB_BIN = 0x004E4942; // "BIN\0"
+
+// glTF component types and buffer view targets
+static const int GL_SHORT = 5122, GL_UNSIGNED_SHORT = 5123, GL_UNSIGNED_INT = 5125, GL_FLOAT = 5126;
+static const int GL_ARRAY_BUFFER = 34962, GL_ELEMENT_ARRAY_BUFFER = 34963;
+
+// glTF is little-endian whatever the host
+static inline void put16(unsigned char *p, uint16_t v) {
+	p[0] = (unsigned char)v;
+	p[1] = (unsigned char)(v >> 8);
+}
+
+static inline void put32(unsigned char *p, uint32_t v) {
+	for (int b = 0; b < 4; b++)
+		p[b] = (unsigned char)(v >> (8 * b));
+}
+
+static inline void put_float(unsigned char *p, float f) {
+	uint32_t v;
+	memcpy(&v, &f, 4);
+	put32(p, v);
+}
+
+static inline size_t pad4(size_t n) {
+	return (n + 3) & ~(size_t)3;
+}
+
+// what a vertex attribute holds
+enum { ATTR_POSITION, ATTR_NORMAL, ATTR_CLEVEL };
+
+// a vertex attribute of every point, in a buffer view of its own with stride bytes per point
+struct attribute {
+	int kind = ATTR_POSITION;
+	string name;
+	int component = GL_FLOAT;
+	int normalized = 0;
+	const char *type = "VEC3";
+	size_t stride = 12;
+	string min, max; // JSON arrays, if the accessor has them
+};
+
+int glb_write(vtkPolyData *mesh, const string& fn) {
+	FILE *out = fopen(fn.c_str(), "wb");
+	if (out == NULL) {
+		cerr << "Unable to write '" << fn << "': " << strerror(errno) << endl;
+		return -1;
+	}
+	int failed = glb_write(mesh, out, fn);
+	if (fclose(out) != 0 && !failed) {
+		cerr << "Unable to write '" << fn << "': " << strerror(errno) << endl;
+		failed = -1;
+	}
+	return failed;
+}
+
+int glb_write(vtkPolyData *mesh, FILE *out, const string& name) {
+	vtkPoints *points = mesh->GetPoints();
+	vtkIdType npts = points != NULL ? points->GetNumberOfPoints() : 0;
+
+	// the triangles of the polygons (as fans) and of the strips, with a consistent winding, and the
+	// cell each comes from
+	vector<vtkIdType> tris;
+	vector<vtkIdType> source;
+	vtkIdType n;
+	const vtkIdType *pts;
+	vtkIdType cell = mesh->GetNumberOfVerts() + mesh->GetNumberOfLines();
+	vtkCellArray *polys = mesh->GetPolys();
+	if (polys != NULL)
+		for (polys->InitTraversal(); polys->GetNextCell(n, pts); cell++)
+			for (vtkIdType t = 1; t + 1 < n; t++) {
+				tris.push_back(pts[0]);
+				tris.push_back(pts[t]);
+				tris.push_back(pts[t + 1]);
+				source.push_back(cell);
+			}
+	vtkCellArray *strips = mesh->GetStrips();
+	if (strips != NULL)
+		for (strips->InitTraversal(); strips->GetNextCell(n, pts); cell++)
+			for (vtkIdType t = 0; t + 2 < n; t++) {
+				tris.push_back(pts[t + (t & 1)]);
+				tris.push_back(pts[t + 1 - (t & 1)]);
+				tris.push_back(pts[t + 2]);
+				source.push_back(cell);
+			}
+	size_t ntris = tris.size() / 3;
+	if (npts == 0)
+		ntris = 0;
+
+	// one primitive per label (in ascending order), its triangles in the order they come in
+	vector<int> labels;
+	vector<size_t> order(ntris), first(2, 0);
+	for (size_t t = 0; t < ntris; t++)
+		order[t] = t;
+	first[1] = ntris;
+	vtkDataArray *label = mesh->GetCellData()->GetArray("label");
+	if (label != NULL && ntris > 0) {
+		vector<int> value(ntris);
+		for (size_t t = 0; t < ntris; t++)
+			value[t] = (int)label->GetComponent(source[t], 0);
+		labels = value;
+		sort(labels.begin(), labels.end());
+		labels.erase(unique(labels.begin(), labels.end()), labels.end());
+		first.assign(labels.size() + 1, 0);
+		vector<size_t> group(ntris);
+		for (size_t t = 0; t < ntris; t++) {
+			group[t] = lower_bound(labels.begin(), labels.end(), value[t]) - labels.begin();
+			first[group[t] + 1]++;
+		}
+		for (size_t g = 0; g < labels.size(); g++)
+			first[g + 1] += first[g];
+		vector<size_t> fill(first.begin(), first.end() - 1);
+		for (size_t t = 0; t < ntris; t++)
+			order[fill[group[t]]++] = t;
+	}
+	source.clear();
+
+	// positions as they are, unless they are quantized
+	vector<struct attribute> attributes;
+	vtkDataArray *offset = mesh->GetFieldData()->GetArray("quantization_offset");
+	vtkDataArray *scale = mesh->GetFieldData()->GetArray("quantization_scale");
+	vtkUnsignedShortArray *quantized = points != NULL ? vtkUnsignedShortArray::SafeDownCast(points->GetData()) : NULL;
+	int quantize = quantized != NULL && quantized->GetNumberOfComponents() == 3 && offset != NULL && scale != NULL;
+	struct attribute position;
+	position.name = "POSITION";
+	if (quantize) {
+		position.component = GL_UNSIGNED_SHORT;
+		position.stride = 8;
+	}
+	// the bounds of the values as written
+	double range[6] = {0.0, 0.0, 0.0, 0.0, 0.0, 0.0}, x[3];
+	for (vtkIdType p = 0; p < npts && ntris > 0; p++) {
+		if (quantize)
+			for (int a = 0; a < 3; a++)
+				x[a] = quantized->GetValue(3 * p + a);
+		else {
+			points->GetPoint(p, x);
+			for (int a = 0; a < 3; a++)
+				x[a] = (float)x[a];
+		}
+		for (int a = 0; a < 3; a++) {
+			if (p == 0 || x[a] < range[2 * a])
+				range[2 * a] = x[a];
+			if (p == 0 || x[a] > range[2 * a + 1])
+				range[2 * a + 1] = x[a];
+		}
+	}
+	ostringstream lo, hi;
+	lo << setprecision(9) << "[" << range[0] << "," << range[2] << "," << range[4] << "]";
+	hi << setprecision(9) << "[" << range[1] << "," << range[3] << "," << range[5] << "]";
+	position.min = lo.str();
+	position.max = hi.str();
+	attributes.push_back(position);
+
+	vtkFloatArray *normals = vtkFloatArray::SafeDownCast(mesh->GetPointData()->GetArray("Normals"));
+	vtkShortArray *oct = vtkShortArray::SafeDownCast(mesh->GetPointData()->GetArray("OctNormals"));
+	if (normals != NULL && normals->GetNumberOfComponents() != 3)
+		normals = NULL;
+	if (oct != NULL && oct->GetNumberOfComponents() != 2)
+		oct = NULL;
+	if (normals != NULL || oct != NULL) {
+		struct attribute normal;
+		normal.kind = ATTR_NORMAL;
+		normal.name = "NORMAL";
+		if (normals == NULL) {
+			normal.component = GL_SHORT;
+			normal.normalized = 1;
+			normal.stride = 8;
+		}
+		attributes.push_back(normal);
+	}
+	vtkDataArray *clevel = mesh->GetPointData()->GetArray("clevel");
+	if (clevel != NULL && clevel->GetNumberOfComponents() == 1) {
+		struct attribute level;
+		level.kind = ATTR_CLEVEL;
+		level.name = "_CLEVEL";
+		level.type = "SCALAR";
+		level.stride = 4;
+		attributes.push_back(level);
+	}
+	else
+		clevel = NULL;
+
+	// the vertex attributes, then the indices, one buffer view each
+	int index_size = npts <= 65535 ? 2 : 4;
+	vector<size_t> view_offset, view_length;
+	size_t bin_length = 0;
+	if (ntris > 0) {
+		for (size_t a = 0; a < attributes.size(); a++) {
+			view_offset.push_back(bin_length);
+			view_length.push_back(attributes[a].stride * npts);
+			bin_length += pad4(view_length.back());
+		}
+		view_offset.push_back(bin_length);
+		view_length.push_back(3 * ntris * index_size);
+		bin_length += pad4(view_length.back());
+	}
+
+	ostringstream json;
+	json << setprecision(17) << "{\"asset\":{\"version\":\"2.0\",\"generator\":\"meshmaker\"}";
+	// integer positions and normals are only allowed with the extension
+	if (quantize || (normals == NULL && oct != NULL))
+		json << ",\"extensionsUsed\":[\"KHR_mesh_quantization\"],\"extensionsRequired\":[\"KHR_mesh_quantization\"]";
+	json << ",\"scene\":0";
+	if (ntris == 0)
+		json << ",\"scenes\":[{}]}";
+	else {
+		json << ",\"scenes\":[{\"nodes\":[0]}],\"nodes\":[{\"mesh\":0";
+		if (quantize) {
+			json << ",\"translation\":[";
+			for (int a = 0; a < 3; a++)
+				json << (a ? "," : "") << offset->GetComponent(0, a);
+			json << "],\"scale\":[";
+			for (int a = 0; a < 3; a++)
+				json << (a ? "," : "") << scale->GetComponent(0, a);
+			json << "]";
+		}
+		json << "}],\"meshes\":[{\"primitives\":[";
+		size_t nprims = first.size() - 1;
+		for (size_t g = 0; g < nprims; g++) {
+			json << (g ? "," : "") << "{\"attributes\":{";
+			for (size_t a = 0; a < attributes.size(); a++)
+				json << (a ? "," : "") << "\"" << attributes[a].name << "\":" << a;
+			json << "},\"indices\":" << attributes.size() + g << ",\"mode\":4";
+			if (!labels.empty())
+				json << ",\"extras\":{\"label\":" << labels[g] << "}";
+			json << "}";
+		}
+		json << "]}],\"buffers\":[{\"byteLength\":" << bin_length << "}],\"bufferViews\":[";
+		for (size_t v = 0; v < view_offset.size(); v++) {
+			json << (v ? "," : "") << "{\"buffer\":0,\"byteOffset\":" << view_offset[v] << ",\"byteLength\":" << view_length[v];
+			if (v < attributes.size())
+				json << ",\"byteStride\":" << attributes[v].stride << ",\"target\":" << GL_ARRAY_BUFFER << "}";
+			else
+				json << ",\"target\":" << GL_ELEMENT_ARRAY_BUFFER << "}";
+		}
+		json << "],\"accessors\":[";
+		for (size_t a = 0; a < attributes.size(); a++) {
+			json << (a ? "," : "") << "{\"bufferView\":" << a << ",\"componentType\":" << attributes[a].component;
+			if (attributes[a].normalized)
+				json << ",\"normalized\":true";
+			json << ",\"count\":" << npts << ",\"type\":\"" << attributes[a].type << "\"";
+			if (!attributes[a].min.empty())
+				json << ",\"min\":" << attributes[a].min << ",\"max\":" << attributes[a].max;
+			json << "}";
+		}
+		for (size_t g = 0; g < nprims; g++)
+			json << ",{\"bufferView\":" << attributes.size() << ",\"byteOffset\":" << 3 * first[g] * index_size
+				<< ",\"componentType\":" << (index_size == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT)
+				<< ",\"count\":" << 3 * (first[g + 1] - first[g]) << ",\"type\":\"SCALAR\"}";
+		json << "]}";
+	}
+	string text = json.str();
+	text.resize(pad4(text.size()), ' ');
+
+	uint64_t total = 12 + 8 + text.size() + (bin_length > 0 ? 8 + bin_length : 0);
+	if (total > UINT32_MAX) {
+		cerr << "Mesh too large (" << total << " bytes) for GLB" << endl;
+		return -1;
+	}
+	unsigned char header[20];
+	put32(header, GLB_MAGIC);
+	put32(header + 4, 2);
+	put32(header + 8, (uint32_t)total);
+	put32(header + 12, (uint32_t)text.size());
+	put32(header + 16, GLB_JSON);
+	int failed = fwrite(header, 1, sizeof(header), out) != sizeof(header);
+	failed = failed || fwrite(text.data(), 1, text.size(), out) != text.size();
+	if (bin_length > 0 && !failed) {
+		put32(header, (uint32_t)bin_length);
+		put32(header + 4, GLB_BIN);
+		failed = fwrite(header, 1, 8, out) != 8;
+	}
+
+	// each buffer view is packed on all threads, then written, one at a time
+	vector<unsigned char> buffer;
+	for (size_t v = 0; v < view_offset.size() && !failed; v++) {
+		buffer.assign(pad4(view_length[v]), 0);
+		unsigned char *data = &buffer[0];
+		if (v < attributes.size()) {
+			int kind = attributes[v].kind;
+			size_t stride = attributes[v].stride;
+			auto pack = [&](vtkIdType p0, vtkIdType p1) {
+				double x[3];
+				short s[3];
+				for (vtkIdType p = p0; p < p1; p++) {
+					unsigned char *d = data + p * stride;
+					if (kind == ATTR_POSITION && quantize)
+						for (int a = 0; a < 3; a++)
+							put16(d + 2 * a, quantized->GetValue(3 * p + a));
+					else if (kind == ATTR_POSITION) {
+						points->GetPoint(p, x);
+						for (int a = 0; a < 3; a++)
+							put_float(d + 4 * a, (float)x[a]);
+					}
+					else if (kind == ATTR_NORMAL && normals != NULL)
+						for (int a = 0; a < 3; a++)
+							put_float(d + 4 * a, normals->GetValue(3 * p + a));
+					else if (kind == ATTR_NORMAL) {
+						oct_decode(oct->GetPointer(2 * p), s);
+						for (int a = 0; a < 3; a++)
+							put16(d + 2 * a, (uint16_t)s[a]);
+					}
+					else
+						put_float(d, (float)clevel->GetComponent(p, 0));
+				}
+			};
+			vtkSMPTools::For(0, npts, pack);
+		}
+		else {
+			auto pack = [&](vtkIdType t0, vtkIdType t1) {
+				for (vtkIdType t = t0; t < t1; t++)
+					for (int k = 0; k < 3; k++) {
+						vtkIdType id = tris[3 * order[t] + k];
+						if (index_size == 2)
+							put16(data + 2 * (3 * t + k), (uint16_t)id);
+						else
+							put32(data + 4 * (3 * t + k), (uint32_t)id);
+					}
+			};
+			vtkSMPTools::For(0, (vtkIdType)ntris, pack);
+		}
+		failed = fwrite(data, 1, buffer.size(), out) != buffer.size();
+	}
+	if (!failed)
+		failed = fflush(out) != 0;
+	if (failed) {
+		cerr << "Unable to write '" << name << "': " << strerror(errno) << endl;
+		return -1;
+	}
+	return 0;
+}
@@ -0,0 +1,35 @@
+/*
+ * glb_writer
+ *
+ * Binary glTF 2.0 (GLB) output: indexed triangles with their positions,
+ * normals and levels packed on vtkSMPTools into a single binary chunk
+ *
+ * License: Apache
+ */
+
+#ifndef MESHMAKER_GLB_WRITER_H
+#define MESHMAKER_GLB_WRITER_H
+
+// standard headers
+#include <cstdio>
+#include <string>
+
+// VTK headers
+#include "vtkPolyData.h"
+
+// write the polygons (as fans) and triangle strips of mesh to fn as one GLB mesh of indexed
+// triangles, in the order they come in; other cells are ignored. Points are FLOAT positions, or
+// UNSIGNED_SHORT ones under the node's translation and scale (KHR_mesh_quantization) if they were
+// quantized with their 'quantization_offset' and 'quantization_scale' field data. 'Normals' become
+// FLOAT normals and 'OctNormals' normalized SHORT ones (also KHR_mesh_quantization), and 'clevel'
+// point scalars a _CLEVEL attribute. The triangles of each value of a 'label' cell array go into a
+// primitive of their own with that label in its extras. Indices are UNSIGNED_SHORT for up to 65535
+// points, otherwise UNSIGNED_INT.
+// Returns 0 on success, otherwise prints the reason and returns -1
+int glb_write(vtkPolyData *mesh, const std::string& fn);
+
+// the same to the stream out (e.g. a pipe: it is written strictly in order), which is flushed but left
+// open; name is only used in messages
+int glb_write(vtkPolyData *mesh, FILE *out, const std::string& name);
+
+#endif
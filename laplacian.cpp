@@ -0,0 +1,185 @@
+/*
+ * laplacian
+ *
+ * Multi-threaded Laplacian smoothing (see laplacian.h)
+ *
+ * License: Apache
+ */
+
+// standard headers
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// VTK headers
+#include "vtkCellArray.h"
+#include "vtkMath.h"
+#include "vtkPoints.h"
+#include "vtkSMPTools.h"
+
+#include "laplacian.h"
+#include "pool.h"
+
+using namespace std;
+
+// vtkSmoothPolyDataFilter defaults
+static const double RELAXATION_FACTOR = 0.01;
+static const double EDGE_ANGLE = 15.0;
+
+enum vertex_type { FIXED_VERTEX = 0, INTERIOR_VERTEX, BOUNDARY_VERTEX };
+
+vtkSmartPointer<vtkPolyData> laplacian_smooth(vtkPolyData *mesh, int iterations, int boundary_smoothing, struct progress *progress) {
+	vtkSmartPointer<vtkPolyData> output = vtkSmartPointer<vtkPolyData>::New();
+	output->ShallowCopy(mesh);
+	vtkIdType npts = mesh->GetNumberOfPoints();
+	if (npts == 0 || iterations <= 0)
+		return output;
+
+	// undirected edges of every polygon as (low << 32 | high)
+	vtkCellArray *polys = mesh->GetPolys();
+	pool_vector<uint64_t> edges;
+	edges.reserve(polys->GetNumberOfConnectivityIds());
+	vtkIdType n;
+	const vtkIdType *pts;
+	for (polys->InitTraversal(); polys->GetNextCell(n, pts);)
+		for (vtkIdType k = 0; k < n; k++) {
+			uint64_t a = pts[k], b = pts[(k + 1) % n];
+			if (a != b)
+				edges.push_back(a < b ? (a << 32) | b : (b << 32) | a);
+		}
+	vtkSMPTools::Sort(edges.begin(), edges.end());
+
+	// collapse duplicates; an edge not shared by exactly two polygons is a boundary edge
+	size_t nedges = 0;
+	pool_vector<unsigned char> boundary_edge;
+	boundary_edge.reserve(edges.size() / 2 + 1);
+	for (size_t e = 0; e < edges.size();) {
+		size_t run = e + 1;
+		while (run < edges.size() && edges[run] == edges[e])
+			run++;
+		edges[nedges++] = edges[e];
+		boundary_edge.push_back(run - e != 2);
+		e = run;
+	}
+	edges.resize(nedges);
+
+	// vertices on no polygon and boundary corners stay put; interior vertices move towards
+	// all their neighbours and (optionally) boundary vertices towards their two boundary neighbours
+	pool_vector<unsigned char> type(npts, FIXED_VERTEX);
+	pool_vector<int> nboundary(npts, 0);
+	for (size_t e = 0; e < nedges; e++) {
+		vtkIdType a = edges[e] >> 32, b = edges[e] & 0xffffffff;
+		type[a] = type[b] = INTERIOR_VERTEX;
+		if (boundary_edge[e]) {
+			nboundary[a]++;
+			nboundary[b]++;
+		}
+	}
+	for (vtkIdType v = 0; v < npts; v++)
+		if (nboundary[v] > 0)
+			type[v] = (boundary_smoothing && nboundary[v] == 2) ? BOUNDARY_VERTEX : FIXED_VERTEX;
+
+	// CSR adjacency of the moving vertices
+	pool_vector<vtkIdType> offsets(npts + 1, 0);
+	for (size_t e = 0; e < nedges; e++) {
+		vtkIdType a = edges[e] >> 32, b = edges[e] & 0xffffffff;
+		if (type[a] == INTERIOR_VERTEX || (type[a] == BOUNDARY_VERTEX && boundary_edge[e]))
+			offsets[a + 1]++;
+		if (type[b] == INTERIOR_VERTEX || (type[b] == BOUNDARY_VERTEX && boundary_edge[e]))
+			offsets[b + 1]++;
+	}
+	for (vtkIdType v = 0; v < npts; v++)
+		offsets[v + 1] += offsets[v];
+	pool_vector<uint32_t> neighbours(offsets[npts]);
+	{
+		pool_vector<vtkIdType> cursor(offsets.begin(), offsets.end() - 1);
+		for (size_t e = 0; e < nedges; e++) {
+			vtkIdType a = edges[e] >> 32, b = edges[e] & 0xffffffff;
+			if (type[a] == INTERIOR_VERTEX || (type[a] == BOUNDARY_VERTEX && boundary_edge[e]))
+				neighbours[cursor[a]++] = (uint32_t)b;
+			if (type[b] == INTERIOR_VERTEX || (type[b] == BOUNDARY_VERTEX && boundary_edge[e]))
+				neighbours[cursor[b]++] = (uint32_t)a;
+		}
+	}
+	pool_vector<uint64_t>().swap(edges);
+	pool_vector<unsigned char>().swap(boundary_edge);
+
+	// double-buffered positions
+	vtkPoints *in_points = mesh->GetPoints();
+	pool_vector<double> pos[2][3];
+	for (int b = 0; b < 2; b++)
+		for (int c = 0; c < 3; c++)
+			pos[b][c].resize(npts);
+	auto load = [&](vtkIdType first, vtkIdType last) {
+		double p[3];
+		for (vtkIdType v = first; v < last; v++) {
+			in_points->GetPoint(v, p);
+			pos[0][0][v] = pos[1][0][v] = p[0];
+			pos[0][1][v] = pos[1][1][v] = p[1];
+			pos[0][2][v] = pos[1][2][v] = p[2];
+		}
+	};
+	vtkSMPTools::For(0, npts, load);
+
+	// boundary vertices at a sharper corner than the edge angle stay put
+	double cos_edge_angle = cos(vtkMath::RadiansFromDegrees(EDGE_ANGLE));
+	for (vtkIdType v = 0; v < npts; v++) {
+		if (type[v] != BOUNDARY_VERTEX || offsets[v + 1] - offsets[v] != 2)
+			continue;
+		uint32_t a = neighbours[offsets[v]], b = neighbours[offsets[v] + 1];
+		double v1[3], v2[3], l1 = 0, l2 = 0, dot = 0;
+		for (int c = 0; c < 3; c++) {
+			v1[c] = pos[0][c][v] - pos[0][c][a];
+			v2[c] = pos[0][c][b] - pos[0][c][v];
+			l1 += v1[c] * v1[c];
+			l2 += v2[c] * v2[c];
+			dot += v1[c] * v2[c];
+		}
+		if (l1 > 0 && l2 > 0 && dot / sqrt(l1 * l2) < cos_edge_angle)
+			type[v] = FIXED_VERTEX;
+	}
+
+	int src = 0;
+	const unsigned char *vtype = &type[0];
+	const vtkIdType *off = &offsets[0];
+	const uint32_t *nbr = neighbours.empty() ? NULL : &neighbours[0];
+	for (int it = 0; it < iterations && progress_cancelled(progress) == NULL; it++) {
+		const double *sx = &pos[src][0][0], *sy = &pos[src][1][0], *sz = &pos[src][2][0];
+		double *dx = &pos[1 - src][0][0], *dy = &pos[1 - src][1][0], *dz = &pos[1 - src][2][0];
+		auto relax = [&](vtkIdType first, vtkIdType last) {
+			for (vtkIdType v = first; v < last; v++) {
+				vtkIdType begin = off[v], end = off[v + 1];
+				if (vtype[v] == FIXED_VERTEX || begin == end) {
+					dx[v] = sx[v];
+					dy[v] = sy[v];
+					dz[v] = sz[v];
+					continue;
+				}
+				double mx = 0, my = 0, mz = 0;
+				for (vtkIdType k = begin; k < end; k++) {
+					uint32_t u = nbr[k];
+					mx += sx[u];
+					my += sy[u];
+					mz += sz[u];
+				}
+				double inv = 1.0 / (end - begin);
+				dx[v] = sx[v] + RELAXATION_FACTOR * (mx * inv - sx[v]);
+				dy[v] = sy[v] + RELAXATION_FACTOR * (my * inv - sy[v]);
+				dz[v] = sz[v] + RELAXATION_FACTOR * (mz * inv - sz[v]);
+			}
+		};
+		vtkSMPTools::For(0, npts, relax);
+		src = 1 - src;
+		progress_update(progress, (it + 1.0) / iterations);
+	}
+
+	// same precision as the input points
+	vtkSmartPointer<vtkPoints> out_points = pool_points(in_points->GetDataType(), npts);
+	auto store = [&](vtkIdType first, vtkIdType last) {
+		for (vtkIdType v = first; v < last; v++)
+			out_points->SetPoint(v, pos[src][0][v], pos[src][1][v], pos[src][2][v]);
+	};
+	vtkSMPTools::For(0, npts, store);
+	output->SetPoints(out_points);
+	return output;
+}
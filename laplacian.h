@@ -0,0 +1,28 @@
+/*
+ * laplacian
+ *
+ * Multi-threaded Laplacian smoothing: a compact (CSR) vertex adjacency is
+ * built once and the iterations run on vtkSMPTools over double-buffered
+ * x/y/z arrays
+ *
+ * License: Apache
+ */
+
+#ifndef MESHMAKER_LAPLACIAN_H
+#define MESHMAKER_LAPLACIAN_H
+
+// VTK headers
+#include "vtkSmartPointer.h"
+#include "vtkPolyData.h"
+
+#include "progress.h"
+
+// smooth the polygons of mesh with the same rules and defaults as vtkSmoothPolyDataFilter
+// (relaxation factor 0.01, 15 degree edge angle, no feature edge smoothing); boundary vertices
+// slide along the boundary only if boundary_smoothing is set and are fixed otherwise.
+// Points move simultaneously (Jacobi) rather than in turn, so results agree with the
+// VTK filter to within a small fraction of the relaxation step. Point ids must fit in 32 bits.
+// The iterations done are reported to progress, and stop early once its job is cancelled.
+vtkSmartPointer<vtkPolyData> laplacian_smooth(vtkPolyData *mesh, int iterations, int boundary_smoothing, struct progress *progress = NULL);
+
+#endif
@@ -0,0 +1,211 @@
+/*
+ * libmeshmaker
+ *
+ * The pipeline of meshmaker run on a volume in memory (see libmeshmaker.h)
+ *
+ * License: Apache
+ */
+
+// standard headers
+#include <algorithm>
+#include <cstdio>
+#include <exception>
+#include <stdexcept>
+
+// VTK headers
+#include "vtkSmartPointer.h"
+#include "vtkImageData.h"
+#include "vtkPolyData.h"
+#include "vtkPointData.h"
+#include "vtkCellArray.h"
+#include "vtkPoints.h"
+#include "vtkFloatArray.h"
+#include "vtkTypeInt64Array.h"
+
+#include "meshmaker.h"
+#include "progress.h"
+#include "libmeshmaker.h"
+
+using namespace std;
+
+struct meshmaker_result {
+	vector<struct mesh_output> outputs;
+	vector<struct meshmaker_mesh> meshes;
+	// the buffers that could not be borrowed from the meshes
+	vector<vector<float> > points;
+	vector<vector<int64_t> > triangles;
+};
+
+// the options of a library job, with the volume as its one map
+static struct args library_args(const vector<string>& args) {
+	vector<char *> argv;
+	argv.push_back(const_cast<char *>("meshmaker"));
+	for (size_t a = 0; a < args.size(); a++)
+		argv.push_back(const_cast<char *>(args[a].c_str()));
+	argv.push_back(const_cast<char *>("volume"));
+	struct args cargs = parse_args((int)argv.size(), &argv[0]);
+	if (cargs.map_fns.size() != 1 || cargs.manifest_fn.compare("") != 0)
+		throw invalid_argument("the volume is the only map");
+	// the ranks of an MPI run each map their own slab of a file
+	if (cargs.distributed.compare("") != 0)
+		throw invalid_argument("--distributed needs mpirun and a map file");
+	if (cargs.serve || cargs.mmap || cargs.cache_dir.compare("") != 0 || cargs.out_fd >= 0)
+		throw invalid_argument("-M, --cache, --serve and streams need files");
+	if (cargs.quantize)
+		throw invalid_argument("the points are Float32");
+	// messages would mix with those of other jobs and the host's own output
+	cargs.verbose = 0;
+	cargs.float32 = 1;
+	cargs.int32 = 0;
+	if (cargs.normals == 2)
+		cargs.normals = 1;
+	return cargs;
+}
+
+// the caller's voxels as an image, without a copy
+static vtkSmartPointer<vtkImageData> volume_image(const struct meshmaker_volume& volume) {
+	for (int a = 0; a < 3; a++)
+		if (volume.dims[a] < 1)
+			throw invalid_argument("the volume is empty");
+	if (volume.voxels == NULL)
+		throw invalid_argument("the volume has no voxels");
+	vtkSmartPointer<vtkFloatArray> scalars = vtkSmartPointer<vtkFloatArray>::New();
+	scalars->SetName("density");
+	// saved: the voxels stay the caller's
+	scalars->SetArray(const_cast<float *>(volume.voxels), (vtkIdType)volume.dims[0] * volume.dims[1] * volume.dims[2], 1);
+	vtkSmartPointer<vtkImageData> image = vtkSmartPointer<vtkImageData>::New();
+	image->SetDimensions(volume.dims[0], volume.dims[1], volume.dims[2]);
+	image->SetSpacing(volume.spacing[0], volume.spacing[1], volume.spacing[2]);
+	image->SetOrigin(volume.origin[0], volume.origin[1], volume.origin[2]);
+	image->GetPointData()->SetScalars(scalars);
+	return image;
+}
+
+// the buffers of output m of result, borrowed from its mesh where they already have the right layout
+static void expose(struct meshmaker_result& result, size_t m) {
+	const struct mesh_output& out = result.outputs[m];
+	vtkPolyData *mesh = out.mesh;
+	struct meshmaker_mesh view;
+	view.name = out.fn.c_str();
+	view.has_level = out.has_level;
+	view.clevel = out.clevel;
+	view.lod = out.lod;
+	view.npoints = mesh->GetNumberOfPoints();
+	view.points = NULL;
+	if (view.npoints > 0) {
+		vtkFloatArray *points = vtkFloatArray::SafeDownCast(mesh->GetPoints()->GetData());
+		if (points != NULL)
+			view.points = points->GetPointer(0);
+		else {
+			result.points.push_back(vector<float>(3 * view.npoints));
+			vector<float>& copy = result.points.back();
+			double x[3];
+			for (vtkIdType p = 0; p < view.npoints; p++) {
+				mesh->GetPoints()->GetPoint(p, x);
+				for (int a = 0; a < 3; a++)
+					copy[3 * p + a] = (float)x[a];
+			}
+			view.points = &copy[0];
+		}
+	}
+	vtkFloatArray *normals = vtkFloatArray::SafeDownCast(mesh->GetPointData()->GetArray("Normals"));
+	view.normals = normals != NULL && view.npoints > 0 ? normals->GetPointer(0) : NULL;
+
+	// the connectivity of 64-bit triangles is the index buffer; other polygons are split into fans
+	vtkCellArray *polys = mesh->GetPolys();
+	view.ntriangles = 0;
+	view.triangles = NULL;
+	if (polys->GetNumberOfCells() > 0 && polys->IsStorage64Bit() && polys->GetNumberOfConnectivityIds() == 3 * polys->GetNumberOfCells()) {
+		view.ntriangles = polys->GetNumberOfCells();
+		// vtkTypeInt64 may be long long where int64_t is long: the same 64 bits
+		view.triangles = reinterpret_cast<const int64_t *>(polys->GetConnectivityArray64()->GetPointer(0));
+	}
+	else if (polys->GetNumberOfCells() > 0) {
+		result.triangles.push_back(vector<int64_t>());
+		vector<int64_t>& copy = result.triangles.back();
+		vtkIdType n;
+		const vtkIdType *pts;
+		for (polys->InitTraversal(); polys->GetNextCell(n, pts);)
+			for (vtkIdType k = 2; k < n; k++) {
+				copy.push_back(pts[0]);
+				copy.push_back(pts[k - 1]);
+				copy.push_back(pts[k]);
+			}
+		view.ntriangles = copy.size() / 3;
+		view.triangles = copy.empty() ? NULL : &copy[0];
+	}
+	result.meshes.push_back(view);
+}
+
+// mesh volume into result
+static void run(struct meshmaker_result& result, const struct meshmaker_volume& volume, const vector<string>& args, struct progress *progress) {
+	struct args cargs = library_args(args);
+	vtkSmartPointer<vtkImageData> image = volume_image(volume);
+	cargs.image = image;
+	cargs.meshes = &result.outputs;
+	// every call has a progress of its own (for its stages and --deadline), cancelled along with the caller's
+	struct progress own;
+	own.parent = progress;
+	own.json = cargs.progress_json || (progress != NULL && progress->json);
+	if (progress != NULL)
+		own.callback = progress->callback;
+	progress_set_deadline(&own, cargs.deadline);
+	cargs.progress = &own;
+	if (run_jobs(cargs, make_jobs(cargs)) != 0)
+		throw runtime_error("unable to write profile " + cargs.profile_fn);
+	for (size_t m = 0; m < result.outputs.size(); m++)
+		expose(result, m);
+}
+
+shared_ptr<meshmaker_result> meshmaker_run(const struct meshmaker_volume& volume, const vector<string>& args, struct progress *progress) {
+	shared_ptr<meshmaker_result> result = make_shared<meshmaker_result>();
+	run(*result, volume, args, progress);
+	return result;
+}
+
+extern "C" {
+
+meshmaker_result *meshmaker_run(const struct meshmaker_volume *volume, int nargs, const char *const *args,
+		int (*progress)(void *user, const char *stage, int percent), void *user, char *error, size_t error_size) {
+	string reason;
+	try {
+		if (volume == NULL)
+			throw invalid_argument("no volume");
+		struct progress events;
+		if (progress != NULL)
+			events.callback = [&](const string& stage, int percent) {
+				if (progress(user, stage.c_str(), percent) != 0)
+					events.cancel = 1;
+			};
+		vector<string> options(args, args + max(nargs, 0));
+		unique_ptr<meshmaker_result> result(new meshmaker_result);
+		run(*result, *volume, options, &events);
+		return result.release();
+	}
+	catch (cancelled_error& e) {
+		reason = string("cancelled: ") + e.what();
+	}
+	catch (exception& e) {
+		reason = e.what();
+	}
+	if (error != NULL && error_size > 0)
+		snprintf(error, error_size, "%s", reason.c_str());
+	return NULL;
+}
+
+int meshmaker_count(const meshmaker_result *result) {
+	return result != NULL ? (int)result->meshes.size() : 0;
+}
+
+int meshmaker_get(const meshmaker_result *result, int i, struct meshmaker_mesh *mesh) {
+	if (result == NULL || i < 0 || (size_t)i >= result->meshes.size() || mesh == NULL)
+		return -1;
+	*mesh = result->meshes[i];
+	return 0;
+}
+
+void meshmaker_free(meshmaker_result *result) {
+	delete result;
+}
+
+}
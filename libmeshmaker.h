@@ -0,0 +1,82 @@
+/*
+ * libmeshmaker
+ *
+ * C and C++ API of the meshing pipeline: a volume in memory goes in and
+ * the meshes come back as buffers in memory, without any files. Calls are
+ * independent, so threads of a host process may mesh concurrently
+ *
+ * License: Apache
+ */
+
+#ifndef MESHMAKER_LIBMESHMAKER_H
+#define MESHMAKER_LIBMESHMAKER_H
+
+/* standard headers */
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* dims[0] x dims[1] x dims[2] voxels, x fastest; the voxels are read but never modified, and must stay
+   until the call returns */
+struct meshmaker_volume {
+	const float *voxels;
+	int dims[3];
+	double spacing[3]; /* voxel size along each axis, e.g. in Angstrom */
+	double origin[3]; /* position of the first voxel */
+};
+
+/* a mesh of triangles; the buffers belong to the result that it came from */
+struct meshmaker_mesh {
+	const char *name; /* the file it would have been written to (after -o) */
+	int has_level; /* 0 if it holds every level (or label) of the volume (-1/--one-file) */
+	double clevel; /* otherwise its level (or label) */
+	int lod; /* -1, or its level of detail with -L/--lod */
+	int64_t npoints;
+	const float *points; /* npoints x 3 */
+	const float *normals; /* npoints x 3 with -N/--normals, otherwise NULL */
+	int64_t ntriangles;
+	const int64_t *triangles; /* ntriangles x 3 indices into points */
+};
+
+typedef struct meshmaker_result meshmaker_result;
+
+/* mesh volume with the options of the meshmaker command line in args[0..nargs), e.g. "-c", "0.5", "-s";
+   maps, -o -, --output-fd, -M, --cache and --serve do not apply, nor do -j and --pool (the SMP threads and
+   the buffer pool are the host's), -v or -A/-S/-V/-X/-G (the meshes are unstripped Float32 triangles),
+   and --quantize is refused. Returns the result, or NULL with the reason in error (a buffer of error_size
+   bytes; details of invalid options go to stderr). progress (may be NULL) is called with user, the
+   stage and its percentage as the job goes and cancels it by returning non-zero, as does --deadline.
+   It is called from whichever thread makes progress, including SMP worker threads (e.g. of -B bricks
+   or -E blocks), one call at a time per job; --distributed is refused */
+meshmaker_result *meshmaker_run(const struct meshmaker_volume *volume, int nargs, const char *const *args,
+	int (*progress)(void *user, const char *stage, int percent), void *user, char *error, size_t error_size);
+
+/* the number of meshes in result */
+int meshmaker_count(const meshmaker_result *result);
+
+/* mesh i of result; returns 0, or -1 if there is no such mesh */
+int meshmaker_get(const meshmaker_result *result, int i, struct meshmaker_mesh *mesh);
+
+/* release result and its buffers (NULL is ignored) */
+void meshmaker_free(meshmaker_result *result);
+
+#ifdef __cplusplus
+}
+
+// standard headers
+#include <memory>
+#include <string>
+#include <vector>
+
+struct progress;
+
+// the same for C++: throws std::invalid_argument for invalid options, cancelled_error once progress (which
+// may be NULL, otherwise gets the events) is cancelled and std::runtime_error if meshing fails
+std::shared_ptr<meshmaker_result> meshmaker_run(const struct meshmaker_volume& volume, const std::vector<std::string>& args,
+	struct progress *progress = NULL);
+#endif
+
+#endif
@@ -0,0 +1,120 @@
+/*
+ * main
+ *
+ * The meshmaker executable: the command line (or the server's requests) run
+ * through the pipeline of libmeshmaker (see meshmaker.h)
+ *
+ * License: Apache
+ */
+
+// standard headers
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+// POSIX headers
+#include <unistd.h>
+
+// VTK headers
+#include "vtkSMPTools.h"
+
+#include "distributed.h"
+#include "meshmaker.h"
+#include "pool.h"
+#include "progress.h"
+#include "resident.h"
+#include "server.h"
+
+using namespace std;
+
+// run the command line; returns the exit code
+static int run(int argc, char **argv)
+{
+	try {
+		// get the args
+		struct args cargs = parse_args(argc, argv);
+
+		// under mpirun every rank would mesh every map into the same files
+		if (cargs.distributed.compare("") == 0 && distributed_size() > 1) {
+			if (distributed_rank() == 0)
+				cerr << "Running on " << distributed_size() << " MPI ranks without --distributed. Aborting..." << endl;
+			return EXIT_USAGE;
+		}
+
+		// the ranks of a distributed run share the terminal, so only rank 0 talks; the others profile to files of their own
+		if (cargs.distributed.compare("") != 0 && distributed_rank() != 0) {
+			cargs.verbose = 0;
+			if (cargs.profile_fn.compare("") != 0 && cargs.profile_fn.compare("-") != 0) {
+				ostringstream fn;
+				fn << cargs.profile_fn << "." << distributed_rank();
+				cargs.profile_fn = fn.str();
+			}
+		}
+
+		// the first SIGINT/SIGTERM stops the jobs at their next check instead of killing the process
+		progress_catch_signals();
+
+		// stdout carries the mesh, so messages go to stderr
+		if (cargs.out_fd == STDOUT_FILENO)
+			cout.rdbuf(cerr.rdbuf());
+
+		// size the SMP thread pool used by the multi-threaded stages
+		if (cargs.threads > 0)
+			vtkSMPTools::Initialize(cargs.threads);
+
+		// the pool is the process's: server jobs share the server's
+		pool_limit((size_t)cargs.pool_mb << 20);
+
+		// jobs until stdin closes, sharing the maps they read
+		if (cargs.serve) {
+			struct resident_cache resident;
+			resident.capacity = (size_t)cargs.resident_mb << 20;
+			if (cargs.verbose)
+				cerr << "Serving with " << cargs.workers << " worker(s) and " << cargs.resident_mb << " MB of resident maps..." << endl;
+			auto handle = [&](const struct server_request& req) {
+				return serve_request(cargs, &resident, req);
+			};
+			// a signal stops reading as well, and the jobs still queued are cancelled
+			server_run(cin, cout, cargs.workers, 2 * cargs.workers, handle);
+			return progress_signalled() ? EXIT_CANCELLED : EXIT_SUCCESS;
+		}
+
+		struct progress progress;
+		progress.json = cargs.progress_json;
+		progress_set_deadline(&progress, cargs.deadline);
+		cargs.progress = &progress;
+		if (run_jobs(cargs, make_jobs(cargs)) != 0)
+			return EXIT_FAILURE;
+	}
+	catch (help_requested& e) {
+		return EXIT_SUCCESS;
+	}
+	catch (cancelled_error& e) {
+		cerr << "Cancelled: " << e.what() << endl;
+		return EXIT_CANCELLED;
+	}
+	// the reason has been printed already
+	catch (invalid_argument& e) {
+		return EXIT_USAGE;
+	}
+	catch (exception& e) {
+		cerr << "Error: " << e.what() << endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
+
+int main(int argc, char **argv)
+{
+	// every rank of an MPI run starts here (a single one otherwise)
+	distributed_init(&argc, &argv);
+	int code = run(argc, argv);
+	// ranks waiting for a failed one would never finish
+	if (code != EXIT_SUCCESS && distributed_size() > 1)
+		distributed_abort(code);
+	distributed_finalize();
+	return code;
+}
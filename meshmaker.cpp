@@ -3,7 +3,7 @@
  *
  * Generate an StL mesh from an MRC/MAP file at some contour
  *
- * Usage: meshmaker file.map [<clevel> [<outfile.stl>|<outfile.vtk>]]
+ * Usage: meshmaker [options] file.map [file.map ...]
  *
  * Author: Paul K. Korir, PhD
  * Email: pkorir@ebi.ac.uk, paul.korir@gmail.com
@@ -14,62 +14,177 @@
  * 2016-09-26 - 0.1: basic version outputs either STL or VTK
  * 2017-03-22 - 0.2: basic version outputs VTP (XML)
  * 2018-05-14 - 0.3: add a smoothing and triangle-strip step to reduce VTP files
+ * 2026-10-14 - 0.4: batch mode: several maps and contour levels per run
+ * 2026-10-14 - 0.5: multi-threaded flying edges contour engine
+ * 2026-10-14 - 0.6: memory-mapped input meshed in slabs of sections
+ * 2026-10-14 - 0.7: concurrent per-brick processing with seam merging
+ * 2026-10-14 - 0.8: multi-threaded Laplacian smoothing engine
+ * 2026-10-14 - 0.9: quadric edge-collapse decimation engine
+ * 2026-10-14 - 0.10: per-stage profiling as JSON
+ * 2026-10-14 - 0.11: parallel binary STL writer; no strips for binary STL
+ * 2026-10-14 - 0.12: block-compressed VTP output (zlib, LZ4 or LZMA) on all threads
+ * 2026-10-14 - 0.13: raw appended VTP output written straight from the mesh, with aligned arrays
+ * 2026-10-14 - 0.14: LOD pyramids decimated incrementally in one run, with a JSON index
+ * 2026-10-14 - 0.15: all contour levels extracted by one filter and split by level, optionally into one file
+ * 2026-10-14 - 0.16: voxel/physical crop boxes, autocrop, stride and binning
+ * 2026-10-14 - 0.17: min/max block grid to contour only the blocks a level crosses
+ * 2026-10-14 - 0.18: on-disk cache of contoured, smoothed and decimated surfaces
+ * 2026-10-14 - 0.19: server mode: JSON-lines jobs on a worker pool with resident maps
+ * 2026-10-14 - 0.20: output streamed to stdout or any file descriptor
+ * 2026-10-14 - 0.21: Float32 or 16-bit quantized points and 32-bit cell arrays in the output
+ * 2026-10-14 - 0.22: vertex-cache (Tipsify) and Morton reordering with first-use vertex numbering
+ * 2026-10-14 - 0.23: parallel union-find filter of small/extra connected components after contouring
+ * 2026-10-14 - 0.24: Gaussian or median pre-filtering of the voxels, in place or slab by slab
+ * 2026-10-14 - 0.25: parallel smooth vertex normals in the output, optionally oct-encoded
+ * 2026-10-14 - 0.26: label maps: one surface per label from discrete flying edges, split by label
+ * 2026-10-14 - 0.27: binary glTF (GLB) output of indexed, optionally quantized triangles
+ * 2026-10-14 - 0.28: pool of point, cell and scratch buffers reused across stages and jobs
+ * 2026-10-14 - 0.29: JSON-line progress events, cancellation by signal or deadline, and exit codes
+ * 2026-10-14 - 0.30: libmeshmaker: the pipeline as a library with a C/C++ API for in-memory volumes
+ * 2026-10-14 - 0.31: MPI-distributed meshing of slabs per rank, merged on rank 0 or written as a .pvtp
  */
 
 // standard headers
 #include <exception>
+#include <stdexcept>
+#include <chrono>
+#include <atomic>
+#include <memory>
+#include <algorithm>
+#include <cmath>
 #include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <cstdint>
+#include <climits>
+#include <utility>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+
+// POSIX headers
+#include <unistd.h>
 
 // VTK headers
 #include "vtkSmartPointer.h"
 #include "vtkMRCReader.h"
+#include "vtkImageData.h"
+#include "vtkExtractVOI.h"
+#include "vtkImageShrink3D.h"
+#include "vtkPolyData.h"
+#include "vtkCellArray.h"
+#include "vtkPoints.h"
+#include "vtkIdList.h"
+#include "vtkPointData.h"
+#include "vtkCellData.h"
+#include "vtkFieldData.h"
+#include "vtkFloatArray.h"
+#include "vtkDoubleArray.h"
+#include "vtkUnsignedShortArray.h"
+#include "vtkIntArray.h"
 #include "vtkContourFilter.h"
+#include "vtkFlyingEdges3D.h"
+#include "vtkDiscreteFlyingEdges3D.h"
+#include "vtkSMPTools.h"
 #include "vtkTriangleFilter.h"
 #include "vtkSmoothPolyDataFilter.h"
 #include "vtkDecimatePro.h"
 #include "vtkStripper.h"
+#include "vtkAppendPolyData.h"
+#include "vtkStaticCleanPolyData.h"
 #include "vtkXMLPolyDataWriter.h"
 #include "vtkSTLWriter.h"
 #include "vtkPolyDataWriter.h"
+#include "vtkCallbackCommand.h"
+
+#include "volume.h"
+#include "laplacian.h"
+#include "quadric.h"
+#include "profile.h"
+#include "cache.h"
+#include "resident.h"
+#include "server.h"
+#include "reorder.h"
+#include "components.h"
+#include "prefilter.h"
+#include "normals.h"
+#include "stl_writer.h"
+#include "vtp_writer.h"
+#include "glb_writer.h"
+#include "pool.h"
+#include "progress.h"
+#include "distributed.h"
+#include "meshmaker.h"
 
 using namespace std;
 
-// types
-struct args {
-	float clevel = 0.0;
-	string out_fn = "out";
-	string map_fn = "";
-	string out_format = "vtp";
-	int decimate = 0; // don't decimate by default
-	int smooth = 0; // smoothen
-	int smooth_iter = 20; // number of smoothing iterations
-	float target_reduction = 0.9;
-	int ascii = 0; // output not ASCII but BINARY (if = 1 then ASCII)
-	int uint64 = 0; // headers of vtp are NOT in uint64 but in uint32
-	int int32 = 0; // vtkIdType used are 64 bit instead of 32 bit 
-	int verbose = 0; // do not show verbose output
-	string out_fn_full = "";
-}; 
 
 void print_usage(void) {
 string usage_string = "\
-usage: meshmaker [options] file.map\n\
+usage: meshmaker [options] file.map [file.map ...]\n\
 \n\
 Generate a mesh from the MAP/MRC file using the specified options\n\
 \n\
 Options:\n\
-\t-c/--clevel <float>\n\t\t\tthe contour level at which to build the surface [default: 0.0]\n\
-\t-o/--output <str>\n\t\t\tthe prefix of the output file to be combined with the extension (see below) [default: out]\n\
+\t-c/--clevel <float[,float...]>\n\t\t\tthe contour level(s) at which to build the surface, extracted together by one filter; may be repeated to build several surfaces [default: 0.0]\n\
+\t-1/--one-file\twrite all contour levels to one file, labelled by a 'clevel' point array [default: false]\n\
+\t-l/--labels\ttreat the voxels as integer labels (e.g. a segmentation) and mesh the boundary of each label with vtkDiscreteFlyingEdges3D, whatever -e says: every non-zero label in the map or only those given with -c, one file each or with -1 together, labelled by a 'label' cell array [default: false]\n\
+\t-o/--output <str>\n\t\t\tthe prefix of the output file to be combined with the extension (see below), or '-' to write the mesh to stdout [default: out]\n\
+\t--output-fd <int>\n\t\t\twrite the mesh to this open file descriptor (e.g. a pipe) instead of a file\n\
+\t-m/--manifest <str>\n\t\t\ta batch file with one '<map> <prefix> [<clevel> ...]' entry per line\n\
 \t-S/--stl\toutput in STL format\n\
 \t-V/--vtk\toutput in VTK format\n\
 \t-X/--vtp\toutput in VTP format [default]\n\
+\t-G/--glb\toutput in binary glTF 2.0 (GLB) format: indexed triangles, with --quantize and --oct-normals (as 3 x Int16) under KHR_mesh_quantization, and each label of -l -1 as a primitive of its own\n\
+\t-e/--engine <str>\n\t\t\tisosurface extraction engine: 'contour' (vtkContourFilter) or 'flying-edges' (multi-threaded vtkFlyingEdges3D) [default: contour]\n\
+\t-j/--threads <int>\n\t\t\tnumber of worker threads for multi-threaded stages [default: all available]\n\
+\t-M/--mmap\tmemory-map the map and contour it one slab of sections at a time [default: false]\n\
+\t-z/--slab <int>\n\t\t\tnumber of sections per slab (only applies if -M/--mmap is specified) [default: 64]\n\
+\t-B/--brick <int>\n\t\t\tcontour, smooth and decimate bricks of this many voxels along each edge concurrently, then merge their seams [default: 0 (off)]\n\
+\t--distributed <str>\n\t\t\tunder mpirun, contour, smooth and decimate a slab of sections of each map on every rank, then 'merge' the pieces on rank 0 or write them as a partitioned 'pvtp' (needs a build with MPI)\n\
+\t-E/--skip-empty <int>\n\t\t\tindex the min/max of blocks of this many voxels along each edge and contour only those a contour level crosses [default: 0 (off)]\n\
+\t--gaussian <float>\n\t\t\tsmooth the voxels with a Gaussian of this standard deviation (in voxels) before contouring [default: off]\n\
+\t--median\tapply a 3x3x3 median filter to the voxels before contouring [default: off]\n\
+\t--keep-largest <int>\n\t\t\tkeep only this many of the connected components with the most triangles at each level (also with -1); components are filtered right after contouring, or with -B once the bricks are refined and merged [default: 0 (all)]\n\
+\t--min-triangles <int>\n\t\t\tdrop connected components of fewer triangles [default: 0]\n\
+\t--min-volume <float>\n\t\t\tdrop connected components that enclose less volume, in the cell's units cubed [default: 0.0]\n\
+\t--crop <int,int,int,int,int,int>\n\t\t\tmesh only voxels i0 to i1, j0 to j1 and k0 to k1 (inclusive, from 0); only these are read\n\
+\t--crop-physical <float,float,float,float,float,float>\n\t\t\tmesh only within x0 to x1, y0 to y1 and z0 to z1 in the map's units (usually Angstrom); only these voxels are read\n\
+\t--autocrop\tmesh only the bounding box of the voxels above the lowest contour level (with -l, of the non-zero voxels) [default: false]\n\
+\t--stride <int>\n\t\t\tkeep every n-th voxel along each axis for quick previews (not with -M or -B) [default: 1]\n\
+\t--bin <int>\n\t\t\taverage n^3 voxels into one for quick previews (not with -M or -B) [default: 1]\n\
 \t-D/--decimate\tperform progressive decimation to eliminate superfluous polygons [default: false]\n\
 \t-s/--smooth\tsmooth the generated surface [default: false]\n\
 \t-i/--smooth-iter <int>\n\t\t\tnumber of iterations for smoothing (only applies if -s/--smooth is specified[default: 20]\n\
+\t--smooth-engine <str>\n\t\t\tsmoothing engine: 'vtk' (vtkSmoothPolyDataFilter) or 'parallel' (multi-threaded, equivalent to within a small tolerance) [default: vtk]\n\
 \t-t/--target-reduction <float>\n\t\t\tset the target reduction in the number of polygon in interval (0, 1) [default: 0.9]\n\
+\t-L/--lod <float,...>\n\t\t\twrite a level of detail for each of these comma-separated target reductions in [0, 1), each decimated from the previous one, plus a JSON index (replaces -D/-t)\n\
+\t--decimate-engine <str>\n\t\t\tdecimation engine: 'pro' (vtkDecimatePro) or 'quadric' (quadric edge collapse over concurrent partitions) [default: pro]\n\
+\t-O/--optimize <str>\n\t\t\treorder the triangles for GPU vertex caches and number the points in order of first use: 'cache' (Tipsify), 'morton' (along a Morton curve first) or 'none'; the triangles are then written as such, not as strips [default: none]\n\
+\t--vertex-cache <int>\n\t\t\tentries of the vertex cache to optimize for with -O [default: 16]\n\
 \t-A/--ascii\tsave data as ASCII as opposed to BINARY [default: false]\n\
 \t-U/--uint64\tsave VTP headers using UInt64 as opposed to UInt32 [default: false]\n\
-\t-I/--int32\tuse Int32 for vtkIdType instead of Int64 [default: false]\n\
+\t-I/--int32\tuse Int32 for vtkIdType instead of Int64, and 32-bit cell arrays in memory [default: false]\n\
+\t--float32\twrite points as Float32 whatever precision they were computed in [default: false]\n\
+\t--quantize\twrite points as UInt16 over their bounding box, with the 'quantization_offset' and 'quantization_scale' (x = offset + q * scale) in field data; not for STL [default: false]\n\
+\t-N/--normals\twrite smooth vertex normals as Float32 'Normals' point data; not for STL [default: false]\n\
+\t--oct-normals\twrite the vertex normals oct-encoded as 2 x Int16 'OctNormals' point data instead [default: false]\n\
+\t--compressor <str>\n\t\t\tcompress VTP arrays with 'zlib', 'lz4' or 'lzma' (in blocks, on all threads) or 'none' [default: none]\n\
+\t--compression-level <int>\n\t\t\tcompression level from 1 (fastest) to 9 (smallest) [default: 5]\n\
+\t--block-size <int>\n\t\t\tbytes of uncompressed data per compressed block [default: 32768]\n\
+\t-a/--appended\twrite VTP arrays as raw binary in an appended section directly from memory instead of inline base64 [default: false]\n\
+\t--align <int>\n\t\t\tstart each appended VTP array at a multiple of this many bytes in the file, e.g. 4096 for range requests [default: 0 (packed)]\n\
+\t--cache <str>\n\t\t\tkeep the surfaces after contouring, smoothing and decimation in this directory and resume from the deepest stage already there for the same map and options\n\
+\t--serve\trun jobs read from stdin as JSON lines {\"id\": ..., \"args\": [<option or map>, ...]} and answer each with a JSON line on stdout [default: false]\n\
+\t--workers <int>\n\t\t\tnumber of jobs run at once when serving [default: 2]\n\
+\t--resident <int>\n\t\t\tmegabytes of recently used maps (and their -E indices) kept in memory when serving [default: 2048]\n\
+\t--pool <int>\n\t\t\tmegabytes of freed point, cell and scratch buffers kept for reuse by later stages and jobs [default: 0 (off)]\n\
+\t-P/--profile <str>\n\t\t\twrite per-stage wall/CPU time, peak RSS growth and point/cell counts as JSON to this file ('-' for stderr)\n\
+\t--progress\treport each stage, its percentage done and each file written as JSON lines on stderr [default: false]\n\
+\t--deadline <float>\n\t\t\tcancel the jobs (exit code 3) after this many seconds, after the stage running at the time stops [default: none]\n\
 \t-h/--help\tshow this help\n\
 \t-v/--verbose\tverbose output\n";
 	cerr << usage_string << endl;
@@ -85,7 +200,10 @@ struct args parse_args(int argc, char **argv) {
 		// clevel	
 		if (strcmp(argv[i], "-c") == 0 || strcmp(argv[i], "--clevel") == 0) {
 			try {
-				cargs.clevel = stof(argv[i+1]);				
+				stringstream list(argv[i+1]);
+				string level;
+				while (getline(list, level, ','))
+					cargs.clevels.push_back(stof(level));
 			}
 			catch (exception& e) {
 				cerr << "exception caught: " << e.what() << endl;
@@ -93,11 +211,40 @@ struct args parse_args(int argc, char **argv) {
 			}
 			i += 2;		
 		}
+		// all levels in one file
+		else if (strcmp(argv[i], "-1") == 0 || strcmp(argv[i], "--one-file") == 0) {
+			cargs.single = 1;
+			i++;
+		}
+		// label map
+		else if (strcmp(argv[i], "-l") == 0 || strcmp(argv[i], "--labels") == 0) {
+			cargs.labels = 1;
+			i++;
+		}
 		// output prefix
 		else if (strcmp(argv[i], "-o") == 0 || strcmp(argv[i], "--output") == 0) {
 			cargs.out_fn = argv[i+1];
 			i += 2;
 		}
+		// output stream
+		else if (strcmp(argv[i], "--output-fd") == 0) {
+			try {
+				cargs.out_fd = stoi(argv[i+1]);
+			} catch (exception& e) {
+				cerr << "exception caught: " << e.what() << endl;
+				_abort = 1;
+			}
+			if (cargs.out_fd < 0) {
+				cerr << "Invalid file descriptor: " << cargs.out_fd << endl;
+				_abort = 1;
+			}
+			i += 2;
+		}
+		// batch manifest
+		else if (strcmp(argv[i], "-m") == 0 || strcmp(argv[i], "--manifest") == 0) {
+			cargs.manifest_fn = argv[i+1];
+			i += 2;
+		}
 		// output format: STL
 		else if (strcmp(argv[i], "-S") == 0 || strcmp(argv[i], "--stl") == 0) {
 			cargs.out_format = "stl";
@@ -113,6 +260,149 @@ struct args parse_args(int argc, char **argv) {
 			cargs.out_format = "vtp";
 			i++;
 		}
+		// output format: GLB (binary glTF)
+		else if (strcmp(argv[i], "-G") == 0 || strcmp(argv[i], "--glb") == 0) {
+			cargs.out_format = "glb";
+			i++;
+		}
+		// extraction engine
+		else if (strcmp(argv[i], "-e") == 0 || strcmp(argv[i], "--engine") == 0) {
+			cargs.engine = argv[i+1];
+			if (cargs.engine.compare("contour") != 0 && cargs.engine.compare("flying-edges") != 0) {
+				cerr << "Unknown extraction engine: " << cargs.engine << endl;
+				_abort = 1;
+			}
+			i += 2;
+		}
+		// worker threads
+		else if (strcmp(argv[i], "-j") == 0 || strcmp(argv[i], "--threads") == 0) {
+			try {
+				cargs.threads = stoi(argv[i+1]);
+			} catch (exception& e) {
+				cerr << "exception caught: " << e.what() << endl;
+				_abort = 1;
+			}
+			if (cargs.threads < 0) {
+				cerr << "Number of threads must not be negative: " << cargs.threads << endl;
+				_abort = 1;
+			}
+			i += 2;
+		}
+		// memory-mapped input
+		else if (strcmp(argv[i], "-M") == 0 || strcmp(argv[i], "--mmap") == 0) {
+			cargs.mmap = 1;
+			i++;
+		}
+		// sections per slab
+		else if (strcmp(argv[i], "-z") == 0 || strcmp(argv[i], "--slab") == 0) {
+			try {
+				cargs.slab = stoi(argv[i+1]);
+			} catch (exception& e) {
+				cerr << "exception caught: " << e.what() << endl;
+				_abort = 1;
+			}
+			if (cargs.slab < 1) {
+				cerr << "Slab must contain at least one section: " << cargs.slab << endl;
+				_abort = 1;
+			}
+			i += 2;
+		}
+		// brick edge length
+		else if (strcmp(argv[i], "-B") == 0 || strcmp(argv[i], "--brick") == 0) {
+			try {
+				cargs.brick = stoi(argv[i+1]);
+			} catch (exception& e) {
+				cerr << "exception caught: " << e.what() << endl;
+				_abort = 1;
+			}
+			if (cargs.brick != 0 && cargs.brick < 2) {
+				cerr << "Bricks must be at least 2 voxels along each edge: " << cargs.brick << endl;
+				_abort = 1;
+			}
+			i += 2;
+		}
+		// slabs per MPI rank
+		else if (strcmp(argv[i], "--distributed") == 0) {
+			cargs.distributed = argv[i+1];
+			if (cargs.distributed.compare("merge") != 0 && cargs.distributed.compare("pvtp") != 0) {
+				cerr << "Invalid distributed output: " << cargs.distributed << " (must be 'merge' or 'pvtp')" << endl;
+				_abort = 1;
+			}
+			i += 2;
+		}
+		// min/max block edge length
+		else if (strcmp(argv[i], "-E") == 0 || strcmp(argv[i], "--skip-empty") == 0) {
+			try {
+				cargs.skip_empty = stoi(argv[i+1]);
+			} catch (exception& e) {
+				cerr << "exception caught: " << e.what() << endl;
+				_abort = 1;
+			}
+			if (cargs.skip_empty != 0 && cargs.skip_empty < 2) {
+				cerr << "Blocks must be at least 2 voxels along each edge: " << cargs.skip_empty << endl;
+				_abort = 1;
+			}
+			i += 2;
+		}
+		// smooth the voxels before contouring
+		else if (strcmp(argv[i], "--gaussian") == 0) {
+			cargs.prefilter = "gaussian";
+			try {
+				cargs.sigma = stod(argv[i+1]);
+			} catch (exception& e) {
+				cerr << "exception caught: " << e.what() << endl;
+				_abort = 1;
+			}
+			if (cargs.sigma <= 0) {
+				cerr << "The standard deviation of the Gaussian must be positive: " << cargs.sigma << endl;
+				_abort = 1;
+			}
+			i += 2;
+		}
+		else if (strcmp(argv[i], "--median") == 0) {
+			cargs.prefilter = "median";
+			i++;
+		}
+		// connected components to keep
+		else if (strcmp(argv[i], "--keep-largest") == 0) {
+			try {
+				cargs.components.largest = stoi(argv[i+1]);
+			} catch (exception& e) {
+				cerr << "exception caught: " << e.what() << endl;
+				_abort = 1;
+			}
+			if (cargs.components.largest < 0) {
+				cerr << "The number of components to keep cannot be negative: " << cargs.components.largest << endl;
+				_abort = 1;
+			}
+			i += 2;
+		}
+		else if (strcmp(argv[i], "--min-triangles") == 0) {
+			try {
+				cargs.components.min_polys = stoi(argv[i+1]);
+			} catch (exception& e) {
+				cerr << "exception caught: " << e.what() << endl;
+				_abort = 1;
+			}
+			if (cargs.components.min_polys < 0) {
+				cerr << "The minimum component size cannot be negative: " << cargs.components.min_polys << endl;
+				_abort = 1;
+			}
+			i += 2;
+		}
+		else if (strcmp(argv[i], "--min-volume") == 0) {
+			try {
+				cargs.components.min_volume = stod(argv[i+1]);
+			} catch (exception& e) {
+				cerr << "exception caught: " << e.what() << endl;
+				_abort = 1;
+			}
+			if (cargs.components.min_volume < 0) {
+				cerr << "The minimum component volume cannot be negative: " << cargs.components.min_volume << endl;
+				_abort = 1;
+			}
+			i += 2;
+		}
 		// decimate the mesh
 		else if (strcmp(argv[i], "-D") == 0 || strcmp(argv[i], "--decimate") == 0) {
 			cargs.decimate = 1;
@@ -126,7 +416,16 @@ struct args parse_args(int argc, char **argv) {
 		// smooth iterations
 		else if (strcmp(argv[i], "-i") == 0 || strcmp(argv[i], "--smooth-iter") == 0) {
 		    cargs.smooth_iter = stoi(argv[i+1]);
-		    i++;
+		    i += 2;
+		}
+		// smoothing engine
+		else if (strcmp(argv[i], "--smooth-engine") == 0) {
+			cargs.smooth_engine = argv[i+1];
+			if (cargs.smooth_engine.compare("vtk") != 0 && cargs.smooth_engine.compare("parallel") != 0) {
+				cerr << "Unknown smoothing engine: " << cargs.smooth_engine << endl;
+				_abort = 1;
+			}
+			i += 2;
 		}
 		// target reduction for decimation
 		else if (strcmp(argv[i], "-t") == 0 || strcmp(argv[i], "--target-reduction") == 0) {
@@ -143,6 +442,38 @@ struct args parse_args(int argc, char **argv) {
 			}
 			i += 2;
 		}
+		// decimation engine
+		else if (strcmp(argv[i], "--decimate-engine") == 0) {
+			cargs.decimate_engine = argv[i+1];
+			if (cargs.decimate_engine.compare("pro") != 0 && cargs.decimate_engine.compare("quadric") != 0) {
+				cerr << "Unknown decimation engine: " << cargs.decimate_engine << endl;
+				_abort = 1;
+			}
+			i += 2;
+		}
+		// triangle order
+		else if (strcmp(argv[i], "-O") == 0 || strcmp(argv[i], "--optimize") == 0) {
+			cargs.optimize = argv[i+1];
+			if (cargs.optimize.compare("none") != 0 && cargs.optimize.compare("cache") != 0 && cargs.optimize.compare("morton") != 0) {
+				cerr << "Unknown optimization: " << cargs.optimize << endl;
+				_abort = 1;
+			}
+			i += 2;
+		}
+		// vertex cache size
+		else if (strcmp(argv[i], "--vertex-cache") == 0) {
+			try {
+				cargs.vertex_cache = stoi(argv[i+1]);
+			} catch (exception& e) {
+				cerr << "exception caught: " << e.what() << endl;
+				_abort = 1;
+			}
+			if (cargs.vertex_cache < 3) {
+				cerr << "The vertex cache must hold at least a triangle: " << cargs.vertex_cache << endl;
+				_abort = 1;
+			}
+			i += 2;
+		}
 		// ASCII
 		else if (strcmp(argv[i], "-A") == 0 || strcmp(argv[i], "--ascii") == 0) {
 			cargs.ascii = 1;
@@ -158,6 +489,224 @@ struct args parse_args(int argc, char **argv) {
 			cargs.int32 = 1;
 			i++;
 		}
+		// vtp compressor
+		else if (strcmp(argv[i], "--compressor") == 0) {
+			cargs.compressor = argv[i+1];
+			if (cargs.compressor.compare("none") != 0 && cargs.compressor.compare("zlib") != 0
+					&& cargs.compressor.compare("lz4") != 0 && cargs.compressor.compare("lzma") != 0) {
+				cerr << "Unknown compressor '" << cargs.compressor << "' (expected 'none', 'zlib', 'lz4' or 'lzma')" << endl;
+				_abort = 1;
+			}
+			i += 2;
+		}
+		// compression level
+		else if (strcmp(argv[i], "--compression-level") == 0) {
+			try {
+				cargs.compression_level = stoi(argv[i+1]);
+				if (cargs.compression_level < 1 || cargs.compression_level > 9) {
+					cerr << "The compression level must be from 1 to 9" << endl;
+					_abort = 1;
+				}
+			}
+			catch (exception& e) {
+				cerr << "exception caught: " << e.what() << endl;
+				_abort = 1;
+			}
+			i += 2;
+		}
+		// compressed block size
+		else if (strcmp(argv[i], "--block-size") == 0) {
+			try {
+				cargs.block_size = stoi(argv[i+1]);
+				if (cargs.block_size < 1024) {
+					cerr << "The block size must be at least 1024 bytes" << endl;
+					_abort = 1;
+				}
+			}
+			catch (exception& e) {
+				cerr << "exception caught: " << e.what() << endl;
+				_abort = 1;
+			}
+			i += 2;
+		}
+		// raw appended vtp
+		else if (strcmp(argv[i], "-a") == 0 || strcmp(argv[i], "--appended") == 0) {
+			cargs.appended = 1;
+			i++;
+		}
+		// appended array alignment
+		else if (strcmp(argv[i], "--align") == 0) {
+			try {
+				cargs.align = stoi(argv[i+1]);
+				if (cargs.align < 0) {
+					cerr << "The alignment must not be negative" << endl;
+					_abort = 1;
+				}
+			}
+			catch (exception& e) {
+				cerr << "exception caught: " << e.what() << endl;
+				_abort = 1;
+			}
+			i += 2;
+		}
+		// LOD pyramid
+		else if (strcmp(argv[i], "-L") == 0 || strcmp(argv[i], "--lod") == 0) {
+			try {
+				stringstream list(argv[i+1]);
+				string item;
+				while (getline(list, item, ',')) {
+					float reduction = stof(item);
+					if (reduction < 0.0 || reduction >= 1.0) {
+						cerr << "LOD target reductions must be in [0, 1)" << endl;
+						_abort = 1;
+					}
+					cargs.lods.push_back(reduction);
+				}
+			}
+			catch (exception& e) {
+				cerr << "exception caught: " << e.what() << endl;
+				_abort = 1;
+			}
+			sort(cargs.lods.begin(), cargs.lods.end());
+			cargs.lods.erase(unique(cargs.lods.begin(), cargs.lods.end()), cargs.lods.end());
+			i += 2;
+		}
+		// crop box in voxels or physical units
+		else if (strcmp(argv[i], "--crop") == 0 || strcmp(argv[i], "--crop-physical") == 0) {
+			vector<double>& box = strcmp(argv[i], "--crop") == 0 ? cargs.crop : cargs.crop_physical;
+			try {
+				stringstream list(argv[i+1]);
+				string item;
+				box.clear();
+				while (getline(list, item, ','))
+					box.push_back(stod(item));
+			}
+			catch (exception& e) {
+				cerr << "exception caught: " << e.what() << endl;
+				_abort = 1;
+			}
+			if (box.size() != 6 || box[0] > box[1] || box[2] > box[3] || box[4] > box[5]) {
+				cerr << argv[i] << " expects six comma-separated values: x0,x1,y0,y1,z0,z1 with x0 <= x1 and so on" << endl;
+				_abort = 1;
+			}
+			i += 2;
+		}
+		// autocrop
+		else if (strcmp(argv[i], "--autocrop") == 0) {
+			cargs.autocrop = 1;
+			i++;
+		}
+		// stride and binning
+		else if (strcmp(argv[i], "--stride") == 0 || strcmp(argv[i], "--bin") == 0) {
+			int& factor = strcmp(argv[i], "--stride") == 0 ? cargs.stride : cargs.bin;
+			try {
+				factor = stoi(argv[i+1]);
+				if (factor < 1) {
+					cerr << argv[i] << " must be at least 1" << endl;
+					_abort = 1;
+				}
+			}
+			catch (exception& e) {
+				cerr << "exception caught: " << e.what() << endl;
+				_abort = 1;
+			}
+			i += 2;
+		}
+		// Float32 points
+		else if (strcmp(argv[i], "--float32") == 0) {
+			cargs.float32 = 1;
+			i++;
+		}
+		// quantized points
+		else if (strcmp(argv[i], "--quantize") == 0) {
+			cargs.quantize = 1;
+			i++;
+		}
+		// vertex normals
+		else if (strcmp(argv[i], "-N") == 0 || strcmp(argv[i], "--normals") == 0) {
+			cargs.normals = 1;
+			i++;
+		}
+		else if (strcmp(argv[i], "--oct-normals") == 0) {
+			cargs.normals = 2;
+			i++;
+		}
+		// profile
+		else if (strcmp(argv[i], "-P") == 0 || strcmp(argv[i], "--profile") == 0) {
+			cargs.profile_fn = argv[i+1];
+			i += 2;
+		}
+		// stage cache
+		else if (strcmp(argv[i], "--cache") == 0) {
+			cargs.cache_dir = argv[i+1];
+			i += 2;
+		}
+		// server mode
+		else if (strcmp(argv[i], "--serve") == 0) {
+			cargs.serve = 1;
+			i++;
+		}
+		// server worker pool
+		else if (strcmp(argv[i], "--workers") == 0) {
+			try {
+				cargs.workers = stoi(argv[i+1]);
+			} catch (exception& e) {
+				cerr << "exception caught: " << e.what() << endl;
+				_abort = 1;
+			}
+			if (cargs.workers < 1) {
+				cerr << "Servers need at least one worker: " << cargs.workers << endl;
+				_abort = 1;
+			}
+			i += 2;
+		}
+		// resident maps
+		else if (strcmp(argv[i], "--resident") == 0) {
+			try {
+				cargs.resident_mb = stoi(argv[i+1]);
+			} catch (exception& e) {
+				cerr << "exception caught: " << e.what() << endl;
+				_abort = 1;
+			}
+			if (cargs.resident_mb < 0) {
+				cerr << "Resident memory cannot be negative: " << cargs.resident_mb << endl;
+				_abort = 1;
+			}
+			i += 2;
+		}
+		// buffer pool
+		else if (strcmp(argv[i], "--pool") == 0) {
+			try {
+				cargs.pool_mb = stoi(argv[i+1]);
+			} catch (exception& e) {
+				cerr << "exception caught: " << e.what() << endl;
+				_abort = 1;
+			}
+			if (cargs.pool_mb < 0) {
+				cerr << "Pool memory cannot be negative: " << cargs.pool_mb << endl;
+				_abort = 1;
+			}
+			i += 2;
+		}
+		// progress events
+		else if (strcmp(argv[i], "--progress") == 0) {
+			cargs.progress_json = 1;
+			i++;
+		}
+		// deadline
+		else if (strcmp(argv[i], "--deadline") == 0) {
+			try {
+				cargs.deadline = stod(argv[i+1]);
+			} catch (exception& e) {
+				cerr << "exception caught: " << e.what() << endl;
+				_abort = 1;
+			}
+			if (cargs.deadline <= 0) {
+				cerr << "The deadline must be positive: " << cargs.deadline << endl;
+				_abort = 1;
+			}
+			i += 2;
+		}
 		// verbose
 		else if (strcmp(argv[i], "-v") == 0 || strcmp(argv[i], "--verbose") == 0) {
 			cargs.verbose = 1;
@@ -166,27 +715,22 @@ struct args parse_args(int argc, char **argv) {
 		// help
 		else if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
 			print_usage();
-			abort();
+			throw help_requested();
 		}
 		// map file
-		else { // only one positional argument
-			try {
-				cargs.map_fn = argv[i];				
-			}
-			catch (exception& e) {
-				cerr << "exception caught: " << e.what() << endl;
-				_abort = 1; 
-			}
+		else { // one or more positional arguments
+			cargs.map_fns.push_back(argv[i]);
 			i++;
 		}
 	}
 	
-	// out_fn_full
-	cargs.out_fn_full = cargs.out_fn + "." + cargs.out_format;
+	// default contour level (label maps are meshed at every label they hold)
+	if (cargs.clevels.empty() && !cargs.labels)
+		cargs.clevels.push_back(0.0);
 	
 	// sanity checks
-	// make sure that map_fn is not an empty string
-	if (cargs.map_fn.compare("") == 0) {
+	// make sure that we have something to mesh (servers get their maps with each job)
+	if (cargs.map_fns.empty() && cargs.manifest_fn.compare("") == 0 && !cargs.serve) {
 		cerr << "Input MAP/MRC file not specified. Aborting..." << endl;
 		_abort = 1;
 	}
@@ -195,115 +739,1346 @@ struct args parse_args(int argc, char **argv) {
 	if (cargs.uint64 == 1 && cargs.out_format.compare("vtp") != 0) {
 		cerr << "Warning: header set to UInt64 with non-vtp output format (" << cargs.out_format << ")" << endl;
 	}
+
+	// so are compressors and appended data, and only in binary
+	if (cargs.compressor.compare("none") != 0 && (cargs.out_format.compare("vtp") != 0 || cargs.ascii)) {
+		cerr << "Warning: compressor " << cargs.compressor << " ignored for " << (cargs.ascii ? "ASCII " : "") << cargs.out_format << " output" << endl;
+	}
+	if ((cargs.appended || cargs.align > 1) && (cargs.out_format.compare("vtp") != 0 || cargs.ascii)) {
+		cerr << "Warning: appended data ignored for " << (cargs.ascii ? "ASCII " : "") << cargs.out_format << " output" << endl;
+	}
+	// compressed data is always appended
+	if (cargs.compressor.compare("none") != 0 || cargs.align > 1)
+		cargs.appended = 1;
 	
-	// abort if we have to (after seeing all errors)
-	if (_abort) {
-		abort();
+	// every rank maps the file and streams its own slab of it
+	if (cargs.distributed.compare("") != 0) {
+		if (!distributed_available()) {
+			cerr << "--distributed needs meshmaker built with MPI (-DMESHMAKER_WITH_MPI=ON). Aborting..." << endl;
+			_abort = 1;
+		}
+		if (cargs.serve || cargs.brick || cargs.cache_dir.compare("") != 0) {
+			cerr << "--distributed cannot be combined with --serve, -B/--brick or --cache. Aborting..." << endl;
+			_abort = 1;
+		}
+		// the pieces of a partitioned surface are finished where they were meshed
+		if (cargs.distributed.compare("pvtp") == 0) {
+			if (cargs.out_format.compare("vtp") != 0 || cargs.out_fd >= 0 || cargs.out_fn.compare("-") == 0 || !cargs.lods.empty()) {
+				cerr << "--distributed pvtp writes vtp pieces to files, without -L/--lod. Aborting..." << endl;
+				_abort = 1;
+			}
+			if (cargs.components.largest != 0 || cargs.components.min_polys != 0 || cargs.components.min_volume != 0) {
+				cerr << "Warning: component filters ignored with --distributed pvtp (components span the pieces)" << endl;
+				cargs.components = component_filter();
+			}
+		}
+		cargs.mmap = 1;
 	}
-	return cargs;
-}
-
-int main(int argc, char **argv)
-{
-	// get the args
-	struct args cargs = parse_args(argc, argv);
 
-	if (cargs.verbose)
-		cout << "Reading MRC/MAP file..." << cargs.map_fn << endl;
-	vtkSmartPointer<vtkMRCReader> reader = vtkSmartPointer<vtkMRCReader>::New();
-	reader->SetFileName(cargs.map_fn.c_str());
+	// slabs and bricks are contoured at full resolution
+	if ((cargs.stride > 1 || cargs.bin > 1) && (cargs.mmap || cargs.brick)) {
+		cerr << "Warning: --stride/--bin ignored with -M/--mmap or -B/--brick" << endl;
+		cargs.stride = cargs.bin = 1;
+	}
+	if (cargs.stride > 1 && cargs.bin > 1) {
+		cerr << "Warning: --stride ignored with --bin" << endl;
+		cargs.stride = 1;
+	}
+	// averaging would make up labels in between those of neighbouring voxels (a median picks one of them)
+	if (cargs.labels && cargs.bin > 1) {
+		cerr << "Warning: --bin ignored with -l/--labels (use --stride)" << endl;
+		cargs.bin = 1;
+	}
+	if (cargs.labels && cargs.prefilter.compare("gaussian") == 0) {
+		cerr << "Warning: --gaussian ignored with -l/--labels (use --median)" << endl;
+		cargs.prefilter = "none";
+	}
+
+	// GLB is binary only
+	if (cargs.ascii && cargs.out_format.compare("glb") == 0) {
+		cerr << "Warning: -A/--ascii ignored for glb output" << endl;
+		cargs.ascii = 0;
+	}
+
+	// STL has Float32 points only
+	if (cargs.quantize && cargs.out_format.compare("stl") == 0) {
+		cerr << "Warning: --quantize ignored for stl output" << endl;
+		cargs.quantize = 0;
+	}
+	// STL has facet normals of its own
+	if (cargs.normals && cargs.out_format.compare("stl") == 0) {
+		cerr << "Warning: normals ignored for stl output" << endl;
+		cargs.normals = 0;
+	}
+	if (cargs.quantize && cargs.float32) {
+		cerr << "Warning: --float32 ignored with --quantize" << endl;
+		cargs.float32 = 0;
+	}
+
+	// '-' is stdout
+	if (cargs.out_fn.compare("-") == 0 && cargs.out_fd < 0)
+		cargs.out_fd = STDOUT_FILENO;
+
+	// LODs do their own decimation
+	if (!cargs.lods.empty() && cargs.decimate) {
+		cerr << "Warning: -D/--decimate ignored with -L/--lod" << endl;
+		cargs.decimate = 0;
+	}
+
+	// abort if we have to (after seeing all errors)
+	if (_abort) {
+		throw invalid_argument("invalid arguments");
+	}
+	return cargs;
+}
+
+// the file name without its directory and extension
+string file_stem(const string& fn) {
+	size_t start = fn.find_last_of("/\\");
+	start = (start == string::npos) ? 0 : start + 1;
+	size_t end = fn.find_last_of('.');
+	if (end == string::npos || end < start)
+		end = fn.size();
+	return fn.substr(start, end - start);
+}
+
+// collect the jobs from the positional maps and the manifest (if any)
+vector<struct job> make_jobs(const struct args& cargs) {
+	vector<struct job> jobs;
+	
+	// positional maps share the command-line levels; several maps get their stem appended to the prefix
+	for (size_t m = 0; m < cargs.map_fns.size(); m++) {
+		struct job j;
+		j.map_fn = cargs.map_fns[m];
+		if (cargs.map_fns.size() > 1)
+			j.out_fn = cargs.out_fn + "_" + file_stem(j.map_fn);
+		else
+			j.out_fn = cargs.out_fn;
+		j.clevels = cargs.clevels;
+		jobs.push_back(j);
+	}
+	
+	// manifest lines: <map> <prefix> [<clevel> ...]; blank lines and lines starting with '#' are ignored
+	if (cargs.manifest_fn.compare("") != 0) {
+		ifstream manifest(cargs.manifest_fn.c_str());
+		if (!manifest) {
+			cerr << "Unable to open manifest '" << cargs.manifest_fn << "'. Aborting..." << endl;
+			throw runtime_error("unable to open manifest " + cargs.manifest_fn);
+		}
+		string line;
+		int lineno = 0;
+		while (getline(manifest, line)) {
+			lineno++;
+			istringstream fields(line);
+			struct job j;
+			if (!(fields >> j.map_fn) || j.map_fn[0] == '#')
+				continue;
+			if (!(fields >> j.out_fn)) {
+				cerr << cargs.manifest_fn << ":" << lineno << ": missing output prefix. Aborting..." << endl;
+				throw runtime_error("missing output prefix in manifest " + cargs.manifest_fn);
+			}
+			string level;
+			while (fields >> level) {
+				try {
+					stringstream list(level);
+					string item;
+					while (getline(list, item, ','))
+						j.clevels.push_back(stof(item));
+				}
+				catch (exception& e) {
+					cerr << cargs.manifest_fn << ":" << lineno << ": invalid contour level '" << level << "'. Aborting..." << endl;
+					throw runtime_error("invalid contour level '" + level + "' in manifest " + cargs.manifest_fn);
+				}
+			}
+			// fall back on the command-line levels
+			if (j.clevels.empty())
+				j.clevels = cargs.clevels;
+			jobs.push_back(j);
+		}
+	}
+	return jobs;
+}
+
+// the full output file name for the level at index l of job j
+string output_stem(const struct args& cargs, const struct job& j, size_t l) {
+	ostringstream fn;
+	fn << j.out_fn;
+	// disambiguate levels only when there is more than one file
+	if (j.clevels.size() > 1 && !cargs.single)
+		fn << "_" << j.clevels[l];
+	return fn.str();
+}
+
+string output_name(const struct args& cargs, const struct job& j, size_t l) {
+	return output_stem(cargs, j, l) + "." + cargs.out_format;
+}
+
+// VTK's progress of a filter is that of the stage, and a cancelled job aborts the filter
+static void filter_progress(vtkObject *caller, unsigned long, void *client, void *call) {
+	struct progress *progress = static_cast<struct progress *>(client);
+	progress_update(progress, *static_cast<double *>(call));
+	if (progress_cancelled(progress) != NULL)
+		static_cast<vtkAlgorithm *>(caller)->SetAbortExecute(1);
+}
+
+// run a polydata filter and keep only its output so that the filter can be released; with progress
+// the filter reports to it and stops early (leaving the caller's next stage to throw) once it is cancelled
+template <class T>
+vtkSmartPointer<vtkPolyData> run_filter(T *filter, struct progress *progress = NULL) {
+	if (progress != NULL) {
+		vtkSmartPointer<vtkCallbackCommand> observer = vtkSmartPointer<vtkCallbackCommand>::New();
+		observer->SetCallback(filter_progress);
+		observer->SetClientData(progress);
+		filter->AddObserver(vtkCommand::ProgressEvent, observer);
+	}
+	filter->Update();
+	vtkSmartPointer<vtkPolyData> output = vtkSmartPointer<vtkPolyData>::New();
+	output->ShallowCopy(filter->GetOutput());
+	return output;
+}
+
+// the filter's output image, detached from the filter
+template <typename T>
+vtkSmartPointer<vtkImageData> run_image_filter(T *filter) {
+	filter->Update();
+	vtkSmartPointer<vtkImageData> output = vtkSmartPointer<vtkImageData>::New();
+	output->ShallowCopy(filter->GetOutput());
+	return output;
+}
+
+// does only part of the map need to be read
+int has_roi(const struct args& cargs) {
+	return !cargs.crop.empty() || !cargs.crop_physical.empty() || cargs.autocrop;
+}
+
+// the extent of vol to mesh at clevels: the whole volume, limited to the crop box (if any) and, with
+// autocrop, to the voxels above the lowest level within it (of a label map, to those of any label)
+void roi_extent(const struct args& cargs, const struct volume& vol, const vector<float>& clevels, int extent[6]) {
+	for (int a = 0; a < 3; a++) {
+		double lo = 0, hi = vol.dims[a] - 1;
+		if (!cargs.crop.empty()) {
+			lo = max(lo, cargs.crop[2 * a]);
+			hi = min(hi, cargs.crop[2 * a + 1]);
+		}
+		// voxels whose cells overlap the physical box
+		if (!cargs.crop_physical.empty()) {
+			lo = max(lo, floor((cargs.crop_physical[2 * a] - vol.origin[a]) / vol.spacing[a]));
+			hi = min(hi, ceil((cargs.crop_physical[2 * a + 1] - vol.origin[a]) / vol.spacing[a]));
+		}
+		if (lo > hi) {
+			cerr << "The crop box does not overlap the map. Aborting..." << endl;
+			throw runtime_error("the crop box does not overlap the map");
+		}
+		extent[2 * a] = (int)lo;
+		extent[2 * a + 1] = (int)hi;
+	}
+	if (cargs.autocrop) {
+		// one voxel more on each side so that the surface closes
+		int above[6];
+		if (cargs.labels) {
+			if (volume_extent_nonzero(vol, extent, 1, above) == 0)
+				memcpy(extent, above, sizeof(above));
+			else if (cargs.verbose)
+				cout << "No labelled voxels to crop to..." << endl;
+		}
+		else {
+			float level = *min_element(clevels.begin(), clevels.end());
+			if (volume_extent_above(vol, extent, level, 1, above) == 0)
+				memcpy(extent, above, sizeof(above));
+			else if (cargs.verbose)
+				cout << "No voxels above level " << level << " to crop to..." << endl;
+		}
+	}
+	if (cargs.verbose && has_roi(cargs))
+		cout << "Region of interest: voxels " << extent[0] << "-" << extent[1] << ", " << extent[2] << "-" << extent[3]
+			<< ", " << extent[4] << "-" << extent[5] << " of " << vol.dims[0] << "x" << vol.dims[1] << "x" << vol.dims[2] << "..." << endl;
+}
+
+// read the whole map into memory
+vtkSmartPointer<vtkImageData> read_map(const struct args& cargs, const string& map_fn, struct profile *prof) {
+	// callers of the library hand the map over
+	if (cargs.image != NULL)
+		return cargs.image;
+	// a server may still have it from an earlier job
+	if (cargs.resident != NULL) {
+		profile_begin(prof, "resident", NULL);
+		vtkSmartPointer<vtkImageData> image = resident_image(*cargs.resident, map_fn);
+		profile_end(prof, image);
+		if (image != NULL)
+			return image;
+	}
+	if (cargs.verbose)
+		cout << "Reading MRC/MAP file..." << map_fn << endl;
+	profile_begin(prof, "read", NULL);
+	vtkSmartPointer<vtkMRCReader> reader = vtkSmartPointer<vtkMRCReader>::New();
+	reader->SetFileName(map_fn.c_str());
+	reader->Update();
+	vtkSmartPointer<vtkImageData> image = vtkSmartPointer<vtkImageData>::New();
+	image->ShallowCopy(reader->GetOutput());
+	profile_end(prof, image);
+	if (cargs.resident != NULL)
+		image = resident_add_image(*cargs.resident, map_fn, image);
+	return image;
+}
+
+// read only the region of interest of job j through a memory mapping
+vtkSmartPointer<vtkImageData> read_roi(const struct args& cargs, const struct job& j, struct profile *prof) {
+	if (cargs.verbose)
+		cout << "Reading region of interest of MRC/MAP file..." << j.map_fn << endl;
+	// servers cut the region out of the resident map instead, and the library out of the caller's
+	vtkSmartPointer<vtkImageData> whole;
+	if (cargs.resident != NULL || cargs.image != NULL)
+		whole = read_map(cargs, j.map_fn, prof);
+	profile_begin(prof, "read", NULL);
+	struct volume vol;
+	if (whole != NULL) {
+		if (volume_wrap(vol, whole) != 0)
+			throw runtime_error("unsupported voxels in " + j.map_fn);
+	}
+	else if (volume_map(vol, j.map_fn) != 0)
+		throw runtime_error("unable to map " + j.map_fn);
+	int extent[6];
+	roi_extent(cargs, vol, j.clevels, extent);
+	vtkSmartPointer<vtkImageData> image = volume_block(vol, extent);
+	// whole sections of native floats are borrowed from the mapping, which goes now (or from the
+	// resident map, which may be evicted)
+	const unsigned char *scalars = static_cast<const unsigned char *>(image->GetScalarPointer());
+	const unsigned char *mapping = whole != NULL ? vol.data : static_cast<const unsigned char *>(vol.map_addr);
+	size_t mapped = whole != NULL ? (size_t)vol.dims[0] * vol.dims[1] * vol.dims[2] * vol.voxel_size : vol.map_len;
+	if (scalars >= mapping && scalars < mapping + mapped) {
+		vtkSmartPointer<vtkImageData> copy = vtkSmartPointer<vtkImageData>::New();
+		copy->DeepCopy(image);
+		image = copy;
+	}
+	volume_unmap(vol);
+	profile_end(prof, image);
+	return image;
+}
+
+// the labels of job j: every distinct non-zero voxel value within its region of interest; at most as
+// many as the levels of a mesh can be told apart by (see point_levels())
+vector<float> map_labels(const struct args& cargs, const struct job& j, struct profile *prof) {
+	vtkSmartPointer<vtkImageData> whole;
+	if (cargs.resident != NULL || cargs.image != NULL)
+		whole = read_map(cargs, j.map_fn, prof);
+	if (cargs.verbose)
+		cout << "Finding the labels of MRC/MAP file..." << j.map_fn << endl;
+	profile_begin(prof, "labels", NULL);
+	struct volume vol;
+	if (whole != NULL) {
+		if (volume_wrap(vol, whole) != 0)
+			throw runtime_error("unsupported voxels in " + j.map_fn);
+	}
+	else if (volume_map(vol, j.map_fn) != 0)
+		throw runtime_error("unable to map " + j.map_fn);
+	int extent[6];
+	roi_extent(cargs, vol, j.clevels, extent);
+	vector<float> labels;
+	int status = volume_labels(vol, extent, (size_t)USHRT_MAX + 1, labels);
+	volume_unmap(vol);
+	profile_end(prof, NULL);
+	if (status != 0)
+		throw runtime_error("too many labels in " + j.map_fn);
+	if (cargs.verbose)
+		cout << "Found " << labels.size() << " label(s)..." << endl;
+	return labels;
+}
+
+// keep every stride-th voxel or average bins of voxels for a quick preview
+vtkSmartPointer<vtkImageData> subsample(const struct args& cargs, vtkSmartPointer<vtkImageData> image, struct profile *prof) {
+	if (cargs.stride > 1) {
+		if (cargs.verbose)
+			cout << "Keeping every " << cargs.stride << " voxel(s) along each axis..." << endl;
+		profile_begin(prof, "stride", image);
+		vtkSmartPointer<vtkExtractVOI> voi = vtkSmartPointer<vtkExtractVOI>::New();
+		voi->SetInputData(image);
+		voi->SetVOI(image->GetExtent());
+		voi->SetSampleRate(cargs.stride, cargs.stride, cargs.stride);
+		// the last voxel is kept so that the preview spans the same box
+		voi->IncludeBoundaryOn();
+		image = run_image_filter(voi.GetPointer());
+		profile_end(prof, image);
+	}
+	else if (cargs.bin > 1) {
+		if (cargs.verbose)
+			cout << "Averaging " << cargs.bin << "^3 voxels into one..." << endl;
+		profile_begin(prof, "bin", image);
+		vtkSmartPointer<vtkImageShrink3D> shrink = vtkSmartPointer<vtkImageShrink3D>::New();
+		shrink->SetInputData(image);
+		shrink->SetShrinkFactors(cargs.bin, cargs.bin, cargs.bin);
+		shrink->MeanOn();
+		image = run_image_filter(shrink.GetPointer());
+		profile_end(prof, image);
+	}
+	return image;
+}
+
+// image with its voxels smoothed by the selected prefilter, in place unless they are shared with other
+// jobs (a resident map) or the caller of the library, or not floats
+vtkSmartPointer<vtkImageData> filter_image(const struct args& cargs, vtkSmartPointer<vtkImageData> image, struct profile *prof) {
+	if (cargs.prefilter.compare("none") == 0)
+		return image;
+	if (cargs.verbose) {
+		if (cargs.prefilter.compare("gaussian") == 0)
+			cout << "Smoothing the voxels with a Gaussian of sigma " << cargs.sigma << " voxel(s) on " << vtkSMPTools::GetEstimatedNumberOfThreads() << " thread(s)..." << endl;
+		else
+			cout << "Applying a 3x3x3 median filter to the voxels on " << vtkSMPTools::GetEstimatedNumberOfThreads() << " thread(s)..." << endl;
+	}
+	profile_begin(prof, "prefilter", image);
+	vtkFloatArray *scalars = vtkFloatArray::SafeDownCast(image->GetPointData()->GetScalars());
+	if (scalars == NULL || cargs.resident != NULL || cargs.image != NULL) {
+		struct volume vol;
+		if (volume_wrap(vol, image) != 0)
+			throw runtime_error("unsupported voxels");
+		int extent[6] = {0, vol.dims[0] - 1, 0, vol.dims[1] - 1, 0, vol.dims[2] - 1};
+		vtkSmartPointer<vtkImageData> copy = volume_block(vol, extent);
+		// float voxels are borrowed rather than copied
+		if (copy->GetScalarPointer() == image->GetScalarPointer())
+			copy->DeepCopy(image);
+		copy->SetExtent(image->GetExtent());
+		copy->SetOrigin(image->GetOrigin());
+		image = copy;
+		scalars = vtkFloatArray::SafeDownCast(image->GetPointData()->GetScalars());
+	}
+	int dims[3];
+	image->GetDimensions(dims);
+	prefilter_run(scalars->GetPointer(0), dims, cargs.prefilter, cargs.sigma);
+	scalars->Modified();
+	profile_end(prof, image);
+	return image;
+}
+
+// extent grown by halo voxels on every side, within bounds (all inclusive)
+void grow_extent(const int extent[6], int halo, const int bounds[6], int grown[6]) {
+	for (int a = 0; a < 3; a++) {
+		grown[2 * a] = max(extent[2 * a] - halo, bounds[2 * a]);
+		grown[2 * a + 1] = min(extent[2 * a + 1] + halo, bounds[2 * a + 1]);
+	}
+}
+
+// the voxels of vol within extent as a float image, smoothed by the selected prefilter as if the
+// whole of bounds had been (the block is read with a halo of the voxels around it)
+vtkSmartPointer<vtkImageData> read_block(const struct args& cargs, const struct volume& vol, const int extent[6], const int bounds[6]) {
+	int halo = prefilter_halo(cargs.prefilter, cargs.sigma);
+	if (halo == 0)
+		return volume_block(vol, extent);
+	int grown[6];
+	grow_extent(extent, halo, bounds, grown);
+	vtkSmartPointer<vtkImageData> block = volume_block(vol, grown);
+	// whole sections of native floats are borrowed from the (read-only) map
+	const unsigned char *scalars = static_cast<const unsigned char *>(block->GetScalarPointer());
+	if (scalars >= vol.data && scalars < vol.data + (size_t)vol.dims[0] * vol.dims[1] * vol.dims[2] * vol.voxel_size) {
+		vtkSmartPointer<vtkImageData> copy = vtkSmartPointer<vtkImageData>::New();
+		copy->DeepCopy(block);
+		block = copy;
+	}
+	int dims[3];
+	block->GetDimensions(dims);
+	prefilter_run(vtkFloatArray::SafeDownCast(block->GetPointData()->GetScalars())->GetPointer(0), dims, cargs.prefilter, cargs.sigma);
+	vtkSmartPointer<vtkExtractVOI> voi = vtkSmartPointer<vtkExtractVOI>::New();
+	voi->SetInputData(block);
+	voi->SetVOI(extent[0], extent[1], extent[2], extent[3], extent[4], extent[5]);
+	return run_image_filter(voi.GetPointer());
+}
+
+// the level of each point of a multi-level isosurface: the nearest to its scalar, to be safe from rounding;
+// looked up among the sorted levels, as a label map may have thousands
+vector<unsigned short> point_levels(vtkPolyData *mesh, const vector<float>& clevels) {
+	vtkIdType npts = mesh->GetNumberOfPoints();
+	vtkDataArray *scalars = mesh->GetPointData()->GetScalars();
+	vector<unsigned short> level(npts, 0);
+	if (scalars == NULL || clevels.size() < 2)
+		return level;
+	vector<pair<float, unsigned short> > sorted(clevels.size());
+	for (size_t l = 0; l < clevels.size(); l++)
+		sorted[l] = make_pair(clevels[l], (unsigned short)l);
+	sort(sorted.begin(), sorted.end());
+	auto nearest = [&](vtkIdType first, vtkIdType last) {
+		for (vtkIdType p = first; p < last; p++) {
+			double value = scalars->GetComponent(p, 0);
+			size_t hi = lower_bound(sorted.begin(), sorted.end(), make_pair((float)value, (unsigned short)0)) - sorted.begin();
+			if (hi == sorted.size() || (hi > 0 && value - sorted[hi - 1].first <= sorted[hi].first - value))
+				hi--;
+			level[p] = sorted[hi].second;
+		}
+	};
+	vtkSMPTools::For(0, npts, nearest);
+	return level;
+}
+
+// the triangles of a multi-level isosurface at each level, told apart by their point scalars
+vector<vtkSmartPointer<vtkPolyData> > split_levels(vtkPolyData *mesh, const vector<float>& clevels) {
+	size_t nlevels = clevels.size();
+	vtkIdType npts = mesh->GetNumberOfPoints();
+
+	// level of each point and its id within that level
+	vector<unsigned short> level = point_levels(mesh, clevels);
+	vector<vtkIdType> local(npts);
+	vector<vtkIdType> npoints(nlevels, 0);
+	for (vtkIdType p = 0; p < npts; p++)
+		local[p] = npoints[level[p]]++;
+
+	vector<vtkSmartPointer<vtkPolyData> > meshes(nlevels);
+	vector<vtkSmartPointer<vtkCellArray> > polys(nlevels);
+	for (size_t l = 0; l < nlevels; l++) {
+		meshes[l] = vtkSmartPointer<vtkPolyData>::New();
+		vtkSmartPointer<vtkPoints> points = vtkSmartPointer<vtkPoints>::New();
+		points->SetDataType(mesh->GetPoints()->GetDataType());
+		points->SetNumberOfPoints(npoints[l]);
+		meshes[l]->SetPoints(points);
+		meshes[l]->GetPointData()->CopyAllocate(mesh->GetPointData(), npoints[l]);
+		polys[l] = vtkSmartPointer<vtkCellArray>::New();
+		meshes[l]->SetPolys(polys[l]);
+	}
+	double x[3];
+	for (vtkIdType p = 0; p < npts; p++) {
+		mesh->GetPoints()->GetPoint(p, x);
+		meshes[level[p]]->GetPoints()->SetPoint(local[p], x);
+		meshes[level[p]]->GetPointData()->CopyData(mesh->GetPointData(), p, local[p]);
+	}
+
+	// cells never straddle levels
+	vtkIdType n;
+	const vtkIdType *pts;
+	vector<vtkIdType> cell;
+	vtkCellArray *in_polys = mesh->GetPolys();
+	for (in_polys->InitTraversal(); in_polys->GetNextCell(n, pts);) {
+		if (n == 0)
+			continue;
+		cell.resize(n);
+		for (vtkIdType k = 0; k < n; k++)
+			cell[k] = local[pts[k]];
+		polys[level[pts[0]]]->InsertNextCell(n, &cell[0]);
+	}
+	return meshes;
+}
+
+// isosurfaces at all of clevels from one filter (which still sweeps the image once per level), split
+// by their point scalars: one per level, or a single one with a 'clevel' point array if all levels go
+// to one file
+vector<vtkSmartPointer<vtkPolyData> > contour(const struct args& cargs, vtkImageData *image, const vector<float>& clevels, struct profile *prof) {
+	vtkSmartPointer<vtkPolyData> mesh;
+	ostringstream levels;
+	for (size_t l = 0; l < clevels.size(); l++)
+		levels << (l ? ", " : "") << clevels[l];
+	profile_begin(prof, "contour", image);
+	if (cargs.labels) {
+		// every label is contoured on its own (a pass over the volume each), so the surfaces of touching
+		// labels do not share points
+		if (cargs.verbose)
+			cout << "Running discrete flying edges at label(s) " << levels.str() << " on " << vtkSMPTools::GetEstimatedNumberOfThreads() << " thread(s)..." << endl;
+		vtkSmartPointer<vtkDiscreteFlyingEdges3D> cfilt = vtkSmartPointer<vtkDiscreteFlyingEdges3D>::New();
+		cfilt->SetInputData(image);
+		cfilt->SetNumberOfContours(clevels.size());
+		for (size_t l = 0; l < clevels.size(); l++)
+			cfilt->SetValue(l, clevels[l]);
+		// the label of each point tells the surfaces apart
+		cfilt->ComputeScalarsOn();
+		mesh = run_filter(cfilt.GetPointer(), cargs.progress);
+		if (mesh->GetPointData()->GetScalars() != NULL)
+			mesh->GetPointData()->GetScalars()->SetName("label");
+	}
+	else if (cargs.engine.compare("flying-edges") == 0) {
+		// flying edges is SMP-parallel and emits point-merged triangles
+		if (cargs.verbose)
+			cout << "Running flying edges at level(s) " << levels.str() << " on " << vtkSMPTools::GetEstimatedNumberOfThreads() << " thread(s)..." << endl;
+		vtkSmartPointer<vtkFlyingEdges3D> cfilt = vtkSmartPointer<vtkFlyingEdges3D>::New();
+		cfilt->SetInputData(image);
+		cfilt->SetNumberOfContours(clevels.size());
+		for (size_t l = 0; l < clevels.size(); l++)
+			cfilt->SetValue(l, clevels[l]);
+		// the level of each point tells the surfaces apart
+		cfilt->ComputeScalarsOn();
+		mesh = run_filter(cfilt.GetPointer(), cargs.progress);
+	}
+	else {
+		// synchronized templates, like flying edges, sweep the image once for each level
+		if (cargs.verbose)
+			cout << "Running contour filter at level(s) " << levels.str() << "..." << endl;
+		vtkSmartPointer<vtkContourFilter> cfilt = vtkSmartPointer<vtkContourFilter>::New();
+		cfilt->SetInputData(image);
+		cfilt->SetNumberOfContours(clevels.size());
+		for (size_t l = 0; l < clevels.size(); l++)
+			cfilt->SetValue(l, clevels[l]);
+		cfilt->ComputeScalarsOn();
+		mesh = run_filter(cfilt.GetPointer(), cargs.progress);
+	}
+	vector<vtkSmartPointer<vtkPolyData> > meshes;
+	if (clevels.size() == 1 || cargs.single) {
+		if (cargs.single && mesh->GetPointData()->GetScalars() != NULL)
+			mesh->GetPointData()->GetScalars()->SetName("clevel");
+		meshes.push_back(mesh);
+	}
+	else
+		meshes = split_levels(mesh, clevels);
+	profile_end(prof, mesh);
+	return meshes;
+}
+
+// join the meshes of adjacent sub-volumes, merging the duplicate points on the faces they share
+vtkSmartPointer<vtkPolyData> merge_pieces(const vector<vtkSmartPointer<vtkPolyData> >& pieces, double tolerance, struct profile *prof) {
+	vtkSmartPointer<vtkAppendPolyData> append = vtkSmartPointer<vtkAppendPolyData>::New();
+	int inputs = 0;
+	for (size_t p = 0; p < pieces.size(); p++)
+		if (pieces[p]->GetNumberOfPoints() > 0) {
+			append->AddInputData(pieces[p]);
+			inputs++;
+		}
+	if (inputs == 0)
+		return vtkSmartPointer<vtkPolyData>::New();
+	// only merge points; degenerate cells are dropped rather than turned into lines or vertices
+	vtkSmartPointer<vtkStaticCleanPolyData> clean = vtkSmartPointer<vtkStaticCleanPolyData>::New();
+	clean->SetInputConnection(append->GetOutputPort());
+	clean->ToleranceIsAbsoluteOn();
+	clean->SetAbsoluteTolerance(tolerance);
+	clean->ConvertPolysToLinesOff();
+	clean->ConvertLinesToPointsOff();
+	clean->ConvertStripsToPolysOff();
+	profile_begin(prof, "merge", NULL);
+	vtkSmartPointer<vtkPolyData> mesh = run_filter(clean.GetPointer(), prof != NULL ? prof->progress : NULL);
+	profile_end(prof, mesh);
+	return mesh;
+}
+
+// the runs of consecutive blocks along x that some level crosses
+vector<vector<int> > active_runs(const struct volume_ranges& ranges, const vector<float>& clevels) {
+	vector<vector<int> > runs;
+	for (int k = 0; k < ranges.nblocks[2]; k++)
+		for (int j = 0; j < ranges.nblocks[1]; j++)
+			for (int i = 0; i < ranges.nblocks[0]; i++) {
+				int block[6];
+				volume_ranges_block(ranges, i, j, k, block);
+				if (!volume_ranges_straddle(ranges, block, clevels))
+					continue;
+				if (!runs.empty() && runs.back()[1] == block[0] && runs.back()[2] == block[2] && runs.back()[4] == block[4])
+					runs.back()[1] = block[1];
+				else
+					runs.push_back(vector<int>(block, block + 6));
+			}
+	return runs;
+}
+
+// contour only the blocks of ranges over vol that some level crosses, concurrently, adding their
+// surfaces to pieces (one list per output); the pieces share the voxels on their faces
+void contour_active(const struct args& cargs, const struct volume& vol, const struct volume_ranges& ranges, const vector<float>& clevels,
+		vector<vector<vtkSmartPointer<vtkPolyData> > >& pieces, struct profile *prof) {
+	vector<vector<int> > runs = active_runs(ranges, clevels);
+	if (cargs.verbose) {
+		size_t active = 0;
+		for (size_t r = 0; r < runs.size(); r++)
+			active += (runs[r][1] - runs[r][0] + cargs.skip_empty - 1) / cargs.skip_empty;
+		cout << "Contouring " << active << " of " << ranges.lo.size() << " block(s) of " << cargs.skip_empty
+			<< "^3 voxels in " << runs.size() << " run(s)..." << endl;
+	}
+
+	// runs are contoured quietly on all threads, only stopping early if the job is cancelled; the stage
+	// reports the share of runs done
+	profile_begin(prof, "contour", NULL);
+	struct args bargs = cargs;
+	bargs.verbose = 0;
+	struct progress quiet;
+	quiet.parent = cargs.progress;
+	bargs.progress = &quiet;
+	atomic<size_t> done(0);
+	size_t nout = pieces.size();
+	vector<vtkSmartPointer<vtkPolyData> > surfaces(runs.size() * nout);
+	auto work = [&](vtkIdType first, vtkIdType last) {
+		for (vtkIdType r = first; r < last; r++) {
+			if (progress_cancelled(&quiet) != NULL)
+				return;
+			vtkSmartPointer<vtkImageData> block = volume_block(vol, &runs[r][0]);
+			vector<vtkSmartPointer<vtkPolyData> > levels = contour(bargs, block, clevels, NULL);
+			for (size_t l = 0; l < nout; l++)
+				surfaces[l * runs.size() + r] = levels[l];
+			progress_update(cargs.progress, (double)++done / runs.size());
+		}
+	};
+	vtkSMPTools::For(0, (vtkIdType)runs.size(), 1, work);
+	profile_end(prof, NULL);
+	progress_check(cargs.progress);
+	for (size_t l = 0; l < nout; l++)
+		pieces[l].insert(pieces[l].end(), surfaces.begin() + l * runs.size(), surfaces.begin() + (l + 1) * runs.size());
+}
+
+// isosurfaces at clevels of an in-memory image from only the blocks that some level crosses, with the
+// pieces merged again (see contour())
+vector<vtkSmartPointer<vtkPolyData> > contour_blocks(const struct args& cargs, vtkImageData *image, const vector<float>& clevels, struct profile *prof) {
+	struct volume vol;
+	if (volume_wrap(vol, image) != 0)
+		throw runtime_error("unsupported voxels");
+	int extent[6] = {0, vol.dims[0] - 1, 0, vol.dims[1] - 1, 0, vol.dims[2] - 1};
+	// the index of a resident map is kept with it
+	shared_ptr<const struct volume_ranges> ranges;
+	if (cargs.resident != NULL)
+		ranges = resident_ranges(*cargs.resident, image, cargs.skip_empty);
+	if (!ranges) {
+		shared_ptr<struct volume_ranges> built = make_shared<struct volume_ranges>();
+		profile_begin(prof, "minmax", NULL);
+		volume_ranges_build(vol, extent, cargs.skip_empty, *built);
+		profile_end(prof, NULL);
+		ranges = built;
+		if (cargs.resident != NULL)
+			resident_add_ranges(*cargs.resident, image, ranges);
+	}
+	else if (cargs.verbose)
+		cout << "Using the resident min/max index..." << endl;
+	vector<vector<vtkSmartPointer<vtkPolyData> > > pieces(cargs.single ? 1 : clevels.size());
+	contour_active(cargs, vol, *ranges, clevels, pieces, prof);
 
-    // contour
+	double tolerance = 1e-4 * min(vol.spacing[0], min(vol.spacing[1], vol.spacing[2]));
+	vector<vtkSmartPointer<vtkPolyData> > meshes;
+	for (size_t l = 0; l < pieces.size(); l++) {
+		if (cargs.verbose)
+			cout << "Merging " << pieces[l].size() << " run(s)..." << endl;
+		meshes.push_back(merge_pieces(pieces[l], tolerance, prof));
+		pieces[l].clear();
+	}
+	return meshes;
+}
+
+// contour every level of job j from a memory-mapped map one slab at a time; adjacent slabs
+// share a section so that the pieces meet along it. Only sections of part of nparts of the region
+// are contoured (the voxels around them are still read for the prefilter's halo)
+vector<vtkSmartPointer<vtkPolyData> > stream_levels(const struct args& cargs, const struct job& j, int part, int nparts, struct profile *prof) {
+	vector<vtkSmartPointer<vtkPolyData> > meshes;
+	struct volume vol;
 	if (cargs.verbose)
-		cout << "Running contour filter at level " << cargs.clevel << "..." << endl;
-	vtkSmartPointer<vtkContourFilter> cfilt = vtkSmartPointer<vtkContourFilter>::New();
-	cfilt->SetInputConnection(reader->GetOutputPort());
-	cfilt->SetValue(0, cargs.clevel);
-
-	vtkSmartPointer<vtkTriangleFilter> tfilt = vtkSmartPointer<vtkTriangleFilter>::New();
-	vtkSmartPointer<vtkSmoothPolyDataFilter> sfilt = vtkSmartPointer<vtkSmoothPolyDataFilter>::New();
-	vtkSmartPointer<vtkDecimatePro> dfilt = vtkSmartPointer<vtkDecimatePro>::New();
-	if (cargs.decimate || cargs.smooth) {
-	    // triangulate
+		cout << "Memory-mapping MRC/MAP file..." << j.map_fn << endl;
+	if (volume_map(vol, j.map_fn) != 0)
+		throw runtime_error("unable to map " + j.map_fn);
+
+	// reading and contouring are interleaved, slab by slab, for all levels at once
+	if (prof != NULL)
+		prof->has_level = 0;
+	profile_begin(prof, "stream", NULL);
+	size_t nout = cargs.single ? 1 : j.clevels.size();
+	vector<vector<vtkSmartPointer<vtkPolyData> > > pieces(nout);
+	int roi[6];
+	roi_extent(cargs, vol, j.clevels, roi);
+	// parts share their first and last sections as slabs do; a part of no sections has no surface
+	int first = roi[4] + (int)((long long)(roi[5] - roi[4]) * part / nparts);
+	int last = roi[4] + (int)((long long)(roi[5] - roi[4]) * (part + 1) / nparts);
+	for (int z0 = first; z0 < last || (z0 == first && nparts == 1); z0 += cargs.slab) {
+		progress_update(cargs.progress, last > first ? (double)(z0 - first) / (last - first) : 0.0);
+		if (progress_cancelled(cargs.progress) != NULL) {
+			volume_unmap(vol);
+			progress_check(cargs.progress);
+		}
+		int extent[6] = {roi[0], roi[1], roi[2], roi[3], z0, min(z0 + cargs.slab, last)};
 		if (cargs.verbose)
-			cout << "Running triangle filter..." << endl;
-		tfilt->SetInputConnection(cfilt->GetOutputPort());
+			cout << "Contouring sections " << extent[4] << " to " << extent[5] << "..." << endl;
+		// the index of a filtered slab is built from its filtered voxels
+		if (cargs.skip_empty && cargs.prefilter.compare("none") != 0) {
+			vtkSmartPointer<vtkImageData> block = read_block(cargs, vol, extent, roi);
+			struct volume filtered;
+			if (volume_wrap(filtered, block) != 0)
+				throw runtime_error("unsupported voxels in " + j.map_fn);
+			int whole[6] = {0, filtered.dims[0] - 1, 0, filtered.dims[1] - 1, 0, filtered.dims[2] - 1};
+			struct volume_ranges ranges;
+			volume_ranges_build(filtered, whole, cargs.skip_empty, ranges);
+			contour_active(cargs, filtered, ranges, j.clevels, pieces, NULL);
+		}
+		else if (cargs.skip_empty) {
+			struct volume_ranges ranges;
+			volume_ranges_build(vol, extent, cargs.skip_empty, ranges);
+			contour_active(cargs, vol, ranges, j.clevels, pieces, NULL);
+		}
+		else {
+			vtkSmartPointer<vtkImageData> block = read_block(cargs, vol, extent, roi);
+			vector<vtkSmartPointer<vtkPolyData> > levels = contour(cargs, block, j.clevels, NULL);
+			for (size_t l = 0; l < nout; l++)
+				pieces[l].push_back(levels[l]);
+		}
+		// the shared section (and the halo of a filtered slab) is needed again by the next slab
+		int halo = prefilter_halo(cargs.prefilter, cargs.sigma);
+		volume_release(vol, max(extent[4] - halo, roi[4]), extent[5] - 1 - halo);
+	}
+	volume_unmap(vol);
+	profile_end(prof, NULL);
+
+	// points computed from the same shared voxels coincide to within rounding
+	double tolerance = 1e-4 * min(vol.spacing[0], min(vol.spacing[1], vol.spacing[2]));
+	for (size_t l = 0; l < nout; l++) {
+		if (cargs.verbose && cargs.single)
+			cout << "Merging " << pieces[l].size() << " piece(s) of all levels..." << endl;
+		else if (cargs.verbose)
+			cout << "Merging " << pieces[l].size() << " piece(s) at level " << j.clevels[l] << "..." << endl;
+		if (prof != NULL) {
+			prof->has_level = !cargs.single;
+			prof->clevel = j.clevels[l];
+		}
+		meshes.push_back(merge_pieces(pieces[l], tolerance, prof));
+		pieces[l].clear();
+	}
+	return meshes;
+}
+
+// whether mesh consists of triangles only, i.e. running vtkTriangleFilter would change nothing
+int is_triangle_mesh(vtkPolyData *mesh) {
+	if (mesh->GetNumberOfVerts() > 0 || mesh->GetNumberOfLines() > 0 || mesh->GetNumberOfStrips() > 0)
+		return 0;
+	vtkCellArray *polys = mesh->GetPolys();
+	return polys->GetNumberOfCells() == 0 || polys->IsHomogeneous() == 3;
+}
+
+// the partitions of the quadric engine; bricks are already processed concurrently so they are not
+// partitioned again. The decimated surface depends on this count
+int decimate_partitions(int fix_boundary) {
+	return fix_boundary ? 1 : vtkSMPTools::GetEstimatedNumberOfThreads();
+}
+
+// decimate a triangle mesh by target_reduction with the selected engine
+vtkSmartPointer<vtkPolyData> decimate_mesh(const struct args& cargs, vtkSmartPointer<vtkPolyData> mesh, float target_reduction, int fix_boundary, struct profile *prof) {
+	vtkIdType polys = mesh->GetNumberOfPolys();
+	profile_begin(prof, "decimate", mesh);
+	if (cargs.decimate_engine.compare("quadric") == 0 && mesh->GetNumberOfPoints() <= (vtkIdType)UINT32_MAX) {
+		int partitions = decimate_partitions(fix_boundary);
+		if (cargs.verbose)
+			cout << "Running quadric decimation with " << target_reduction << " target reduction over " << partitions << " partition(s)..." << endl;
+		mesh = quadric_decimate(mesh, target_reduction, fix_boundary, partitions, cargs.progress);
+	}
+	else {
+		if (cargs.verbose)
+			cout << "Running progressive decimation filter with " << target_reduction << " target reduction..." << endl;
+		vtkSmartPointer<vtkDecimatePro> dfilt = vtkSmartPointer<vtkDecimatePro>::New();
+		dfilt->SetInputData(mesh);
+		dfilt->SetTargetReduction(target_reduction);
+		dfilt->PreserveTopologyOn();
+		if (fix_boundary)
+			dfilt->BoundaryVertexDeletionOff();
+		mesh = run_filter(dfilt.GetPointer(), cargs.progress);
+	}
+	profile_end(prof, mesh);
+	if (cargs.verbose && polys > 0)
+		cout << "Achieved reduction of " << 1.0 - (double)mesh->GetNumberOfPolys() / polys << " (" << polys << " to " << mesh->GetNumberOfPolys() << " polygons)" << endl;
+	return mesh;
+}
+
+// [triangle -> [smooth]] ahead of any decimation
+vtkSmartPointer<vtkPolyData> smooth_mesh(const struct args& cargs, vtkSmartPointer<vtkPolyData> mesh, int fix_boundary, struct profile *prof) {
+	if (cargs.decimate || cargs.smooth || !cargs.lods.empty()) {
+	    // triangulate; isosurfaces from either engine are triangles already, so the copy is usually avoided
+		if (is_triangle_mesh(mesh)) {
+			if (cargs.verbose)
+				cout << "Skipping triangle filter (surface is all triangles)..." << endl;
+		}
+		else {
+			if (cargs.verbose)
+				cout << "Running triangle filter..." << endl;
+			profile_begin(prof, "triangle", mesh);
+			vtkSmartPointer<vtkTriangleFilter> tfilt = vtkSmartPointer<vtkTriangleFilter>::New();
+			tfilt->SetInputData(mesh);
+			mesh = run_filter(tfilt.GetPointer(), cargs.progress);
+			profile_end(prof, mesh);
+		}
 
 	    // smooth
-		if (cargs.smooth) {
+		if (cargs.smooth)
+			profile_begin(prof, "smooth", mesh);
+		// the parallel engine's adjacency holds 32-bit point ids
+		if (cargs.smooth && cargs.smooth_engine.compare("parallel") == 0 && mesh->GetNumberOfPoints() <= (vtkIdType)UINT32_MAX) {
+            if (cargs.verbose)
+                cout << "Running parallel smoothing with " << cargs.smooth_iter << " iterations on " << vtkSMPTools::GetEstimatedNumberOfThreads() << " thread(s)..." << endl;
+            mesh = laplacian_smooth(mesh, cargs.smooth_iter, !fix_boundary, cargs.progress);
+		}
+		else if (cargs.smooth) {
             if (cargs.verbose)
                 cout << "Running smoothing filter with " << cargs.smooth_iter << " iterations..." << endl;
-		    sfilt->SetInputConnection(tfilt->GetOutputPort());
+			vtkSmartPointer<vtkSmoothPolyDataFilter> sfilt = vtkSmartPointer<vtkSmoothPolyDataFilter>::New();
+		    sfilt->SetInputData(mesh);
 		    sfilt->SetNumberOfIterations(cargs.smooth_iter);
+		    if (fix_boundary)
+		        sfilt->BoundarySmoothingOff();
+		    mesh = run_filter(sfilt.GetPointer(), cargs.progress);
 		}
+		if (cargs.smooth)
+			profile_end(prof, mesh);
+	}
+	return mesh;
+}
 
-        // decimate
-        if (cargs.decimate) {
-            if (cargs.verbose)
-                cout << "Running progressive decimation filter with " << cargs.target_reduction << " target reduction..." << endl;
-            if (cargs.smooth)
-                dfilt->SetInputConnection(sfilt->GetOutputPort());
-            else
-                dfilt->SetInputConnection(tfilt->GetOutputPort());
-            dfilt->SetTargetReduction(cargs.target_reduction);
-            dfilt->PreserveTopologyOn();
-		}
+// [triangle -> [smooth] -> [decimate]] on an extracted surface; with fix_boundary the open edges
+// (e.g. where a brick was cut from the volume) are neither smoothed nor decimated so that
+// neighbouring pieces still meet exactly
+vtkSmartPointer<vtkPolyData> refine_mesh(const struct args& cargs, vtkSmartPointer<vtkPolyData> mesh, int fix_boundary, struct profile *prof) {
+	mesh = smooth_mesh(cargs, move(mesh), fix_boundary, prof);
+	// decimate (LODs are decimated later)
+	if (cargs.decimate)
+		mesh = decimate_mesh(cargs, move(mesh), cargs.target_reduction, fix_boundary, prof);
+	return mesh;
+}
+
+// triangles in vertex-cache order (optionally along a Morton curve first) and points in order of first use
+vtkSmartPointer<vtkPolyData> optimize_mesh(const struct args& cargs, vtkSmartPointer<vtkPolyData> mesh, struct profile *prof) {
+	if (cargs.optimize.compare("none") == 0)
+		return mesh;
+	if (!is_triangle_mesh(mesh)) {
+		if (cargs.verbose)
+			cout << "Skipping reordering (surface is not all triangles)..." << endl;
+		return mesh;
 	}
+	if (cargs.verbose)
+		cout << "Reordering triangles for a " << cargs.vertex_cache << "-entry vertex cache"
+			<< (cargs.optimize.compare("morton") == 0 ? " along a Morton curve" : "") << "..." << endl;
+	profile_begin(prof, "optimize", mesh);
+	mesh = reorder_mesh(mesh, cargs.vertex_cache, cargs.optimize.compare("morton") == 0);
+	profile_end(prof, mesh);
+	return mesh;
+}
 
-    // triangle strips
-    vtkSmartPointer<vtkStripper> strip = vtkSmartPointer<vtkStripper>::New();
-    if (cargs.verbose)
-        cout << "Generating triangle strips..." << endl;
-    if (cargs.decimate || cargs.smooth) {
-        if (cargs.decimate)
-            strip->SetInputConnection(dfilt->GetOutputPort());
-        else
-            strip->SetInputConnection(sfilt->GetOutputPort());
+// the mesh with smooth vertex normals as point data (a copy: the mesh itself may be decimated further)
+vtkSmartPointer<vtkPolyData> normal_mesh(const struct args& cargs, vtkSmartPointer<vtkPolyData> mesh, struct profile *prof) {
+	if (!cargs.normals)
+		return mesh;
+	if (cargs.verbose)
+		cout << "Computing " << (cargs.normals == 2 ? "oct-encoded " : "") << "vertex normals on " << vtkSMPTools::GetEstimatedNumberOfThreads() << " thread(s)..." << endl;
+	profile_begin(prof, "normals", mesh);
+	vtkSmartPointer<vtkFloatArray> normals = vertex_normals(mesh);
+	vtkSmartPointer<vtkPolyData> output = vtkSmartPointer<vtkPolyData>::New();
+	output->ShallowCopy(mesh);
+	if (cargs.normals == 2)
+		output->GetPointData()->AddArray(oct_encode(normals));
+	else
+		output->GetPointData()->SetNormals(normals);
+	profile_end(prof, output);
+	return output;
+}
+
+// triangle strips
+vtkSmartPointer<vtkPolyData> strip_mesh(const struct args& cargs, vtkSmartPointer<vtkPolyData> mesh, struct profile *prof) {
+    // binary STL holds separate triangles only so strips would just be undone by the writer
+    if (cargs.out_format.compare("stl") == 0 && !cargs.ascii)
+        return mesh;
+    // GLB holds indexed triangles only, likewise, and so do the buffers of the library
+    if (cargs.out_format.compare("glb") == 0 || cargs.meshes != NULL)
+        return mesh;
+    // vtkStripper would emit the triangles of a reordered mesh in an order of its own
+    if (cargs.optimize.compare("none") != 0) {
+        if (cargs.verbose)
+            cout << "Skipping triangle strips (triangles are in vertex-cache order)..." << endl;
+        return mesh;
     }
-    else {
-        strip->SetInputConnection(cfilt->GetOutputPort());
+    // strips have no cell data of their own, so e.g. the label of each triangle would be lost
+    if (mesh->GetCellData()->GetNumberOfArrays() > 0) {
+        if (cargs.verbose)
+            cout << "Skipping triangle strips (triangles carry cell data)..." << endl;
+        return mesh;
     }
+    if (cargs.verbose)
+        cout << "Generating triangle strips..." << endl;
+    profile_begin(prof, "strip", mesh);
+    vtkSmartPointer<vtkStripper> strip = vtkSmartPointer<vtkStripper>::New();
+    strip->SetInputData(mesh);
     strip->SetMaximumLength(1000);
+    mesh = run_filter(strip.GetPointer(), cargs.progress);
+    profile_end(prof, mesh);
+    return mesh;
+}
+
+
+// contour, triangulate, smooth and decimate every level of job j brick by brick; bricks are
+// processed concurrently and share their boundary voxels so that their seams can be merged
+vector<vtkSmartPointer<vtkPolyData> > brick_levels(const struct args& cargs, const struct job& j, struct profile *prof) {
+	struct volume vol;
+	vtkSmartPointer<vtkImageData> image;
+	if (cargs.mmap) {
+		if (cargs.verbose)
+			cout << "Memory-mapping MRC/MAP file..." << j.map_fn << endl;
+		if (volume_map(vol, j.map_fn) != 0)
+			throw runtime_error("unable to map " + j.map_fn);
+	}
+	else {
+		image = read_map(cargs, j.map_fn, prof);
+		if (volume_wrap(vol, image) != 0)
+			throw runtime_error("unsupported voxels in " + j.map_fn);
+	}
+
+	// brick extents along each axis; the last voxel of one brick is the first of the next
+	int roi[6];
+	roi_extent(cargs, vol, j.clevels, roi);
+	vector<int> starts[3];
+	for (int a = 0; a < 3; a++)
+		for (int s = roi[2 * a]; s < roi[2 * a + 1] || s == roi[2 * a]; s += cargs.brick)
+			starts[a].push_back(s);
+	vector<vector<int> > bricks;
+	for (size_t k = 0; k < starts[2].size(); k++)
+		for (size_t jj = 0; jj < starts[1].size(); jj++)
+			for (size_t i = 0; i < starts[0].size(); i++) {
+				int origin[3] = {starts[0][i], starts[1][jj], starts[2][k]};
+				vector<int> extent(6);
+				for (int a = 0; a < 3; a++) {
+					extent[2 * a] = origin[a];
+					extent[2 * a + 1] = min(origin[a] + cargs.brick, roi[2 * a + 1]);
+				}
+				bricks.push_back(extent);
+			}
+	// bricks that no level crosses have no surface
+	if (cargs.skip_empty) {
+		struct volume_ranges ranges;
+		profile_begin(prof, "minmax", NULL);
+		volume_ranges_build(vol, roi, cargs.skip_empty, ranges);
+		profile_end(prof, NULL);
+		size_t total = bricks.size();
+		vector<vector<int> > crossed;
+		// filtered voxels take their values from within the halo around them
+		int halo = prefilter_halo(cargs.prefilter, cargs.sigma);
+		for (size_t b = 0; b < bricks.size(); b++) {
+			int grown[6];
+			grow_extent(&bricks[b][0], halo, roi, grown);
+			if (volume_ranges_straddle(ranges, grown, j.clevels))
+				crossed.push_back(bricks[b]);
+		}
+		bricks.swap(crossed);
+		if (cargs.verbose)
+			cout << "Skipping " << total - bricks.size() << " of " << total << " brick(s) that no level crosses..." << endl;
+	}
+	if (cargs.verbose)
+		cout << "Processing " << bricks.size() << " brick(s) of " << cargs.brick << "^3 voxels on " << vtkSMPTools::GetEstimatedNumberOfThreads() << " thread(s)..." << endl;
+
+	// bricks run concurrently so their stages stay quiet and are timed together
+	if (prof != NULL)
+		prof->has_level = 0;
+	profile_begin(prof, "bricks", image);
+	struct args bargs = cargs;
+	bargs.verbose = 0;
+	// as for the runs of contour_active()
+	struct progress quiet;
+	quiet.parent = cargs.progress;
+	bargs.progress = &quiet;
+	atomic<size_t> done(0);
+	size_t nbricks = bricks.size(), nlevels = cargs.single ? 1 : j.clevels.size();
+	vector<vtkSmartPointer<vtkPolyData> > pieces(nbricks * nlevels);
+	auto work = [&](vtkIdType first, vtkIdType last) {
+		for (vtkIdType b = first; b < last; b++) {
+			if (progress_cancelled(&quiet) != NULL)
+				return;
+			vtkSmartPointer<vtkImageData> block = read_block(bargs, vol, &bricks[b][0], roi);
+			vector<vtkSmartPointer<vtkPolyData> > levels = contour(bargs, block, j.clevels, NULL);
+			for (size_t l = 0; l < nlevels; l++)
+				pieces[l * nbricks + b] = refine_mesh(bargs, levels[l], 1, NULL);
+			progress_update(cargs.progress, (double)++done / nbricks);
+		}
+	};
+	vtkSMPTools::For(0, (vtkIdType)nbricks, 1, work);
+	volume_unmap(vol);
+	image = NULL;
+	profile_end(prof, NULL);
+	progress_check(cargs.progress);
+
+	double tolerance = 1e-4 * min(vol.spacing[0], min(vol.spacing[1], vol.spacing[2]));
+	vector<vtkSmartPointer<vtkPolyData> > meshes;
+	for (size_t l = 0; l < nlevels; l++) {
+		if (cargs.verbose && cargs.single)
+			cout << "Merging brick seams of all levels..." << endl;
+		else if (cargs.verbose)
+			cout << "Merging brick seams at level " << j.clevels[l] << "..." << endl;
+		if (prof != NULL) {
+			prof->has_level = !cargs.single;
+			prof->clevel = j.clevels[l];
+		}
+		vector<vtkSmartPointer<vtkPolyData> > level_pieces(pieces.begin() + l * nbricks, pieces.begin() + (l + 1) * nbricks);
+		meshes.push_back(merge_pieces(level_pieces, tolerance, prof));
+		for (size_t b = 0; b < nbricks; b++)
+			pieces[l * nbricks + b] = NULL;
+	}
+	return meshes;
+}
 
+// the isosurfaces of job j with each MPI rank streaming its own slab of the map (as for -M) and refining
+// its pieces with their seams fixed (as for -B); with 'merge' they are gathered and merged on rank 0 and
+// the other ranks are left with empty surfaces, with 'pvtp' each rank keeps its own
+vector<vtkSmartPointer<vtkPolyData> > distributed_levels(const struct args& cargs, const struct job& j, struct profile *prof) {
+	int rank = distributed_rank(), nranks = distributed_size();
 	if (cargs.verbose)
-		cout << "Writing output to '" << cargs.out_fn_full.c_str() << "'..." << endl;
+		cout << "Meshing " << j.map_fn << " in " << nranks << " slab(s), one per rank..." << endl;
+	vector<vtkSmartPointer<vtkPolyData> > meshes = stream_levels(cargs, j, rank, nranks, prof);
+	for (size_t l = 0; l < meshes.size(); l++) {
+		if (prof != NULL) {
+			prof->has_level = !cargs.single;
+			prof->clevel = j.clevels[l];
+		}
+		meshes[l] = refine_mesh(cargs, move(meshes[l]), 1, prof);
+	}
+	if (cargs.distributed.compare("pvtp") == 0)
+		return meshes;
+
+	// every level is sent before rank 0 merges any (a rank that fails ends the run rather than leaving
+	// the others waiting, see main)
+	if (prof != NULL)
+		prof->has_level = 0;
+	profile_begin(prof, "gather", NULL);
+	vector<vector<vtkSmartPointer<vtkPolyData> > > pieces(meshes.size());
+	for (size_t l = 0; l < meshes.size(); l++) {
+		pieces[l] = distributed_gather_meshes(meshes[l]);
+		meshes[l] = vtkSmartPointer<vtkPolyData>::New();
+	}
+	profile_end(prof, NULL);
+	if (rank != 0)
+		return meshes;
+
+	struct volume vol;
+	if (volume_map(vol, j.map_fn) != 0)
+		throw runtime_error("unable to map " + j.map_fn);
+	double tolerance = 1e-4 * min(vol.spacing[0], min(vol.spacing[1], vol.spacing[2]));
+	volume_unmap(vol);
+	for (size_t l = 0; l < meshes.size(); l++) {
+		if (cargs.verbose && cargs.single)
+			cout << "Merging the pieces of " << nranks << " rank(s) of all levels..." << endl;
+		else if (cargs.verbose)
+			cout << "Merging the pieces of " << nranks << " rank(s) at level " << j.clevels[l] << "..." << endl;
+		if (prof != NULL) {
+			prof->has_level = !cargs.single;
+			prof->clevel = j.clevels[l];
+		}
+		meshes[l] = merge_pieces(pieces[l], tolerance, prof);
+		pieces[l].clear();
+	}
+	return meshes;
+}
+
+// the stages whose surfaces are cached, in pipeline order
+enum { STAGE_NONE, STAGE_CONTOUR, STAGE_SMOOTH, STAGE_DECIMATE, NSTAGES };
+static const char *stage_names[NSTAGES] = {"", "contour", "smooth", "decimate"};
 
-	if (cargs.out_format.compare("stl") == 0){
+// the cache keys of the surface at level l of job j after each stage (by stage index); each key covers
+// every option that leads up to its stage, so changing e.g. only the target reduction or the output
+// format still finds the smoothed surface; how the map is read (-M/-z) and which blocks of it are
+// contoured (-E) do not change the surface
+vector<string> stage_keys(const struct args& cargs, const struct job& j, size_t l, uint64_t map_hash) {
+	vector<string> keys(NSTAGES);
+	ostringstream d;
+	d << setprecision(9) << "meshmaker cache 1\nmap " << hex << map_hash << dec << "\nlevels";
+	if (cargs.single)
+		for (size_t c = 0; c < j.clevels.size(); c++)
+			d << " " << j.clevels[c];
+	else
+		d << " " << j.clevels[l];
+	d << "\nengine " << (cargs.labels ? "labels" : cargs.engine) << "\ncrop";
+	for (size_t c = 0; c < cargs.crop.size(); c++)
+		d << " " << cargs.crop[c];
+	d << "\ncrop-physical";
+	for (size_t c = 0; c < cargs.crop_physical.size(); c++)
+		d << " " << cargs.crop_physical[c];
+	d << "\nautocrop " << cargs.autocrop << "\nstride " << cargs.stride << "\nbin " << cargs.bin
+		<< "\nbrick " << cargs.brick << "\nprefilter " << cargs.prefilter << " " << (cargs.prefilter.compare("gaussian") == 0 ? cargs.sigma : 0)
+		<< "\ncomponents " << cargs.components.largest << " " << cargs.components.min_polys
+		<< " " << cargs.components.min_volume;
+	keys[STAGE_CONTOUR] = cache_key(d.str());
+	d << "\nsmooth " << cargs.smooth;
+	if (cargs.smooth)
+		d << " " << cargs.smooth_iter << " " << cargs.smooth_engine;
+	keys[STAGE_SMOOTH] = cache_key(d.str());
+	d << "\ndecimate " << cargs.decimate;
+	if (cargs.decimate)
+		d << " " << cargs.target_reduction << " " << cargs.decimate_engine;
+	if (cargs.decimate && cargs.decimate_engine.compare("quadric") == 0)
+		d << " " << decimate_partitions(cargs.brick != 0);
+	keys[STAGE_DECIMATE] = cache_key(d.str());
+	return keys;
+}
+
+// the surface of the deepest of stages first to last (by index) that is in the cache, and that stage
+// (STAGE_NONE if none is)
+vtkSmartPointer<vtkPolyData> cache_resume(const struct args& cargs, const vector<string>& keys, int first, int last, int& stage, struct profile *prof) {
+	for (stage = last; stage >= first; stage--) {
+		profile_begin(prof, "cache_read", NULL);
+		vtkSmartPointer<vtkPolyData> mesh = cache_load(cargs.cache_dir, keys[stage]);
+		profile_end(prof, mesh);
+		if (mesh != NULL) {
+			if (cargs.verbose)
+				cout << "Resuming from the cached " << stage_names[stage] << " surface " << keys[stage] << "..." << endl;
+			return mesh;
+		}
+	}
+	stage = STAGE_NONE;
+	return NULL;
+}
+
+// keep the surface after stage; a cache that cannot be written only costs the next run time
+void cache_keep(const struct args& cargs, const vector<string>& keys, int stage, vtkPolyData *mesh, struct profile *prof) {
+	if (cargs.verbose)
+		cout << "Caching the " << stage_names[stage] << " surface as " << keys[stage] << "..." << endl;
+	profile_begin(prof, "cache_write", mesh);
+	if (cache_store(cargs.cache_dir, keys[stage], mesh) != 0)
+		cerr << "Warning: unable to cache the " << stage_names[stage] << " surface" << endl;
+	profile_end(prof, mesh);
+}
+
+// the mesh to write with its points as Float32 or quantized to UInt16 and, with -I, its cell arrays in
+// 32-bit storage
+vtkSmartPointer<vtkPolyData> pack_mesh(const struct args& cargs, vtkSmartPointer<vtkPolyData> mesh, struct profile *prof) {
+	// the ids are the same in half the memory, so the cell arrays are converted in place
+	if (cargs.int32) {
+		vtkCellArray *cells[4] = {mesh->GetVerts(), mesh->GetLines(), mesh->GetStrips(), mesh->GetPolys()};
+		for (int t = 0; t < 4; t++)
+			if (cells[t] != NULL && cells[t]->IsStorage64Bit() && cells[t]->CanConvertTo32BitStorage())
+				cells[t]->ConvertTo32BitStorage();
+	}
+	vtkPoints *points = mesh->GetPoints();
+	if (points == NULL || (!cargs.quantize && !(cargs.float32 && points->GetDataType() != VTK_FLOAT)))
+		return mesh;
+
+	profile_begin(prof, "pack", mesh);
+	vtkSmartPointer<vtkPolyData> packed = vtkSmartPointer<vtkPolyData>::New();
+	packed->ShallowCopy(mesh);
+	vtkSmartPointer<vtkPoints> out_points = vtkSmartPointer<vtkPoints>::New();
+	if (cargs.quantize) {
+		// x = offset + q * scale along each axis, with q in 0..65535 over the bounding box
+		double bounds[6], offset[3], scale[3];
+		points->GetBounds(bounds);
+		for (int a = 0; a < 3; a++) {
+			offset[a] = bounds[2 * a];
+			scale[a] = bounds[2 * a + 1] > bounds[2 * a] ? (bounds[2 * a + 1] - bounds[2 * a]) / 65535.0 : 1.0;
+		}
+		if (cargs.verbose)
+			cout << "Quantizing " << points->GetNumberOfPoints() << " point(s) to 16 bits (steps of " << scale[0] << ", " << scale[1] << ", " << scale[2] << ")..." << endl;
+		vtkSmartPointer<vtkUnsignedShortArray> q = vtkSmartPointer<vtkUnsignedShortArray>::New();
+		pool_values(q.GetPointer(), 3, points->GetNumberOfPoints());
+		unsigned short *out = q->GetPointer(0);
+		auto quantize = [&](vtkIdType first, vtkIdType last) {
+			double x[3];
+			for (vtkIdType p = first; p < last; p++) {
+				points->GetPoint(p, x);
+				for (int a = 0; a < 3; a++)
+					out[3 * p + a] = (unsigned short)min(65535.0, max(0.0, floor((x[a] - offset[a]) / scale[a] + 0.5)));
+			}
+		};
+		vtkSMPTools::For(0, points->GetNumberOfPoints(), quantize);
+		out_points->SetData(q);
+
+		vtkSmartPointer<vtkFieldData> field = vtkSmartPointer<vtkFieldData>::New();
+		field->PassData(mesh->GetFieldData());
+		const char *names[2] = {"quantization_offset", "quantization_scale"};
+		double *values[2] = {offset, scale};
+		for (int t = 0; t < 2; t++) {
+			vtkSmartPointer<vtkDoubleArray> transform = vtkSmartPointer<vtkDoubleArray>::New();
+			transform->SetName(names[t]);
+			transform->SetNumberOfComponents(3);
+			transform->SetNumberOfTuples(1);
+			for (int a = 0; a < 3; a++)
+				transform->SetValue(a, values[t][a]);
+			field->AddArray(transform);
+		}
+		packed->SetFieldData(field);
+	}
+	else {
+		if (cargs.verbose)
+			cout << "Converting " << points->GetNumberOfPoints() << " point(s) to Float32..." << endl;
+		out_points = pool_points(VTK_FLOAT, points->GetNumberOfPoints());
+		float *out = vtkFloatArray::SafeDownCast(out_points->GetData())->GetPointer(0);
+		auto narrow = [&](vtkIdType first, vtkIdType last) {
+			double x[3];
+			for (vtkIdType p = first; p < last; p++) {
+				points->GetPoint(p, x);
+				for (int a = 0; a < 3; a++)
+					out[3 * p + a] = (float)x[a];
+			}
+		};
+		vtkSMPTools::For(0, points->GetNumberOfPoints(), narrow);
+	}
+	packed->SetPoints(out_points);
+	profile_end(prof, packed);
+	return packed;
+}
+
+// write all of n bytes of data to fd
+int write_fd(int fd, const char *data, size_t n) {
+	while (n > 0) {
+		ssize_t written = write(fd, data, n);
+		if (written < 0 && errno == EINTR)
+			continue;
+		if (written <= 0)
+			return -1;
+		data += written;
+		n -= written;
+	}
+	return 0;
+}
+
+// the name of the output of cargs for messages
+string stream_name(const struct args& cargs) {
+	if (cargs.out_fd == STDOUT_FILENO)
+		return "stdout";
+	ostringstream name;
+	name << "file descriptor " << cargs.out_fd;
+	return name.str();
+}
+
+// write the mesh in the requested output format, to out_fn_full or to the output stream; our own
+// writers stream straight to it while VTK's build the file in memory first as they seek
+void write_mesh(const struct args& cargs, vtkPolyData *mesh, const string& out_fn_full, struct profile *prof) {
+	int streamed = cargs.out_fd >= 0;
+	string target = streamed ? stream_name(cargs) : out_fn_full;
+	if (cargs.verbose)
+		cout << "Writing output to '" << target << "'..." << endl;
+	profile_begin(prof, "write", mesh);
+
+	// a duplicate so that closing the stdio stream leaves the descriptor open
+	FILE *stream = NULL;
+	if (streamed && !cargs.ascii && (cargs.out_format.compare("stl") == 0 || cargs.out_format.compare("glb") == 0 || (cargs.out_format.compare("vtp") == 0 && cargs.appended))) {
+		int fd = dup(cargs.out_fd);
+		stream = fd >= 0 ? fdopen(fd, "wb") : NULL;
+		if (stream == NULL) {
+			cerr << "Unable to write to " << target << ": " << strerror(errno) << endl;
+			throw runtime_error("unable to write to " + target);
+		}
+	}
+	string buffered; // the output of a VTK writer to a stream
+	int failed = 0;
+
+	if (cargs.out_format.compare("stl") == 0 && !cargs.ascii) {
+		failed = stream != NULL ? stl_write(mesh, stream, target) : stl_write(mesh, out_fn_full);
+	}
+	else if (cargs.out_format.compare("glb") == 0) {
+		failed = stream != NULL ? glb_write(mesh, stream, target) : glb_write(mesh, out_fn_full);
+	}
+	else if (cargs.out_format.compare("stl") == 0){
 		vtkSmartPointer<vtkSTLWriter> writer = vtkSmartPointer<vtkSTLWriter>::New();
-//		if (cargs.decimate)
-//			writer->SetInputConnection(dfilt->GetOutputPort());
-//		else
-//			writer->SetInputConnection(cfilt->GetOutputPort());
-        writer->SetInputConnection(strip->GetOutputPort());
-		writer->SetFileName(cargs.out_fn_full.c_str());
-		if (cargs.ascii)
-			writer->SetFileTypeToASCII();
-		else
-			writer->SetFileTypeToBinary();
+        writer->SetInputData(mesh);
+		// ASCII STL is written in order, so the descriptor can be opened by name
+		ostringstream fd_fn;
+		fd_fn << "/dev/fd/" << cargs.out_fd;
+		writer->SetFileName(streamed ? fd_fn.str().c_str() : out_fn_full.c_str());
+		writer->SetFileTypeToASCII();
 		writer->Write();
 	}
 	else if (cargs.out_format.compare("vtk") == 0){
 		vtkSmartPointer<vtkPolyDataWriter> writer = vtkSmartPointer<vtkPolyDataWriter>::New();
-		writer->SetFileName(cargs.out_fn_full.c_str());
-//		if (cargs.decimate)
-//			writer->SetInputConnection(dfilt->GetOutputPort());
-//		else
-//			writer->SetInputConnection(cfilt->GetOutputPort());
-        writer->SetInputConnection(strip->GetOutputPort());
+		if (streamed)
+			writer->WriteToOutputStringOn();
+		else
+			writer->SetFileName(out_fn_full.c_str());
+        writer->SetInputData(mesh);
 		if (cargs.ascii)
 			writer->SetFileTypeToASCII();
 		else
 			writer->SetFileTypeToBinary();
 		writer->Write();
-	} else if (cargs.out_format.compare("vtp") == 0){
+		if (streamed)
+			buffered.assign(writer->GetOutputString(), writer->GetOutputStringLength());
+	}
+	else if (cargs.out_format.compare("vtp") == 0 && !cargs.ascii && cargs.appended) {
+		if (cargs.verbose && cargs.compressor.compare("none") != 0)
+			cout << "Compressing with " << cargs.compressor << " (level " << cargs.compression_level << ", "
+				<< cargs.block_size << "-byte blocks)..." << endl;
+		else if (cargs.verbose)
+			cout << "Writing raw appended data..." << endl;
+		struct vtp_options opts;
+		opts.compressor = cargs.compressor;
+		opts.level = cargs.compression_level;
+		opts.block_size = cargs.block_size;
+		opts.uint64 = cargs.uint64;
+		opts.int32 = cargs.int32;
+		opts.align = cargs.align;
+		failed = stream != NULL ? vtp_write(mesh, stream, target, opts) : vtp_write(mesh, out_fn_full, opts);
+	}
+	else if (cargs.out_format.compare("vtp") == 0){
 		vtkSmartPointer<vtkXMLPolyDataWriter> writer = vtkSmartPointer<vtkXMLPolyDataWriter>::New();
-		writer->SetFileName(cargs.out_fn_full.c_str());
-		// decimate
-//		if (cargs.decimate)
-//			writer->SetInputConnection(dfilt->GetOutputPort());
-//		else
-//			writer->SetInputConnection(cfilt->GetOutputPort());
-        writer->SetInputConnection(strip->GetOutputPort());
+		if (streamed)
+			writer->WriteToOutputStringOn();
+		else
+			writer->SetFileName(out_fn_full.c_str());
+        writer->SetInputData(mesh);
 		// vtkIdType
 		if (cargs.int32)
 			writer->SetIdTypeToInt32();
@@ -320,12 +2095,359 @@ int main(int argc, char **argv)
 				cout << "Using UInt64 headers..." << endl;			
 			writer->SetHeaderTypeToUInt64();
 		}
-		else
+		else {
 			if (cargs.verbose)
 				cout << "Using UInt32 headers..." << endl;
 			writer->SetHeaderTypeToUInt32();
+		}
 		writer->Write();
+		if (streamed)
+			buffered = writer->GetOutputString();
 	}
 
-	return EXIT_SUCCESS;
+	if (stream != NULL)
+		fclose(stream);
+	if (!failed && !buffered.empty() && write_fd(cargs.out_fd, buffered.data(), buffered.size()) != 0) {
+		cerr << "Unable to write to " << target << ": " << strerror(errno) << endl;
+		failed = -1;
+	}
+	if (failed)
+		throw runtime_error("unable to write " + target);
+	profile_end(prof, mesh);
+	progress_written(cargs.progress, target);
+}
+
+// the last stages before a mesh (or LOD) is written: normals, reordering, strips and packing
+// one after the other, so that each intermediate surface is released as soon as the next is made
+vtkSmartPointer<vtkPolyData> finish_mesh(const struct args& cargs, vtkSmartPointer<vtkPolyData> mesh, struct profile *prof) {
+	mesh = normal_mesh(cargs, move(mesh), prof);
+	mesh = optimize_mesh(cargs, move(mesh), prof);
+	mesh = strip_mesh(cargs, move(mesh), prof);
+	return pack_mesh(cargs, move(mesh), prof);
+}
+
+// write the finished mesh at level l of job j (LOD lod, or -1) to fn, or hand it back to the library's caller
+void deliver_mesh(const struct args& cargs, const struct job& j, size_t l, int lod, vtkSmartPointer<vtkPolyData> mesh, const string& fn, struct profile *prof) {
+	if (cargs.meshes == NULL) {
+		write_mesh(cargs, mesh, fn, prof);
+		return;
+	}
+	struct mesh_output out;
+	out.fn = fn;
+	out.has_level = !cargs.single;
+	out.clevel = cargs.single ? 0.0 : j.clevels[l];
+	out.lod = lod;
+	out.mesh = mesh;
+	cargs.meshes->push_back(out);
+}
+
+// write this rank's piece of the refined surface at level l of job j as <prefix>_<rank>.vtp, and on
+// rank 0 the .pvtp of all pieces, declaring the arrays of the first piece that has any points
+void output_piece(const struct args& cargs, const struct job& j, size_t l, vtkSmartPointer<vtkPolyData> mesh, struct profile *prof) {
+	string stem = output_stem(cargs, j, l);
+	int nranks = distributed_size();
+	vector<string> pieces;
+	for (int r = 0; r < nranks; r++) {
+		ostringstream fn;
+		fn << stem << "_" << r << ".vtp";
+		pieces.push_back(fn.str());
+	}
+	mesh = finish_mesh(cargs, move(mesh), prof);
+	write_mesh(cargs, mesh, pieces[distributed_rank()], prof);
+	string index_fn = stem + ".pvtp";
+	if (cargs.verbose && distributed_rank() == 0)
+		cout << "Writing the index of " << nranks << " piece(s) to '" << index_fn << "'..." << endl;
+	if (distributed_write_index(index_fn, pieces, mesh) != 0)
+		throw runtime_error("unable to write " + index_fn);
+	if (distributed_rank() == 0)
+		progress_written(cargs.progress, index_fn);
+}
+
+// strip and write the refined surface at level l of job j, or each level of detail of it together with an index
+void output_mesh(const struct args& cargs, const struct job& j, size_t l, vtkSmartPointer<vtkPolyData> mesh, struct profile *prof) {
+	if (cargs.distributed.compare("pvtp") == 0) {
+		output_piece(cargs, j, l, move(mesh), prof);
+		return;
+	}
+	if (cargs.lods.empty()) {
+		mesh = finish_mesh(cargs, move(mesh), prof);
+		deliver_mesh(cargs, j, l, -1, mesh, output_name(cargs, j, l), prof);
+		return;
+	}
+
+	// each level is decimated from the previous one by what is left of its target
+	string stem = output_stem(cargs, j, l);
+	vtkIdType full = mesh->GetNumberOfPolys();
+	ostringstream index;
+	index << setprecision(9) << "{\n  \"map\": " << json_string(j.map_fn) << ",\n  ";
+	if (cargs.single) {
+		index << "\"clevels\": [";
+		for (size_t c = 0; c < j.clevels.size(); c++)
+			index << (c ? ", " : "") << j.clevels[c];
+		index << "]";
+	}
+	else
+		index << "\"clevel\": " << j.clevels[l];
+	index << ",\n  \"lods\": [";
+	for (size_t k = 0; k < cargs.lods.size(); k++) {
+		double target = (1.0 - cargs.lods[k]) * full;
+		vtkIdType polys = mesh->GetNumberOfPolys();
+		if (polys > 0 && target < polys) {
+			if (cargs.verbose)
+				cout << "Decimating LOD " << k << " (target reduction " << cargs.lods[k] << ")..." << endl;
+			// bricks have been merged so the whole surface is decimated at once
+			mesh = decimate_mesh(cargs, mesh, 1.0 - target / polys, 0, prof);
+		}
+		ostringstream fn;
+		fn << stem << "_lod" << k << "." << cargs.out_format;
+		string lod_fn = fn.str();
+		deliver_mesh(cargs, j, l, k, finish_mesh(cargs, mesh, prof), lod_fn, prof);
+
+		size_t slash = lod_fn.find_last_of("/\\");
+		index << (k ? "," : "") << "\n    {\"file\": " << json_string(slash == string::npos ? lod_fn : lod_fn.substr(slash + 1))
+			<< ", \"target_reduction\": " << cargs.lods[k]
+			<< ", \"reduction\": " << (full > 0 ? 1.0 - (double)mesh->GetNumberOfPolys() / full : 0.0)
+			<< ", \"points\": " << mesh->GetNumberOfPoints()
+			<< ", \"triangles\": " << mesh->GetNumberOfPolys() << "}";
+	}
+	index << "\n  ]\n}\n";
+	// the caller has the levels themselves
+	if (cargs.meshes != NULL)
+		return;
+
+	string index_fn = stem + "_lod.json";
+	if (cargs.verbose)
+		cout << "Writing LOD index to '" << index_fn << "'..." << endl;
+	ofstream out(index_fn.c_str());
+	out << index.str();
+	if (!out.good()) {
+		cerr << "Unable to write '" << index_fn << "'" << endl;
+		throw runtime_error("unable to write " + index_fn);
+	}
+	progress_written(cargs.progress, index_fn);
+}
+
+// mesh without the connected components that the filter drops, if any is set; with -1 the largest
+// components are those of each of clevels
+vtkSmartPointer<vtkPolyData> filter_mesh(const struct args& cargs, vtkSmartPointer<vtkPolyData> mesh, const vector<float>& clevels, struct profile *prof) {
+	const struct component_filter& filter = cargs.components;
+	if (filter.largest == 0 && filter.min_polys == 0 && filter.min_volume == 0)
+		return mesh;
+	profile_begin(prof, "components", mesh);
+	vtkIdType ncomponents, nkept;
+	if (cargs.single && clevels.size() > 1) {
+		vector<unsigned short> levels = point_levels(mesh, clevels);
+		mesh = filter_components(mesh, filter, ncomponents, nkept, &levels);
+	}
+	else
+		mesh = filter_components(mesh, filter, ncomponents, nkept);
+	profile_end(prof, mesh);
+	if (cargs.verbose)
+		cout << "Kept " << nkept << " of " << ncomponents << " connected component(s) (" << mesh->GetNumberOfPolys() << " polygons)..." << endl;
+	return mesh;
+}
+
+// the isosurfaces of job j, either streamed from a memory-mapped map or from the (part of the) map read into memory
+vector<vtkSmartPointer<vtkPolyData> > extract_levels(const struct args& cargs, const struct job& j, struct profile *prof) {
+	if (cargs.mmap)
+		return stream_levels(cargs, j, 0, 1, prof);
+	vtkSmartPointer<vtkImageData> image = has_roi(cargs) ? read_roi(cargs, j, prof) : read_map(cargs, j.map_fn, prof);
+	image = subsample(cargs, filter_image(cargs, image, prof), prof);
+	if (cargs.skip_empty)
+		return contour_blocks(cargs, image, j.clevels, prof);
+	return contour(cargs, image, j.clevels, prof);
+}
+
+// the surfaces of a label map joined into one mesh, told apart by a 'label' cell array (their
+// boundaries are not merged: each keeps its own points)
+vtkSmartPointer<vtkPolyData> join_labels(const vector<vtkSmartPointer<vtkPolyData> >& meshes, const vector<float>& labels, struct profile *prof) {
+	vtkSmartPointer<vtkAppendPolyData> append = vtkSmartPointer<vtkAppendPolyData>::New();
+	int inputs = 0;
+	for (size_t l = 0; l < meshes.size(); l++) {
+		if (meshes[l]->GetNumberOfPolys() == 0)
+			continue;
+		vtkSmartPointer<vtkPolyData> labelled = vtkSmartPointer<vtkPolyData>::New();
+		labelled->ShallowCopy(meshes[l]);
+		vtkSmartPointer<vtkIntArray> label = vtkSmartPointer<vtkIntArray>::New();
+		label->SetName("label");
+		label->SetNumberOfValues(labelled->GetNumberOfCells());
+		label->FillValue((int)labels[l]);
+		labelled->GetCellData()->AddArray(label);
+		append->AddInputData(labelled);
+		inputs++;
+	}
+	if (inputs == 0)
+		return vtkSmartPointer<vtkPolyData>::New();
+	profile_begin(prof, "join", NULL);
+	vtkSmartPointer<vtkPolyData> mesh = run_filter(append.GetPointer());
+	profile_end(prof, mesh);
+	return mesh;
+}
+
+// mesh every job; returns 0, or -1 if the profile cannot be written (other errors throw)
+int run_jobs(const struct args& cargs, const vector<struct job>& jobs) {
+	// a stream holds a single file (the labels of a map are only known once it is read)
+	if (cargs.out_fd >= 0) {
+		size_t outputs = 0;
+		int unknown = 0;
+		for (size_t j = 0; j < jobs.size(); j++) {
+			outputs += cargs.single ? 1 : jobs[j].clevels.size();
+			unknown = unknown || (!cargs.single && jobs[j].clevels.empty());
+		}
+		if (outputs != 1 || unknown || !cargs.lods.empty()) {
+			cerr << "Only one mesh can be written to " << stream_name(cargs) << " (use -1/--one-file for several levels or labels). Aborting..." << endl;
+			throw invalid_argument("several meshes for one stream");
+		}
+	}
+	// stages are also where progress is reported and cancellation noticed
+	struct profile profile;
+	profile.progress = cargs.progress;
+	struct profile *prof = cargs.profile_fn.compare("") != 0 || cargs.progress != NULL ? &profile : NULL;
+
+	// a cancelled job still leaves the profile of the stages that did run
+	try {
+		// each map is read once and meshed at every requested level
+		for (size_t j = 0; j < jobs.size(); j++) {
+			if (prof != NULL) {
+				prof->map_fn = jobs[j].map_fn;
+				prof->has_level = 0;
+			}
+			struct job job = jobs[j];
+			if (cargs.labels && job.clevels.empty()) {
+				job.clevels = map_labels(cargs, job, prof);
+				if (job.clevels.empty()) {
+					cerr << "Warning: no labels in " << job.map_fn << ", nothing to mesh" << endl;
+					continue;
+				}
+			}
+			// the labels that go to one file are still meshed (and cached) apart, then joined unmerged
+			struct args largs = cargs;
+			int join = cargs.labels && cargs.single;
+			if (join)
+				largs.single = 0;
+			vector<vtkSmartPointer<vtkPolyData> > joined;
+			// the deepest cached stage of each output; bricks are refined as they go so only their final
+			// surfaces are cached
+			size_t nout = largs.single ? 1 : job.clevels.size();
+			vector<vector<string> > keys(nout);
+			vector<vtkSmartPointer<vtkPolyData> > meshes(nout);
+			vector<int> stages(nout, STAGE_NONE);
+			int extract = 1;
+			if (largs.cache_dir.compare("") != 0) {
+				uint64_t map_hash;
+				profile_begin(prof, "cache_hash", NULL);
+				if (cache_hash_file(job.map_fn, map_hash) != 0)
+					throw runtime_error("unable to read " + job.map_fn);
+				profile_end(prof, NULL);
+				extract = 0;
+				for (size_t l = 0; l < nout; l++) {
+					keys[l] = stage_keys(largs, job, l, map_hash);
+					meshes[l] = cache_resume(largs, keys[l], largs.brick ? STAGE_DECIMATE : STAGE_CONTOUR, STAGE_DECIMATE, stages[l], prof);
+					extract = extract || stages[l] == STAGE_NONE;
+				}
+			}
+
+			// all levels come from the same extraction even if only some of them are missing
+			if (extract) {
+				vector<vtkSmartPointer<vtkPolyData> > extracted;
+				if (largs.distributed.compare("") != 0)
+					extracted = distributed_levels(largs, job, prof);
+				else
+					extracted = largs.brick ? brick_levels(largs, job, prof) : extract_levels(largs, job, prof);
+				// the merged surfaces are rank 0's to finish
+				if (largs.distributed.compare("merge") == 0 && distributed_rank() != 0)
+					continue;
+				for (size_t l = 0; l < nout; l++) {
+					if (stages[l] != STAGE_NONE)
+						continue;
+					meshes[l] = filter_mesh(largs, extracted[l], job.clevels, prof);
+					extracted[l] = NULL;
+					stages[l] = largs.brick || largs.distributed.compare("") != 0 ? STAGE_DECIMATE : STAGE_CONTOUR;
+					if (largs.cache_dir.compare("") != 0)
+						cache_keep(largs, keys[l], stages[l], meshes[l], prof);
+				}
+			}
+
+			for (size_t l = 0; l < nout; l++) {
+				if (prof != NULL) {
+					prof->has_level = !largs.single;
+					prof->clevel = job.clevels[l];
+				}
+				vtkSmartPointer<vtkPolyData> mesh = meshes[l];
+				meshes[l] = NULL;
+				if (stages[l] < STAGE_SMOOTH) {
+					mesh = smooth_mesh(largs, move(mesh), 0, prof);
+					if (largs.smooth && largs.cache_dir.compare("") != 0)
+						cache_keep(largs, keys[l], STAGE_SMOOTH, mesh, prof);
+				}
+				if (stages[l] < STAGE_DECIMATE && largs.decimate) {
+					mesh = decimate_mesh(largs, move(mesh), largs.target_reduction, 0, prof);
+					if (largs.cache_dir.compare("") != 0)
+						cache_keep(largs, keys[l], STAGE_DECIMATE, mesh, prof);
+				}
+				if (join)
+					joined.push_back(mesh);
+				else
+					output_mesh(cargs, job, l, move(mesh), prof);
+			}
+			if (join) {
+				if (prof != NULL)
+					prof->has_level = 0;
+				output_mesh(cargs, job, 0, join_labels(joined, job.clevels, prof), prof);
+			}
+		}
+	}
+	catch (cancelled_error&) {
+		if (prof != NULL && cargs.profile_fn.compare("") != 0)
+			profile_write(profile, cargs.profile_fn);
+		throw;
+	}
+
+	if (cargs.verbose && cargs.pool_mb > 0) {
+		size_t reused, allocated, kept;
+		pool_stats(reused, allocated, kept);
+		cout << "Buffer pool: " << reused << " of " << reused + allocated << " large buffer(s) reused, " << (kept >> 20) << " MB kept" << endl;
+	}
+	if (cargs.profile_fn.compare("") != 0 && profile_write(profile, cargs.profile_fn) != 0)
+		return -1;
+	return 0;
+}
+
+// run the command line of a server request with the server's resident maps
+string serve_request(const struct args& sargs, struct resident_cache *resident, const struct server_request& req) {
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	vector<char *> argv;
+	argv.push_back(const_cast<char *>("meshmaker"));
+	for (size_t a = 0; a < req.args.size(); a++)
+		argv.push_back(const_cast<char *>(req.args[a].c_str()));
+	string error;
+	try {
+		struct args jargs = parse_args((int)argv.size(), &argv[0]);
+		if (jargs.serve)
+			throw invalid_argument("jobs cannot serve");
+		// stdout carries the responses and other descriptors are the server's
+		if (jargs.out_fd >= 0)
+			throw invalid_argument("jobs cannot write to stdout or --output-fd");
+		// stdout carries the responses; the thread pool is the server's
+		jargs.verbose = 0;
+		jargs.threads = sargs.threads;
+		jargs.resident = resident;
+		// the deadline runs from when the job starts
+		struct progress progress;
+		progress.json = jargs.progress_json;
+		progress_set_deadline(&progress, jargs.deadline);
+		jargs.progress = &progress;
+		if (run_jobs(jargs, make_jobs(jargs)) != 0)
+			error = "unable to write profile " + jargs.profile_fn;
+	}
+	catch (cancelled_error& e) {
+		error = string("cancelled: ") + e.what();
+	}
+	catch (exception& e) {
+		error = e.what();
+	}
+	double wall_s = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	if (sargs.verbose)
+		cerr << "Job " << req.id << (error.empty() ? " done" : " failed: " + error) << " in " << wall_s << " s" << endl;
+	return server_response(req, error, wall_s);
 }
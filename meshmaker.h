@@ -0,0 +1,130 @@
+/*
+ * meshmaker
+ *
+ * The meshing pipeline behind the meshmaker executable and libmeshmaker:
+ * its options, jobs and entry points
+ *
+ * License: Apache
+ */
+
+#ifndef MESHMAKER_MESHMAKER_H
+#define MESHMAKER_MESHMAKER_H
+
+// standard headers
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// VTK headers
+#include "vtkSmartPointer.h"
+#include "vtkImageData.h"
+#include "vtkPolyData.h"
+
+#include "components.h"
+#include "progress.h"
+#include "resident.h"
+#include "server.h"
+
+// exit codes besides EXIT_SUCCESS (also for -h) and EXIT_FAILURE (a job failed)
+static const int EXIT_USAGE = 2; // invalid arguments
+static const int EXIT_CANCELLED = 3; // SIGINT, SIGTERM or --deadline stopped the jobs
+
+// -h/--help: nothing to run, but nothing wrong either
+class help_requested : public std::invalid_argument {
+public:
+	help_requested() : std::invalid_argument("help requested") {}
+};
+
+// a finished mesh that was not written, for callers of the library
+struct mesh_output {
+	std::string fn; // where it would have been written
+	int has_level = 0; // all levels (or labels) of the job (otherwise only clevel)
+	double clevel = 0.0;
+	int lod = -1; // the mesh itself (otherwise this level of detail of it)
+	vtkSmartPointer<vtkPolyData> mesh;
+};
+
+struct args {
+	std::vector<float> clevels; // contour levels; 0.0 if none are given (or every label of a label map)
+	int single = 0; // one file per level (otherwise all levels in one file with a 'clevel' point array)
+	int labels = 0; // voxels are densities (if = 1 then integer labels, each meshed as its own surface)
+	std::string out_fn = "out";
+	int out_fd = -1; // write files named after out_fn (otherwise the one mesh to this file descriptor; '-o -' for stdout)
+	std::vector<std::string> map_fns; // one or more input maps
+	std::string manifest_fn = ""; // optional batch manifest
+	std::string out_format = "vtp";
+	int decimate = 0; // don't decimate by default
+	int smooth = 0; // smoothen
+	int smooth_iter = 20; // number of smoothing iterations
+	std::string smooth_engine = "vtk"; // smoothing engine: vtk or parallel
+	float target_reduction = 0.9;
+	std::string decimate_engine = "pro"; // decimation engine: pro or quadric
+	std::string optimize = "none"; // final triangle order: none, cache (Tipsify) or morton (Morton curve, then Tipsify)
+	int vertex_cache = 16; // vertex cache entries to optimize for
+	std::vector<float> lods; // no LOD pyramid (otherwise the target reductions of its levels, ascending)
+	int ascii = 0; // output not ASCII but BINARY (if = 1 then ASCII)
+	int uint64 = 0; // headers of vtp are NOT in uint64 but in uint32
+	int int32 = 0; // vtkIdType used are 64 bit instead of 32 bit 
+	int float32 = 0; // points are written as computed (if = 1 then as Float32)
+	int quantize = 0; // points are not quantized (if = 1 then as UInt16 over their bounding box)
+	int normals = 0; // no normals (if = 1 then Float32 vertex normals, if = 2 then oct-encoded to 2 x Int16)
+	std::string compressor = "none"; // vtp compressor: none, zlib, lz4 or lzma
+	int compression_level = 5; // 1 (fastest) to 9 (smallest)
+	int block_size = 32768; // bytes per compressed block
+	int appended = 0; // vtp arrays are base64 inline (otherwise raw in an appended section)
+	int align = 0; // appended arrays are packed (otherwise start at multiples of this many bytes)
+	int verbose = 0; // do not show verbose output
+	std::string engine = "contour"; // isosurface extraction engine: contour or flying-edges
+	int threads = 0; // number of SMP worker threads (0 = let VTK decide)
+	int mmap = 0; // read the whole map with vtkMRCReader (if = 1 then memory-map and stream slabs)
+	int slab = 64; // sections per slab when streaming
+	int brick = 0; // mesh the whole volume at once (if > 0 then process bricks of this edge length concurrently)
+	std::string distributed = ""; // one process meshes the whole map (otherwise each MPI rank a slab of it, then 'merge' or 'pvtp')
+	int skip_empty = 0; // contour every voxel (if > 0 then only blocks of this edge length that a level crosses)
+	std::string prefilter = "none"; // voxels are contoured as read (otherwise smoothed first with 'gaussian' or 'median')
+	double sigma = 1.0; // of the Gaussian, in voxels
+	struct component_filter components; // keep every connected component (see components.h)
+	std::vector<double> crop; // whole map (otherwise i0,i1,j0,j1,k0,k1 voxel indices, inclusive)
+	std::vector<double> crop_physical; // whole map (otherwise x0,x1,y0,y1,z0,z1 in the units of the map's cell, usually Angstrom)
+	int autocrop = 0; // crop to the voxels above the lowest contour level (plus one voxel)
+	int stride = 1; // every voxel (otherwise every stride-th along each axis)
+	int bin = 1; // no binning (otherwise the mean of each bin^3 voxels)
+	std::string profile_fn = ""; // no profiling (otherwise where to write the per-stage JSON; '-' for stderr)
+	std::string cache_dir = ""; // no cache (otherwise where surfaces are kept after each stage)
+	int serve = 0; // mesh the maps given (if = 1 then run the JSON-line jobs read from stdin)
+	int workers = 2; // jobs run at once when serving
+	int resident_mb = 2048; // memory for the maps kept between the jobs of a server
+	struct resident_cache *resident = NULL; // maps shared by the jobs of a server (not an option)
+	int pool_mb = 0; // freed buffers go back to the system (otherwise megabytes of them kept for reuse)
+	int progress_json = 0; // no progress events (if = 1 then JSON lines on stderr)
+	double deadline = 0.0; // no deadline (otherwise seconds after which the jobs are cancelled)
+	struct progress *progress = NULL; // where the running jobs report and are cancelled (not an option)
+	vtkImageData *image = NULL; // maps are read (otherwise the map of every job, shared with the caller: never modified)
+	std::vector<struct mesh_output> *meshes = NULL; // meshes are written (otherwise handed back here, unstripped; not an option)
+};
+
+// all meshes built from a single map; the map is read once for all levels
+struct job {
+	std::string map_fn;
+	std::string out_fn; // output prefix
+	std::vector<float> clevels;
+};
+
+// print the options to stderr
+void print_usage(void);
+
+// the options of a command line; prints every problem found and throws std::invalid_argument if there
+// is any (help_requested for -h/--help, after printing the usage)
+struct args parse_args(int argc, char **argv);
+
+// the jobs of the positional maps and the manifest, if any
+std::vector<struct job> make_jobs(const struct args& cargs);
+
+// mesh every job; returns 0, or -1 if the profile cannot be written (other errors throw, cancellation
+// as cancelled_error)
+int run_jobs(const struct args& cargs, const std::vector<struct job>& jobs);
+
+// run the command line of a server request with the server's resident maps; the response is a JSON line
+std::string serve_request(const struct args& sargs, struct resident_cache *resident, const struct server_request& req);
+
+#endif
@@ -0,0 +1,573 @@
+/*
+ * meshmaker_bench
+ *
+ * Benchmark meshmaker on synthetic and reference maps
+ *
+ * Usage: meshmaker_bench [options] [-- meshmaker options]
+ *
+ * Synthetic float32 MRC maps (a sphere, uniform noise and Gaussian blobs) of
+ * the requested sizes are written to a work directory and meshed with every
+ * pipeline configuration (contour only, + smooth, + smooth + decimate) and
+ * every output format. Each run is profiled (-P) and its throughput reported
+ * in voxels/s and triangles/s; meshmaker options after '--' are passed on to
+ * every run so that engines and other settings can be compared.
+ *
+ * License: Apache
+ */
+
+// standard headers
+#include <exception>
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+
+// POSIX headers
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+extern char **environ;
+
+using namespace std;
+
+// the MRC header is 256 4-byte words
+static const size_t MRC_HEADER_SIZE = 1024;
+
+struct args {
+	string exe = ""; // meshmaker next to this executable
+	string work_dir = "."; // where maps, meshes and profiles go
+	string csv_fn = ""; // no CSV (otherwise also write the results here)
+	vector<string> generators; // all of them
+	vector<int> sizes; // 128 and 256
+	vector<string> ref_fns; // reference maps...
+	vector<float> ref_clevels; // ...and the contour level of each
+	vector<string> extra; // meshmaker options for every run
+	int repeat = 1; // keep the fastest of this many runs
+	int keep = 0; // remove synthetic maps and meshes once measured
+	int verbose = 0;
+};
+
+// a pipeline configuration and output format
+struct config {
+	string name;
+	string options;
+};
+
+struct result {
+	string map_fn;
+	string config;
+	string format;
+	double voxels = 0;
+	double triangles = 0;
+	double wall_s = 0; // of the pipeline (from the profile)
+	double process_s = 0; // of the whole process, including start-up
+	long peak_rss_kb = 0;
+	double out_bytes = 0;
+};
+
+void print_usage(void) {
+string usage_string = "\
+usage: meshmaker_bench [options] [-- meshmaker options]\n\
+\n\
+Mesh synthetic and reference maps with every pipeline configuration and output format and report throughput\n\
+\n\
+Options:\n\
+\t-x/--exe <str>\tthe meshmaker executable [default: meshmaker next to meshmaker_bench]\n\
+\t-d/--dir <str>\tthe work directory for maps, meshes and profiles [default: .]\n\
+\t-g/--generator <str>\n\t\t\tsynthetic map: 'sphere', 'noise' or 'blobs'; may be repeated [default: all]\n\
+\t-n/--size <int>\n\t\t\tedge length in voxels of the synthetic maps (128 to 1024); may be repeated [default: 128 and 256]\n\
+\t-R/--reference <str> <float>\n\t\t\ta reference map and the contour level to mesh it at; may be repeated\n\
+\t-r/--repeat <int>\n\t\t\tkeep the fastest of this many runs of each configuration [default: 1]\n\
+\t-C/--csv <str>\talso write the results as CSV to this file\n\
+\t-k/--keep\tkeep the synthetic maps and the meshes [default: false]\n\
+\t-h/--help\tshow this help\n\
+\t-v/--verbose\tverbose output\n";
+	cerr << usage_string << endl;
+}
+
+// parse command-line arguments
+struct args parse_args(int argc, char **argv) {
+	struct args cargs;
+	int i = 1;
+	int _abort = 0;
+
+	while (i < argc) {
+		// meshmaker executable
+		if (strcmp(argv[i], "-x") == 0 || strcmp(argv[i], "--exe") == 0) {
+			cargs.exe = argv[i+1];
+			i += 2;
+		}
+		// work directory
+		else if (strcmp(argv[i], "-d") == 0 || strcmp(argv[i], "--dir") == 0) {
+			cargs.work_dir = argv[i+1];
+			i += 2;
+		}
+		// synthetic maps
+		else if (strcmp(argv[i], "-g") == 0 || strcmp(argv[i], "--generator") == 0) {
+			string generator = argv[i+1];
+			if (generator.compare("sphere") != 0 && generator.compare("noise") != 0 && generator.compare("blobs") != 0) {
+				cerr << "Unknown generator '" << generator << "' (expected 'sphere', 'noise' or 'blobs')" << endl;
+				_abort = 1;
+			}
+			cargs.generators.push_back(generator);
+			i += 2;
+		}
+		// synthetic map size
+		else if (strcmp(argv[i], "-n") == 0 || strcmp(argv[i], "--size") == 0) {
+			try {
+				int size = stoi(argv[i+1]);
+				if (size < 8) {
+					cerr << "Synthetic maps must be at least 8 voxels along each edge" << endl;
+					_abort = 1;
+				}
+				cargs.sizes.push_back(size);
+			}
+			catch (exception& e) {
+				cerr << "exception caught: " << e.what() << endl;
+				_abort = 1;
+			}
+			i += 2;
+		}
+		// reference map and level
+		else if (strcmp(argv[i], "-R") == 0 || strcmp(argv[i], "--reference") == 0) {
+			try {
+				cargs.ref_fns.push_back(argv[i+1]);
+				cargs.ref_clevels.push_back(stof(argv[i+2]));
+			}
+			catch (exception& e) {
+				cerr << "exception caught: " << e.what() << endl;
+				_abort = 1;
+			}
+			i += 3;
+		}
+		// repeats
+		else if (strcmp(argv[i], "-r") == 0 || strcmp(argv[i], "--repeat") == 0) {
+			try {
+				cargs.repeat = stoi(argv[i+1]);
+				if (cargs.repeat < 1) {
+					cerr << "The number of repeats must be positive" << endl;
+					_abort = 1;
+				}
+			}
+			catch (exception& e) {
+				cerr << "exception caught: " << e.what() << endl;
+				_abort = 1;
+			}
+			i += 2;
+		}
+		// CSV results
+		else if (strcmp(argv[i], "-C") == 0 || strcmp(argv[i], "--csv") == 0) {
+			cargs.csv_fn = argv[i+1];
+			i += 2;
+		}
+		// keep meshes
+		else if (strcmp(argv[i], "-k") == 0 || strcmp(argv[i], "--keep") == 0) {
+			cargs.keep = 1;
+			i++;
+		}
+		// verbose
+		else if (strcmp(argv[i], "-v") == 0 || strcmp(argv[i], "--verbose") == 0) {
+			cargs.verbose = 1;
+			i++;
+		}
+		// help
+		else if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
+			print_usage();
+			exit(EXIT_SUCCESS);
+		}
+		// the rest is for meshmaker
+		else if (strcmp(argv[i], "--") == 0) {
+			for (i++; i < argc; i++)
+				cargs.extra.push_back(argv[i]);
+		}
+		else {
+			cerr << "Unknown option '" << argv[i] << "'" << endl;
+			_abort = 1;
+			i++;
+		}
+	}
+
+	// defaults
+	if (cargs.generators.empty() && cargs.ref_fns.empty()) {
+		cargs.generators.push_back("sphere");
+		cargs.generators.push_back("noise");
+		cargs.generators.push_back("blobs");
+	}
+	if (cargs.sizes.empty()) {
+		cargs.sizes.push_back(128);
+		cargs.sizes.push_back(256);
+	}
+	if (cargs.exe.compare("") == 0) {
+		string self = argv[0];
+		size_t slash = self.find_last_of('/');
+		cargs.exe = (slash == string::npos) ? "meshmaker" : self.substr(0, slash + 1) + "meshmaker";
+	}
+
+	// exit if we have to (after seeing all errors), with meshmaker's code for invalid arguments
+	if (_abort) {
+		exit(2);
+	}
+	return cargs;
+}
+
+// deterministic pseudo-random numbers so that maps are the same from run to run (splitmix64)
+static uint64_t mix(uint64_t x) {
+	x += 0x9e3779b97f4a7c15ULL;
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+	return x ^ (x >> 31);
+}
+
+static double uniform(uint64_t seed) {
+	return (mix(seed) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+struct blob {
+	double centre[3];
+	double sigma;
+};
+
+// write an n^3 float32 map (n Angstrom per edge) one section at a time; returns the contour level
+// at which to mesh it or NAN if it could not be written
+float write_map(const struct args& cargs, const string& generator, int n, const string& fn) {
+	float clevel = 0.5;
+	vector<struct blob> blobs;
+	if (generator.compare("blobs") == 0)
+		for (int b = 0; b < 24; b++) {
+			struct blob g;
+			for (int c = 0; c < 3; c++)
+				g.centre[c] = n * (0.15 + 0.7 * uniform(4 * b + c));
+			g.sigma = n * (0.03 + 0.05 * uniform(4 * b + 3));
+			blobs.push_back(g);
+		}
+	else if (generator.compare("sphere") == 0)
+		clevel = 0.0;
+
+	if (cargs.verbose)
+		cout << "Writing " << n << "^3 " << generator << " map to '" << fn << "'..." << endl;
+	ofstream out(fn.c_str(), ios::binary);
+	if (!out) {
+		cerr << "Unable to write '" << fn << "'" << endl;
+		return NAN;
+	}
+
+	// native byte order with a matching machine stamp
+	int32_t header[256];
+	memset(header, 0, sizeof(header));
+	float f;
+	for (int c = 0; c < 3; c++) {
+		header[c] = n; // nx, ny, nz
+		header[7 + c] = n; // mx, my, mz
+		f = n; // cell lengths
+		memcpy(&header[10 + c], &f, 4);
+		f = 90; // cell angles
+		memcpy(&header[13 + c], &f, 4);
+		header[16 + c] = c + 1; // mapc, mapr, maps
+	}
+	header[3] = 2; // float32
+	header[22] = 1; // space group
+	memcpy(&header[52], "MAP ", 4);
+	uint16_t one = 1;
+	unsigned char *stamp = reinterpret_cast<unsigned char *>(&header[53]);
+	stamp[0] = stamp[1] = (*reinterpret_cast<unsigned char *>(&one) == 1) ? 0x44 : 0x11;
+	out.write(reinterpret_cast<const char *>(header), MRC_HEADER_SIZE);
+
+	vector<float> section((size_t)n * n);
+	double centre = 0.5 * (n - 1), radius = 0.35 * n;
+	for (int z = 0; z < n; z++) {
+		if (generator.compare("sphere") == 0) {
+			// signed distance in voxels from a sphere (positive inside)
+			for (int y = 0; y < n; y++)
+				for (int x = 0; x < n; x++) {
+					double dx = x - centre, dy = y - centre, dz = z - centre;
+					section[(size_t)y * n + x] = (float)(radius - sqrt(dx * dx + dy * dy + dz * dz));
+				}
+		}
+		else if (generator.compare("noise") == 0) {
+			// the worst case: about one triangle per voxel edge crossing
+			for (size_t v = 0; v < section.size(); v++)
+				section[v] = (float)uniform(((uint64_t)z * n * n + v) ^ 0x5eedULL);
+		}
+		else {
+			// each blob only within three sigma
+			fill(section.begin(), section.end(), 0.0f);
+			for (size_t b = 0; b < blobs.size(); b++) {
+				const struct blob& g = blobs[b];
+				double reach = 3 * g.sigma, dz = z - g.centre[2];
+				if (fabs(dz) > reach)
+					continue;
+				int y0 = max(0, (int)ceil(g.centre[1] - reach)), y1 = min(n - 1, (int)floor(g.centre[1] + reach));
+				int x0 = max(0, (int)ceil(g.centre[0] - reach)), x1 = min(n - 1, (int)floor(g.centre[0] + reach));
+				double k = -0.5 / (g.sigma * g.sigma);
+				for (int y = y0; y <= y1; y++)
+					for (int x = x0; x <= x1; x++) {
+						double dx = x - g.centre[0], dy = y - g.centre[1];
+						section[(size_t)y * n + x] += (float)exp(k * (dx * dx + dy * dy + dz * dz));
+					}
+			}
+		}
+		out.write(reinterpret_cast<const char *>(&section[0]), section.size() * sizeof(float));
+	}
+	if (!out.good()) {
+		cerr << "Unable to write '" << fn << "'" << endl;
+		return NAN;
+	}
+	return clevel;
+}
+
+// the number of voxels in the MRC/CCP4 file fn (0 if it cannot be read)
+double map_voxels(const string& fn) {
+	ifstream in(fn.c_str(), ios::binary);
+	unsigned char header[MRC_HEADER_SIZE];
+	if (!in.read(reinterpret_cast<char *>(header), MRC_HEADER_SIZE))
+		return 0;
+	uint16_t one = 1;
+	int little = *reinterpret_cast<unsigned char *>(&one) == 1;
+	int swap = (header[212] == 0x44 || header[212] == 0x11) ? (header[212] == 0x44) != little : 0;
+	double voxels = 1;
+	for (int c = 0; c < 3; c++) {
+		unsigned char w[4];
+		for (int b = 0; b < 4; b++)
+			w[b] = header[4 * c + (swap ? 3 - b : b)];
+		int32_t d;
+		memcpy(&d, w, 4);
+		voxels *= d;
+	}
+	return voxels;
+}
+
+// the numbers following every occurrence of "key": in json
+vector<double> json_numbers(const string& json, const string& key) {
+	vector<double> numbers;
+	string needle = "\"" + key + "\": ";
+	for (size_t at = json.find(needle); at != string::npos; at = json.find(needle, at + 1))
+		numbers.push_back(atof(json.c_str() + at + needle.size()));
+	return numbers;
+}
+
+// the sum of key over the stages named stage in json
+double json_stage_sum(const string& json, const string& stage, const string& key) {
+	double sum = 0;
+	string needle = "{\"stage\": \"" + stage + "\"";
+	for (size_t at = json.find(needle); at != string::npos; at = json.find(needle, at + 1)) {
+		size_t end = json.find('}', at);
+		vector<double> numbers = json_numbers(json.substr(at, end - at), key);
+		if (!numbers.empty())
+			sum += numbers[0];
+	}
+	return sum;
+}
+
+double file_size(const string& fn) {
+	struct stat st;
+	return stat(fn.c_str(), &st) == 0 ? (double)st.st_size : 0;
+}
+
+// the words of a configuration's options (they hold no quotes)
+static void split_options(const string& options, vector<string>& words) {
+	istringstream in(options);
+	string word;
+	while (in >> word)
+		words.push_back(word);
+}
+
+// run argv (argv[0] is looked up on the PATH if it has no slash) without a shell and with stdout on
+// /dev/null if quiet; returns its wait status, or -1 if it cannot be started
+static int spawn(const vector<string>& argv, int quiet) {
+	vector<char *> words;
+	for (size_t a = 0; a < argv.size(); a++)
+		words.push_back(const_cast<char *>(argv[a].c_str()));
+	words.push_back(NULL);
+	posix_spawn_file_actions_t actions;
+	posix_spawn_file_actions_init(&actions);
+	if (quiet)
+		posix_spawn_file_actions_addopen(&actions, 1, "/dev/null", O_WRONLY, 0);
+	pid_t pid;
+	int failed = posix_spawnp(&pid, words[0], &actions, NULL, &words[0], environ);
+	posix_spawn_file_actions_destroy(&actions);
+	if (failed != 0) {
+		cerr << "Unable to run '" << argv[0] << "': " << strerror(failed) << endl;
+		return -1;
+	}
+	int status;
+	while (waitpid(pid, &status, 0) == -1)
+		if (errno != EINTR)
+			return -1;
+	return status;
+}
+
+// mesh fn at clevel with one configuration; returns 0 on success
+int run(const struct args& cargs, const string& fn, float clevel, const struct config& conf, const struct config& format, struct result& res) {
+	string prefix = cargs.work_dir + "/bench_out";
+	string prof_fn = cargs.work_dir + "/bench_profile.json";
+	ostringstream level;
+	level << setprecision(9) << clevel;
+	vector<string> argv;
+	argv.push_back(cargs.exe);
+	argv.push_back("-c");
+	argv.push_back(level.str());
+	split_options(conf.options, argv);
+	split_options(format.options, argv);
+	argv.push_back("-o");
+	argv.push_back(prefix);
+	argv.push_back("-P");
+	argv.push_back(prof_fn);
+	argv.insert(argv.end(), cargs.extra.begin(), cargs.extra.end());
+	argv.push_back(fn);
+	// as it would be typed, for messages
+	ostringstream cmd;
+	for (size_t a = 0; a < argv.size(); a++)
+		cmd << (a ? " " : "") << "'" << argv[a] << "'";
+	if (cargs.verbose)
+		cout << cmd.str() << endl;
+
+	for (int r = 0; r < cargs.repeat; r++) {
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		int status = spawn(argv, !cargs.verbose);
+		double process_s = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		if (status == -1 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+			cerr << cmd.str() << " failed" << endl;
+			return -1;
+		}
+
+		ifstream in(prof_fn.c_str());
+		stringstream json;
+		json << in.rdbuf();
+		vector<double> wall = json_numbers(json.str(), "total_wall_s");
+		vector<double> rss = json_numbers(json.str(), "peak_rss_kb");
+		if (wall.empty() || rss.empty()) {
+			cerr << "No profile in '" << prof_fn << "'" << endl;
+			return -1;
+		}
+		if (r > 0 && wall[0] >= res.wall_s)
+			continue;
+
+		// triangles as extracted: per piece when contoured whole, per merged level otherwise
+		res.triangles = json_stage_sum(json.str(), "contour", "out_cells");
+		if (res.triangles == 0)
+			res.triangles = json_stage_sum(json.str(), "merge", "in_cells");
+		res.wall_s = wall[0];
+		res.process_s = process_s;
+		res.peak_rss_kb = (long)rss[0];
+		res.out_bytes = file_size(prefix + "." + format.name);
+	}
+	if (!cargs.keep)
+		remove((prefix + "." + format.name).c_str());
+	remove(prof_fn.c_str());
+	return 0;
+}
+
+// count per second of wall time scaled by scale, as a string: empty (CSV) or "-" (table) if the run was
+// too fast for the profile's clock, rather than inf
+string rate(double count, double wall_s, double scale, int csv) {
+	if (!(wall_s > 0))
+		return csv ? "" : "-";
+	ostringstream text;
+	if (csv)
+		text << setprecision(9) << count / wall_s * scale;
+	else
+		text << fixed << setprecision(2) << count / wall_s * scale;
+	return text.str();
+}
+
+void print_result(const struct result& res, ostream& out, int csv) {
+	if (csv) {
+		out << setprecision(9) << res.map_fn << "," << res.config << "," << res.format << "," << res.voxels << ","
+			<< res.triangles << "," << res.wall_s << "," << res.process_s << "," << rate(res.voxels, res.wall_s, 1.0, 1) << ","
+			<< rate(res.triangles, res.wall_s, 1.0, 1) << "," << res.peak_rss_kb << "," << res.out_bytes << endl;
+		return;
+	}
+	out << left << setw(28) << res.map_fn.substr(res.map_fn.find_last_of('/') + 1) << setw(10) << res.config << setw(5) << res.format
+		<< right << fixed << setprecision(3) << setw(10) << res.wall_s << setw(10) << res.process_s
+		<< setprecision(2) << setw(12) << rate(res.voxels, res.wall_s, 1e-6, 0) << setw(12) << rate(res.triangles, res.wall_s, 1e-6, 0)
+		<< setw(12) << res.triangles * 1e-6 << setw(10) << res.peak_rss_kb / 1024.0 << setw(10) << res.out_bytes / 1048576.0 << endl;
+	out.unsetf(ios::floatfield);
+}
+
+int main(int argc, char **argv)
+{
+	// get the args
+	struct args cargs = parse_args(argc, argv);
+
+	vector<struct config> configs;
+	configs.push_back({"contour", ""});
+	configs.push_back({"smooth", "-s"});
+	configs.push_back({"decimate", "-s -D"});
+	vector<struct config> formats;
+	formats.push_back({"vtp", "-X"});
+	formats.push_back({"vtk", "-V"});
+	formats.push_back({"stl", "-S"});
+
+	// synthetic maps first, then the reference maps
+	vector<string> map_fns;
+	vector<float> clevels;
+	vector<int> generated;
+	for (size_t s = 0; s < cargs.sizes.size(); s++)
+		for (size_t g = 0; g < cargs.generators.size(); g++) {
+			ostringstream fn;
+			fn << cargs.work_dir << "/bench_" << cargs.generators[g] << "_" << cargs.sizes[s] << ".map";
+			float clevel = write_map(cargs, cargs.generators[g], cargs.sizes[s], fn.str());
+			if (std::isnan(clevel))
+				return EXIT_FAILURE;
+			map_fns.push_back(fn.str());
+			clevels.push_back(clevel);
+			generated.push_back(1);
+		}
+	for (size_t r = 0; r < cargs.ref_fns.size(); r++) {
+		map_fns.push_back(cargs.ref_fns[r]);
+		clevels.push_back(cargs.ref_clevels[r]);
+		generated.push_back(0);
+	}
+
+	ofstream csv;
+	if (cargs.csv_fn.compare("") != 0) {
+		csv.open(cargs.csv_fn.c_str());
+		if (!csv) {
+			cerr << "Unable to write '" << cargs.csv_fn << "'" << endl;
+			return EXIT_FAILURE;
+		}
+		csv << "map,config,format,voxels,triangles,wall_s,process_s,voxels_per_s,triangles_per_s,peak_rss_kb,out_bytes" << endl;
+	}
+	cout << left << setw(28) << "map" << setw(10) << "config" << setw(5) << "fmt" << right << setw(10) << "wall_s"
+		<< setw(10) << "proc_s" << setw(12) << "Mvoxels/s" << setw(12) << "Mtris/s" << setw(12) << "Mtris"
+		<< setw(10) << "RSS MB" << setw(10) << "out MB" << endl;
+
+	int status = EXIT_SUCCESS;
+	for (size_t m = 0; m < map_fns.size(); m++) {
+		double voxels = map_voxels(map_fns[m]);
+		if (voxels == 0) {
+			cerr << "Unable to read the header of '" << map_fns[m] << "'" << endl;
+			status = EXIT_FAILURE;
+			continue;
+		}
+		for (size_t c = 0; c < configs.size(); c++)
+			for (size_t f = 0; f < formats.size(); f++) {
+				struct result res;
+				res.map_fn = map_fns[m];
+				res.config = configs[c].name;
+				res.format = formats[f].name;
+				res.voxels = voxels;
+				if (run(cargs, map_fns[m], clevels[m], configs[c], formats[f], res) != 0) {
+					status = EXIT_FAILURE;
+					continue;
+				}
+				print_result(res, cout, 0);
+				if (csv.is_open())
+					print_result(res, csv, 1);
+			}
+		if (generated[m] && !cargs.keep)
+			remove(map_fns[m].c_str());
+	}
+	return status;
+}
@@ -0,0 +1,147 @@
+/*
+ * normals
+ *
+ * Parallel vertex normals and their octahedral encoding (see normals.h)
+ *
+ * License: Apache
+ */
+
+// standard headers
+#include <cmath>
+#include <vector>
+
+// VTK headers
+#include "vtkCellArray.h"
+#include "vtkPoints.h"
+#include "vtkSMPTools.h"
+
+#include "normals.h"
+#include "pool.h"
+
+using namespace std;
+
+vtkSmartPointer<vtkFloatArray> vertex_normals(vtkPolyData *mesh) {
+	vtkIdType npts = mesh->GetNumberOfPoints();
+	vtkPoints *points = mesh->GetPoints();
+
+	// the triangles of the polygons (as fans) and of the strips, with a consistent winding
+	pool_vector<vtkIdType> tris;
+	vtkIdType n;
+	const vtkIdType *pts;
+	vtkCellArray *polys = mesh->GetPolys();
+	for (polys->InitTraversal(); polys->GetNextCell(n, pts);)
+		for (vtkIdType t = 1; t + 1 < n; t++) {
+			tris.push_back(pts[0]);
+			tris.push_back(pts[t]);
+			tris.push_back(pts[t + 1]);
+		}
+	vtkCellArray *strips = mesh->GetStrips();
+	for (strips->InitTraversal(); strips->GetNextCell(n, pts);)
+		for (vtkIdType t = 0; t + 2 < n; t++) {
+			tris.push_back(pts[t + (t & 1)]);
+			tris.push_back(pts[t + 1 - (t & 1)]);
+			tris.push_back(pts[t + 2]);
+		}
+	vtkIdType ntris = tris.size() / 3;
+
+	// area-weighted normals (half the cross product) of every triangle
+	pool_vector<double> face(3 * ntris);
+	auto faces = [&](vtkIdType first, vtkIdType last) {
+		double a[3], b[3], c[3];
+		for (vtkIdType t = first; t < last; t++) {
+			points->GetPoint(tris[3 * t], a);
+			points->GetPoint(tris[3 * t + 1], b);
+			points->GetPoint(tris[3 * t + 2], c);
+			double u[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]}, v[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+			face[3 * t] = 0.5 * (u[1] * v[2] - u[2] * v[1]);
+			face[3 * t + 1] = 0.5 * (u[2] * v[0] - u[0] * v[2]);
+			face[3 * t + 2] = 0.5 * (u[0] * v[1] - u[1] * v[0]);
+		}
+	};
+	vtkSMPTools::For(0, ntris, faces);
+
+	// the triangles around each point (CSR) so that every point sums its own without atomics
+	pool_vector<vtkIdType> first(npts + 1, 0), around(tris.size());
+	for (size_t k = 0; k < tris.size(); k++)
+		first[tris[k] + 1]++;
+	for (vtkIdType p = 0; p < npts; p++)
+		first[p + 1] += first[p];
+	pool_vector<vtkIdType> fill(first.begin(), first.end() - 1);
+	for (size_t k = 0; k < tris.size(); k++)
+		around[fill[tris[k]]++] = k / 3;
+
+	vtkSmartPointer<vtkFloatArray> normals = vtkSmartPointer<vtkFloatArray>::New();
+	normals->SetName("Normals");
+	pool_values(normals.GetPointer(), 3, npts);
+	float *out = normals->GetPointer(0);
+	auto sum = [&](vtkIdType p0, vtkIdType p1) {
+		for (vtkIdType p = p0; p < p1; p++) {
+			double s[3] = {0.0, 0.0, 0.0};
+			for (vtkIdType k = first[p]; k < first[p + 1]; k++)
+				for (int d = 0; d < 3; d++)
+					s[d] += face[3 * around[k] + d];
+			double length = sqrt(s[0] * s[0] + s[1] * s[1] + s[2] * s[2]);
+			for (int d = 0; d < 3; d++)
+				out[3 * p + d] = length > 0 ? (float)(s[d] / length) : 0.0f;
+		}
+	};
+	vtkSMPTools::For(0, npts, sum);
+	return normals;
+}
+
+// -1 or 1 (0 counts as positive so that the poles of the octahedron map to its corners)
+static inline float sign_not_zero(float v) {
+	return v < 0.0f ? -1.0f : 1.0f;
+}
+
+static inline short snorm16(float v) {
+	v = v < -1.0f ? -1.0f : (v > 1.0f ? 1.0f : v);
+	return (short)lrintf(v * 32767.0f);
+}
+
+vtkSmartPointer<vtkShortArray> oct_encode(vtkFloatArray *normals) {
+	vtkIdType n = normals->GetNumberOfTuples();
+	vtkSmartPointer<vtkShortArray> oct = vtkSmartPointer<vtkShortArray>::New();
+	oct->SetName("OctNormals");
+	pool_values(oct.GetPointer(), 2, n);
+	const float *in = normals->GetPointer(0);
+	short *out = oct->GetPointer(0);
+	auto encode = [&](vtkIdType first, vtkIdType last) {
+		for (vtkIdType p = first; p < last; p++) {
+			float x = in[3 * p], y = in[3 * p + 1], z = in[3 * p + 2];
+			float l1 = fabsf(x) + fabsf(y) + fabsf(z);
+			if (l1 == 0.0f) {
+				out[2 * p] = out[2 * p + 1] = 0;
+				continue;
+			}
+			x /= l1;
+			y /= l1;
+			// the lower half folds over the diagonals
+			if (z < 0.0f) {
+				float fx = (1.0f - fabsf(y)) * sign_not_zero(x), fy = (1.0f - fabsf(x)) * sign_not_zero(y);
+				x = fx;
+				y = fy;
+			}
+			out[2 * p] = snorm16(x);
+			out[2 * p + 1] = snorm16(y);
+		}
+	};
+	vtkSMPTools::For(0, n, encode);
+	return oct;
+}
+
+void oct_decode(const short *c, short *out) {
+	float x = c[0] / 32767.0f, y = c[1] / 32767.0f, z = 1.0f - fabsf(x) - fabsf(y);
+	// the lower half unfolds back over the diagonals
+	if (z < 0.0f) {
+		float fx = (1.0f - fabsf(y)) * sign_not_zero(x), fy = (1.0f - fabsf(x)) * sign_not_zero(y);
+		x = fx;
+		y = fy;
+	}
+	float length = sqrtf(x * x + y * y + z * z);
+	if (length == 0.0f)
+		length = 1.0f;
+	out[0] = snorm16(x / length);
+	out[1] = snorm16(y / length);
+	out[2] = snorm16(z / length);
+}
@@ -0,0 +1,33 @@
+/*
+ * normals
+ *
+ * Smooth per-vertex normals computed on all threads, optionally packed
+ * into two 16-bit octahedral coordinates per vertex
+ *
+ * License: Apache
+ */
+
+#ifndef MESHMAKER_NORMALS_H
+#define MESHMAKER_NORMALS_H
+
+// VTK headers
+#include "vtkSmartPointer.h"
+#include "vtkFloatArray.h"
+#include "vtkPolyData.h"
+#include "vtkShortArray.h"
+
+// the unit normal of each point of mesh: the sum of the normals of the polygons and strip triangles
+// around it weighted by their areas, following their winding; points in no polygon get (0, 0, 0).
+// Named "Normals"
+vtkSmartPointer<vtkFloatArray> vertex_normals(vtkPolyData *mesh);
+
+// normals mapped onto an octahedron unfolded into a square, as two signed-normalized 16-bit
+// coordinates each (decode with v = (x, y, 1 - |x| - |y|) for x, y = c / 32767 and, where
+// v[2] < 0, x, y = (1 - |y|) * sign(x), (1 - |x|) * sign(y); then normalize). Named "OctNormals"
+vtkSmartPointer<vtkShortArray> oct_encode(vtkFloatArray *normals);
+
+// the unit normal of the two coordinates c of oct_encode() as three signed-normalized 16-bit
+// components (as glTF takes them)
+void oct_decode(const short *c, short *out);
+
+#endif
@@ -0,0 +1,161 @@
+/*
+ * pool
+ *
+ * Reusable buffers (see pool.h)
+ *
+ * License: Apache
+ */
+
+// standard headers
+#include <cstdint>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <new>
+#include <vector>
+
+// VTK headers
+#include "vtkDoubleArray.h"
+#include "vtkFloatArray.h"
+#include "vtkSMPTools.h"
+
+#include "pool.h"
+
+using namespace std;
+
+// each block starts with its size, one alignment unit ahead of the caller's memory
+static const size_t HEADER_SIZE = 64;
+// smaller blocks come and go through malloc's own free lists
+static const size_t MIN_POOLED = 64 << 10;
+
+struct pool {
+	mutex lock;
+	size_t limit = 0, kept = 0;
+	size_t reused = 0, allocated = 0;
+	map<size_t, vector<unsigned char *> > free_blocks; // by size
+};
+
+// never destroyed, as VTK may release arrays after static destructors have run
+static struct pool& the_pool(void) {
+	static struct pool *pool = new struct pool;
+	return *pool;
+}
+
+// the size of the block that holds bytes: quarter steps between powers of two, so that at most a fifth
+// of a large block is wasted and blocks of about the same size are found again
+static size_t block_size(size_t bytes) {
+	if (bytes < MIN_POOLED)
+		return bytes;
+	size_t step = 1;
+	while (step * 8 <= bytes)
+		step <<= 1;
+	return (bytes + step - 1) / step * step;
+}
+
+// free kept blocks, the largest first, until the pool holds at most bytes (with the lock held)
+static void evict(struct pool& pool, size_t bytes) {
+	while (pool.kept > bytes && !pool.free_blocks.empty()) {
+		auto largest = --pool.free_blocks.end();
+		if (largest->second.empty()) {
+			pool.free_blocks.erase(largest);
+			continue;
+		}
+		free(largest->second.back());
+		largest->second.pop_back();
+		pool.kept -= largest->first;
+	}
+}
+
+void pool_limit(size_t bytes) {
+	struct pool& pool = the_pool();
+	lock_guard<mutex> guard(pool.lock);
+	pool.limit = bytes;
+	evict(pool, bytes);
+}
+
+void *pool_alloc(size_t bytes) {
+	size_t size = block_size(bytes);
+	if (size >= MIN_POOLED) {
+		struct pool& pool = the_pool();
+		lock_guard<mutex> guard(pool.lock);
+		auto found = pool.free_blocks.find(size);
+		if (found != pool.free_blocks.end() && !found->second.empty()) {
+			unsigned char *raw = found->second.back();
+			found->second.pop_back();
+			pool.kept -= size;
+			pool.reused++;
+			return raw + HEADER_SIZE;
+		}
+		pool.allocated++;
+	}
+	void *raw;
+	if (posix_memalign(&raw, HEADER_SIZE, HEADER_SIZE + size) != 0)
+		throw bad_alloc();
+	*static_cast<size_t *>(raw) = size;
+	return static_cast<unsigned char *>(raw) + HEADER_SIZE;
+}
+
+void pool_free(void *block) {
+	if (block == NULL)
+		return;
+	unsigned char *raw = static_cast<unsigned char *>(block) - HEADER_SIZE;
+	size_t size = *reinterpret_cast<size_t *>(raw);
+	if (size >= MIN_POOLED) {
+		struct pool& pool = the_pool();
+		lock_guard<mutex> guard(pool.lock);
+		// blocks of the sizes now in use make room for themselves
+		if (size <= pool.limit) {
+			evict(pool, pool.limit - size);
+			pool.free_blocks[size].push_back(raw);
+			pool.kept += size;
+			return;
+		}
+	}
+	free(raw);
+}
+
+void pool_stats(size_t& reused, size_t& allocated, size_t& kept) {
+	struct pool& pool = the_pool();
+	lock_guard<mutex> guard(pool.lock);
+	reused = pool.reused;
+	allocated = pool.allocated;
+	kept = pool.kept;
+}
+
+vtkSmartPointer<vtkPoints> pool_points(int data_type, vtkIdType npts) {
+	vtkSmartPointer<vtkPoints> points = vtkSmartPointer<vtkPoints>::New();
+	if (data_type == VTK_DOUBLE) {
+		vtkSmartPointer<vtkDoubleArray> data = vtkSmartPointer<vtkDoubleArray>::New();
+		pool_values(data.GetPointer(), 3, npts);
+		points->SetData(data);
+	}
+	else {
+		vtkSmartPointer<vtkFloatArray> data = vtkSmartPointer<vtkFloatArray>::New();
+		pool_values(data.GetPointer(), 3, npts);
+		points->SetData(data);
+	}
+	return points;
+}
+
+vtkSmartPointer<vtkCellArray> pool_cells(vtkIdType ncells, vtkIdType nconn, vtkTypeInt64 *&offsets, vtkTypeInt64 *&conn) {
+	vtkSmartPointer<vtkTypeInt64Array> offsets_array = vtkSmartPointer<vtkTypeInt64Array>::New();
+	vtkSmartPointer<vtkTypeInt64Array> conn_array = vtkSmartPointer<vtkTypeInt64Array>::New();
+	pool_values(offsets_array.GetPointer(), 1, ncells + 1);
+	pool_values(conn_array.GetPointer(), 1, nconn);
+	offsets = offsets_array->GetPointer(0);
+	conn = conn_array->GetPointer(0);
+	vtkSmartPointer<vtkCellArray> cells = vtkSmartPointer<vtkCellArray>::New();
+	cells->SetData(offsets_array.GetPointer(), conn_array.GetPointer());
+	return cells;
+}
+
+vtkSmartPointer<vtkCellArray> pool_triangles(vtkIdType ntris, vtkTypeInt64 *&conn) {
+	vtkTypeInt64 *offsets;
+	vtkSmartPointer<vtkCellArray> cells = pool_cells(ntris, 3 * ntris, offsets, conn);
+	auto fill = [&](vtkIdType first, vtkIdType last) {
+		for (vtkIdType t = first; t < last; t++)
+			offsets[t] = 3 * t;
+	};
+	vtkSMPTools::For(0, ntris + 1, fill);
+	return cells;
+}
@@ -0,0 +1,80 @@
+/*
+ * pool
+ *
+ * Process-wide pool of large buffers that are reused rather than given
+ * back to the system, for the point, connectivity and scratch arrays that
+ * every stage of every job allocates afresh
+ *
+ * License: Apache
+ */
+
+#ifndef MESHMAKER_POOL_H
+#define MESHMAKER_POOL_H
+
+// standard headers
+#include <cstddef>
+#include <vector>
+
+// VTK headers
+#include "vtkSmartPointer.h"
+#include "vtkAbstractArray.h"
+#include "vtkCellArray.h"
+#include "vtkPoints.h"
+#include "vtkTypeInt64Array.h"
+
+// keep up to bytes of freed buffers for reuse (0, the default, frees them at once); may be called at any time
+void pool_limit(size_t bytes);
+
+// a 64-byte aligned block of at least bytes bytes, reused from the pool if one of its size is there;
+// throws std::bad_alloc if there is no memory
+void *pool_alloc(size_t bytes);
+
+// give a block of pool_alloc() back (NULL is ignored) to be kept, after freeing the largest blocks
+// kept if the pool is full (blocks larger than the whole pool are freed at once).
+// Safe to call from any thread, and as the free function of VTK arrays
+void pool_free(void *block);
+
+// the allocations served from the pool and from the system so far, and the bytes the pool holds
+void pool_stats(size_t& reused, size_t& allocated, size_t& kept);
+
+// an allocator of pool blocks, for scratch vectors of many points or triangles
+template <class T>
+struct pool_allocator {
+	typedef T value_type;
+	pool_allocator() {}
+	template <class U> pool_allocator(const pool_allocator<U>&) {}
+	T *allocate(size_t n) { return static_cast<T *>(pool_alloc(n * sizeof(T))); }
+	void deallocate(T *p, size_t) { pool_free(p); }
+};
+
+template <class T, class U>
+bool operator==(const pool_allocator<T>&, const pool_allocator<U>&) { return true; }
+
+template <class T, class U>
+bool operator!=(const pool_allocator<T>&, const pool_allocator<U>&) { return false; }
+
+template <class T>
+using pool_vector = std::vector<T, pool_allocator<T> >;
+
+// make array hold ntuples tuples of ncomponents (uninitialized) in a pool block, which goes back to
+// the pool when VTK releases the array
+template <class A>
+void pool_values(A *array, int ncomponents, vtkIdType ntuples) {
+	typedef typename A::ValueType T;
+	vtkIdType n = (vtkIdType)ncomponents * ntuples;
+	array->SetNumberOfComponents(ncomponents);
+	array->SetArray(static_cast<T *>(pool_alloc(n * sizeof(T))), n, 0, vtkAbstractArray::VTK_DATA_ARRAY_USER_DEFINED);
+	array->SetArrayFreeFunction(pool_free);
+}
+
+// npts points of data_type (VTK_FLOAT or VTK_DOUBLE) in a pool block, to be set by the caller
+vtkSmartPointer<vtkPoints> pool_points(int data_type, vtkIdType npts);
+
+// ncells cells of nconn point ids in all, in pool blocks: the caller fills offsets (ncells + 1 of them,
+// from 0) and conn
+vtkSmartPointer<vtkCellArray> pool_cells(vtkIdType ncells, vtkIdType nconn, vtkTypeInt64 *&offsets, vtkTypeInt64 *&conn);
+
+// ntris triangles (offsets filled in) whose 3 * ntris point ids the caller fills in conn
+vtkSmartPointer<vtkCellArray> pool_triangles(vtkIdType ntris, vtkTypeInt64 *&conn);
+
+#endif
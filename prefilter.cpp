@@ -0,0 +1,141 @@
+/*
+ * prefilter
+ *
+ * Gaussian and median volume filters (see prefilter.h)
+ *
+ * License: Apache
+ */
+
+// standard headers
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+// VTK headers
+#include "vtkSMPTools.h"
+
+#include "prefilter.h"
+
+using namespace std;
+
+int prefilter_halo(const string& kernel, double sigma) {
+	if (kernel.compare("gaussian") == 0)
+		return max(1, (int)ceil(3.0 * sigma));
+	if (kernel.compare("median") == 0)
+		return 1;
+	return 0;
+}
+
+// out = sum of weights[k] * rows[k] over the 2r + 1 rows of n values; out is overwritten. The loops
+// run along the rows so that the compiler vectorizes them
+static inline void weigh_rows(float *out, const float * const *rows, const vector<float>& weights, size_t n) {
+	for (size_t i = 0; i < n; i++)
+		out[i] = 0.0f;
+	for (size_t k = 0; k < weights.size(); k++) {
+		const float *row = rows[k];
+		float w = weights[k];
+		for (size_t i = 0; i < n; i++)
+			out[i] += w * row[i];
+	}
+}
+
+// one pass of the separable Gaussian along each axis; each pass copies the lines it reads (padded
+// with the edge voxels) into per-chunk scratch and writes the weighted sum back over them
+static void gaussian(float *data, const int dims[3], double sigma) {
+	int r = prefilter_halo("gaussian", sigma);
+	vector<float> weights(2 * r + 1);
+	double sum = 0.0;
+	for (int k = -r; k <= r; k++)
+		sum += exp(-0.5 * k * k / (sigma * sigma));
+	for (int k = -r; k <= r; k++)
+		weights[k + r] = (float)(exp(-0.5 * k * k / (sigma * sigma)) / sum);
+	size_t nx = dims[0], ny = dims[1], nz = dims[2], section = nx * ny;
+
+	// along x each padded row is read at 2r + 1 offsets
+	auto along_x = [&](vtkIdType first, vtkIdType last) {
+		vector<float> pad(nx + 2 * r);
+		vector<const float *> rows(2 * r + 1);
+		for (int k = 0; k <= 2 * r; k++)
+			rows[k] = &pad[k];
+		for (vtkIdType row = first; row < last; row++) {
+			float *line = data + row * nx;
+			memcpy(&pad[r], line, nx * sizeof(float));
+			for (int k = 0; k < r; k++) {
+				pad[k] = line[0];
+				pad[r + nx + k] = line[nx - 1];
+			}
+			weigh_rows(line, &rows[0], weights, nx);
+		}
+	};
+	vtkSMPTools::For(0, (vtkIdType)(ny * nz), along_x);
+
+	// along y and z whole rows are weighed at once
+	auto along_y = [&](vtkIdType first, vtkIdType last) {
+		vector<float> pad(nx * ny);
+		vector<const float *> rows(2 * r + 1);
+		for (vtkIdType z = first; z < last; z++) {
+			float *plane = data + z * section;
+			memcpy(&pad[0], plane, section * sizeof(float));
+			for (size_t y = 0; y < ny; y++) {
+				for (int k = -r; k <= r; k++)
+					rows[k + r] = &pad[min(max((long)y + k, 0L), (long)ny - 1) * nx];
+				weigh_rows(plane + y * nx, &rows[0], weights, nx);
+			}
+		}
+	};
+	vtkSMPTools::For(0, (vtkIdType)nz, along_y);
+	auto along_z = [&](vtkIdType first, vtkIdType last) {
+		vector<float> pad(nx * nz);
+		vector<const float *> rows(2 * r + 1);
+		for (vtkIdType y = first; y < last; y++) {
+			for (size_t z = 0; z < nz; z++)
+				memcpy(&pad[z * nx], data + z * section + y * nx, nx * sizeof(float));
+			for (size_t z = 0; z < nz; z++) {
+				for (int k = -r; k <= r; k++)
+					rows[k + r] = &pad[min(max((long)z + k, 0L), (long)nz - 1) * nx];
+				weigh_rows(data + z * section + y * nx, &rows[0], weights, nx);
+			}
+		}
+	};
+	vtkSMPTools::For(0, (vtkIdType)ny, along_z);
+}
+
+// the 3x3x3 median a section at a time; the original values of the section being filtered and of
+// the one before are kept aside (the one after has not been written yet)
+static void median(float *data, const int dims[3]) {
+	size_t nx = dims[0], ny = dims[1], nz = dims[2], section = nx * ny;
+	vector<float> previous(section), current(section);
+	for (size_t z = 0; z < nz; z++) {
+		float *plane = data + z * section;
+		current.swap(previous);
+		memcpy(&current[0], plane, section * sizeof(float));
+		const float *planes[3] = { z > 0 ? &previous[0] : &current[0], &current[0], z + 1 < nz ? plane + section : &current[0] };
+		auto filter = [&](vtkIdType first, vtkIdType last) {
+			float window[27];
+			for (vtkIdType y = first; y < last; y++) {
+				size_t ys[3] = { (size_t)max((long)y - 1, 0L) * nx, (size_t)y * nx, (size_t)min((long)y + 1, (long)ny - 1) * nx };
+				for (size_t x = 0; x < nx; x++) {
+					size_t xs[3] = { x > 0 ? x - 1 : 0, x, min(x + 1, nx - 1) };
+					int n = 0;
+					for (int c = 0; c < 3; c++)
+						for (int b = 0; b < 3; b++)
+							for (int a = 0; a < 3; a++)
+								window[n++] = planes[c][ys[b] + xs[a]];
+					nth_element(window, window + 13, window + 27);
+					plane[y * nx + x] = window[13];
+				}
+			}
+		};
+		vtkSMPTools::For(0, (vtkIdType)ny, filter);
+	}
+}
+
+void prefilter_run(float *data, const int dims[3], const string& kernel, double sigma) {
+	if ((size_t)dims[0] * dims[1] * dims[2] == 0)
+		return;
+	if (kernel.compare("gaussian") == 0)
+		gaussian(data, dims, sigma);
+	else if (kernel.compare("median") == 0)
+		median(data, dims);
+}
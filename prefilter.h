@@ -0,0 +1,24 @@
+/*
+ * prefilter
+ *
+ * Smoothing of the voxels of a map before it is contoured: a separable
+ * Gaussian or a 3x3x3 median filter, in place on all threads
+ *
+ * License: Apache
+ */
+
+#ifndef MESHMAKER_PREFILTER_H
+#define MESHMAKER_PREFILTER_H
+
+// standard headers
+#include <string>
+
+// the voxels that kernel ('gaussian' with sigma in voxels or 'median') reads past each side of a
+// voxel, so that a block grown by this much on every side filters its middle as the whole map would
+int prefilter_halo(const std::string& kernel, double sigma);
+
+// filter the dims[0] x dims[1] x dims[2] float voxels of data (x fastest) in place with kernel; voxels
+// past the edges of the block are taken to repeat the edge voxels
+void prefilter_run(float *data, const int dims[3], const std::string& kernel, double sigma);
+
+#endif
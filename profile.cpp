@@ -0,0 +1,130 @@
+/*
+ * profile
+ *
+ * Per-stage instrumentation (see profile.h)
+ *
+ * License: Apache
+ */
+
+// standard headers
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+// POSIX headers
+#include <sys/resource.h>
+
+#include "profile.h"
+
+using namespace std;
+
+static double wall_seconds(void) {
+	return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// CPU time and peak RSS of the whole process
+static void process_usage(double& cpu_s, long& peak_rss_kb) {
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	cpu_s = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec * 1e-6 + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec * 1e-6;
+#ifdef __APPLE__
+	peak_rss_kb = usage.ru_maxrss / 1024; // bytes
+#else
+	peak_rss_kb = usage.ru_maxrss; // kilobytes
+#endif
+}
+
+void profile_begin(struct profile *prof, const string& stage, vtkDataSet *in) {
+	if (prof == NULL)
+		return;
+	progress_check(prof->progress);
+	progress_stage(prof->progress, stage, prof->map_fn, prof->has_level, prof->clevel);
+	struct stage_profile s;
+	s.stage = stage;
+	s.map_fn = prof->map_fn;
+	s.has_level = prof->has_level;
+	s.clevel = prof->clevel;
+	if (in != NULL) {
+		s.in_points = in->GetNumberOfPoints();
+		s.in_cells = in->GetNumberOfCells();
+	}
+	prof->stages.push_back(s);
+	process_usage(prof->start_cpu, prof->start_rss_kb);
+	prof->start_wall = wall_seconds();
+}
+
+void profile_end(struct profile *prof, vtkDataSet *out) {
+	if (prof == NULL || prof->stages.empty())
+		return;
+	double wall = wall_seconds(), cpu;
+	long rss_kb;
+	process_usage(cpu, rss_kb);
+	struct stage_profile& s = prof->stages.back();
+	s.wall_s = wall - prof->start_wall;
+	s.cpu_s = cpu - prof->start_cpu;
+	s.peak_rss_delta_kb = rss_kb - prof->start_rss_kb;
+	if (out != NULL) {
+		s.out_points = out->GetNumberOfPoints();
+		s.out_cells = out->GetNumberOfCells();
+	}
+	progress_update(prof->progress, 1.0);
+}
+
+// s as a JSON string literal
+string json_string(const string& s) {
+	ostringstream out;
+	out << '"';
+	for (size_t i = 0; i < s.size(); i++) {
+		unsigned char c = s[i];
+		if (c == '"' || c == '\\')
+			out << '\\' << c;
+		else if (c < 0x20)
+			out << "\\u" << hex << setw(4) << setfill('0') << (int)c << dec << setfill(' ');
+		else
+			out << c;
+	}
+	out << '"';
+	return out.str();
+}
+
+int profile_write(const struct profile& prof, const string& fn) {
+	ostringstream json;
+	json << setprecision(9);
+	double wall = 0, cpu = 0;
+	json << "{\n  \"stages\": [";
+	for (size_t i = 0; i < prof.stages.size(); i++) {
+		const struct stage_profile& s = prof.stages[i];
+		wall += s.wall_s;
+		cpu += s.cpu_s;
+		json << (i ? "," : "") << "\n    {\"stage\": " << json_string(s.stage)
+			<< ", \"map\": " << json_string(s.map_fn);
+		if (s.has_level)
+			json << ", \"clevel\": " << s.clevel;
+		json << ", \"wall_s\": " << s.wall_s
+			<< ", \"cpu_s\": " << s.cpu_s
+			<< ", \"peak_rss_delta_kb\": " << s.peak_rss_delta_kb
+			<< ", \"in_points\": " << s.in_points
+			<< ", \"in_cells\": " << s.in_cells
+			<< ", \"out_points\": " << s.out_points
+			<< ", \"out_cells\": " << s.out_cells << "}";
+	}
+	double cpu_now;
+	long peak_rss_kb;
+	process_usage(cpu_now, peak_rss_kb);
+	json << "\n  ],\n  \"total_wall_s\": " << wall << ",\n  \"total_cpu_s\": " << cpu
+		<< ",\n  \"peak_rss_kb\": " << peak_rss_kb << "\n}\n";
+
+	if (fn.compare("-") == 0) {
+		cerr << json.str();
+		return 0;
+	}
+	ofstream out(fn.c_str());
+	if (!out) {
+		cerr << "Unable to write profile to '" << fn << "'" << endl;
+		return -1;
+	}
+	out << json.str();
+	return out.good() ? 0 : -1;
+}
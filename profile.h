@@ -0,0 +1,59 @@
+/*
+ * profile
+ *
+ * Per-stage wall time, CPU time, peak RSS growth and point/cell counts,
+ * reported as JSON (-P/--profile)
+ *
+ * License: Apache
+ */
+
+#ifndef MESHMAKER_PROFILE_H
+#define MESHMAKER_PROFILE_H
+
+// standard headers
+#include <string>
+#include <vector>
+
+// VTK headers
+#include "vtkDataSet.h"
+
+#include "progress.h"
+
+struct stage_profile {
+	std::string stage;
+	std::string map_fn;
+	int has_level = 0; // stages that handle all levels at once have none
+	double clevel = 0.0;
+	double wall_s = 0.0;
+	double cpu_s = 0.0; // user + system time of all threads
+	long peak_rss_delta_kb = 0; // growth of the peak resident set size
+	long long in_points = 0, in_cells = 0, out_points = 0, out_cells = 0;
+};
+
+struct profile {
+	// the job that the next stages belong to
+	std::string map_fn;
+	int has_level = 0;
+	double clevel = 0.0;
+	std::vector<struct stage_profile> stages;
+	// the stage being timed
+	double start_wall = 0.0, start_cpu = 0.0;
+	long start_rss_kb = 0;
+	struct progress *progress = NULL; // no events (otherwise where each stage is reported and checked for cancellation)
+};
+
+// start timing stage with input in (may be NULL) and report it at 0%, after throwing cancelled_error
+// if the job has been cancelled; does nothing if prof is NULL
+void profile_begin(struct profile *prof, const std::string& stage, vtkDataSet *in);
+
+// finish timing the current stage with output out (may be NULL) and report it at 100%; does nothing if
+// prof is NULL
+void profile_end(struct profile *prof, vtkDataSet *out);
+
+// s as a quoted and escaped JSON string
+std::string json_string(const std::string& s);
+
+// write all stages as JSON to fn ('-' for stderr); returns 0 on success
+int profile_write(const struct profile& prof, const std::string& fn);
+
+#endif
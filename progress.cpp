@@ -0,0 +1,138 @@
+/*
+ * progress
+ *
+ * Progress events and cancellation (see progress.h)
+ *
+ * License: Apache
+ */
+
+// standard headers
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+// POSIX headers
+#include <signal.h>
+
+#include "profile.h"
+#include "progress.h"
+
+using namespace std;
+
+static volatile sig_atomic_t signalled = 0;
+
+// the events of concurrent jobs are whole lines
+static mutex emit_lock;
+
+static double steady_seconds(void) {
+	return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void on_signal(int) {
+	signalled = 1;
+}
+
+void progress_catch_signals(void) {
+	struct sigaction action;
+	action.sa_handler = on_signal;
+	sigemptyset(&action.sa_mask);
+	// no SA_RESTART: a server blocked on stdin stops reading
+	action.sa_flags = SA_RESETHAND;
+	sigaction(SIGINT, &action, NULL);
+	sigaction(SIGTERM, &action, NULL);
+}
+
+int progress_signalled(void) {
+	return signalled;
+}
+
+void progress_set_deadline(struct progress *p, double seconds) {
+	p->deadline = seconds > 0 ? steady_seconds() + seconds : 0.0;
+}
+
+const char *progress_cancelled(const struct progress *p) {
+	if (signalled)
+		return "interrupted";
+	for (; p != NULL; p = p->parent) {
+		if (p->cancel.load(memory_order_relaxed))
+			return "cancelled";
+		if (p->deadline > 0 && steady_seconds() >= p->deadline)
+			return "deadline exceeded";
+	}
+	return NULL;
+}
+
+// the members that every event of p starts with (with p->lock held)
+static string event_head(const struct progress *p, const char *event) {
+	ostringstream line;
+	line << setprecision(9) << "{\"event\": \"" << event << "\", \"map\": " << json_string(p->map_fn);
+	return line.str();
+}
+
+static void emit(const struct progress *p, const string& line) {
+	if (!p->json)
+		return;
+	lock_guard<mutex> guard(emit_lock);
+	cerr << line << "}" << endl;
+}
+
+void progress_check(struct progress *p) {
+	const char *reason = progress_cancelled(p);
+	if (reason == NULL)
+		return;
+	if (p != NULL) {
+		lock_guard<mutex> guard(p->lock);
+		ostringstream line;
+		line << event_head(p, "cancelled") << ", \"stage\": " << json_string(p->stage) << ", \"percent\": " << max(p->percent.load(), 0)
+			<< ", \"reason\": \"" << reason << "\", \"written\": " << p->written;
+		emit(p, line.str());
+	}
+	throw cancelled_error(reason);
+}
+
+// report the current stage at percent (with p->lock held)
+static void report(struct progress *p, int percent) {
+	p->percent = percent;
+	ostringstream line;
+	line << event_head(p, "progress") << ", \"stage\": " << json_string(p->stage);
+	if (p->has_level)
+		line << ", \"clevel\": " << p->clevel;
+	line << ", \"percent\": " << percent;
+	emit(p, line.str());
+	if (p->callback)
+		p->callback(p->stage, percent);
+}
+
+void progress_stage(struct progress *p, const string& stage, const string& map_fn, int has_level, double clevel) {
+	if (p == NULL)
+		return;
+	lock_guard<mutex> guard(p->lock);
+	p->stage = stage;
+	p->map_fn = map_fn;
+	p->has_level = has_level;
+	p->clevel = clevel;
+	report(p, 0);
+}
+
+void progress_update(struct progress *p, double fraction) {
+	if (p == NULL)
+		return;
+	int percent = (int)(100.0 * min(1.0, max(0.0, fraction)));
+	// cheap when nothing changes
+	if (percent <= p->percent)
+		return;
+	lock_guard<mutex> guard(p->lock);
+	if (percent > p->percent)
+		report(p, percent);
+}
+
+void progress_written(struct progress *p, const string& fn) {
+	if (p == NULL)
+		return;
+	lock_guard<mutex> guard(p->lock);
+	p->written++;
+	emit(p, event_head(p, "written") + ", \"file\": " + json_string(fn));
+}
@@ -0,0 +1,69 @@
+/*
+ * progress
+ *
+ * Per-stage progress of a job, as JSON lines on stderr and/or a callback,
+ * and its cooperative cancellation: on request, past a deadline or on
+ * SIGINT/SIGTERM
+ *
+ * License: Apache
+ */
+
+#ifndef MESHMAKER_PROGRESS_H
+#define MESHMAKER_PROGRESS_H
+
+// standard headers
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+
+// thrown between stages once the job has been cancelled; what() is the reason
+class cancelled_error : public std::runtime_error {
+public:
+	explicit cancelled_error(const std::string& reason) : std::runtime_error(reason) {}
+};
+
+struct progress {
+	int json = 0; // no JSON lines (if = 1 then one per event on stderr)
+	std::function<void(const std::string& stage, int percent)> callback; // called for each progress event as well, if set
+	std::atomic<int> cancel{0}; // set (from any thread) to cancel the job
+	double deadline = 0.0; // none (otherwise the steady clock time in seconds at which the job is cancelled)
+	const struct progress *parent = NULL; // cancelled along with it (e.g. a job's quiet stand-in on worker threads)
+	// the stage being reported
+	std::mutex lock;
+	std::string map_fn, stage;
+	int has_level = 0;
+	double clevel = 0.0;
+	std::atomic<int> percent{-1}; // read without the lock to skip updates that change nothing
+	int written = 0; // files written so far
+};
+
+// cancel every job on the first SIGINT or SIGTERM (a second one terminates the process as usual);
+// interrupted reads, e.g. of a server's stdin, fail rather than resume
+void progress_catch_signals(void);
+
+// whether a signal has cancelled all jobs
+int progress_signalled(void);
+
+// cancel the job of p seconds from now (0 or less: no deadline)
+void progress_set_deadline(struct progress *p, double seconds);
+
+// the reason the job of p (or, if p is NULL, every job) has been cancelled, or NULL if it has not;
+// cheap enough for hot loops, which stop early once it is set and leave throwing to their caller
+const char *progress_cancelled(const struct progress *p);
+
+// throw cancelled_error (after reporting a 'cancelled' event) if the job of p has been cancelled
+void progress_check(struct progress *p);
+
+// a new stage of the job of map_fn (at clevel if has_level) at 0%; does nothing if p is NULL
+void progress_stage(struct progress *p, const std::string& stage, const std::string& map_fn, int has_level, double clevel);
+
+// fraction (0 to 1) of the current stage done; reported whenever the whole percentage grows, so it is
+// never seen to go back. Safe to call from any thread; does nothing if p is NULL
+void progress_update(struct progress *p, double fraction);
+
+// report that fn has been written (so that a cancelled job's finished files are known)
+void progress_written(struct progress *p, const std::string& fn);
+
+#endif
@@ -0,0 +1,529 @@
+/*
+ * quadric
+ *
+ * Quadric edge-collapse decimation (see quadric.h)
+ *
+ * License: Apache
+ */
+
+// standard headers
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <queue>
+
+// VTK headers
+#include "vtkCellArray.h"
+#include "vtkPointData.h"
+#include "vtkPoints.h"
+#include "vtkSMPTools.h"
+
+#include "quadric.h"
+#include "pool.h"
+
+using namespace std;
+
+// weight of the planes that keep open edges in place relative to the surface planes
+static const double BORDER_WEIGHT = 1000.0;
+// smallest cosine between a triangle's normal before and after a collapse
+static const double MIN_NORMAL_COSINE = 0.2;
+
+// quadrics are stored as the upper triangle of the symmetric 4x4 matrix: a2 ab ac ad b2 bc bd c2 cd d2
+static inline void add_plane(double *q, const double n[3], double d, double w) {
+	q[0] += w * n[0] * n[0]; q[1] += w * n[0] * n[1]; q[2] += w * n[0] * n[2]; q[3] += w * n[0] * d;
+	q[4] += w * n[1] * n[1]; q[5] += w * n[1] * n[2]; q[6] += w * n[1] * d;
+	q[7] += w * n[2] * n[2]; q[8] += w * n[2] * d;
+	q[9] += w * d * d;
+}
+
+static inline double quadric_error(const double *q, const double *v) {
+	double x = v[0], y = v[1], z = v[2];
+	return q[0] * x * x + 2 * q[1] * x * y + 2 * q[2] * x * z + 2 * q[3] * x
+		+ q[4] * y * y + 2 * q[5] * y * z + 2 * q[6] * y
+		+ q[7] * z * z + 2 * q[8] * z + q[9];
+}
+
+static inline void cross(const double a[3], const double b[3], double c[3]) {
+	c[0] = a[1] * b[2] - a[2] * b[1];
+	c[1] = a[2] * b[0] - a[0] * b[2];
+	c[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+// (unnormalised) normal of the triangle p0 p1 p2
+static inline void triangle_normal(const double *p0, const double *p1, const double *p2, double n[3]) {
+	double e1[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+	double e2[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+	cross(e1, e2, n);
+}
+
+// a candidate collapse; stale once either vertex has changed since it was queued
+struct collapse {
+	double cost;
+	uint32_t a, b;
+	uint32_t stamp_a, stamp_b;
+	bool operator>(const collapse& other) const { return cost > other.cost; }
+};
+
+namespace {
+
+class collapser {
+public:
+	collapser(vector<double>& pos, vector<uint32_t>& tris, const vector<uint8_t>& locked, int lock_border)
+		: pos(pos), tris(tris), nv(pos.size() / 3), nt(tris.size() / 3), locked(locked.begin(), locked.end()) {
+		this->locked.resize(nv, 0);
+		live_tris = nt;
+		tri_alive.assign(nt, 1);
+		vertex_alive.assign(nv, 1);
+		stamp.assign(nv, 0);
+		border.assign(nv, 0);
+		q.assign(10 * nv, 0.0);
+		build_refs();
+		build_quadrics(lock_border);
+	}
+
+	void run(size_t target, struct progress *progress) {
+		// every edge once, from its lower vertex
+		vector<uint32_t> nbrs;
+		for (uint32_t v = 0; v < nv; v++) {
+			neighbours(v, nbrs);
+			for (size_t k = 0; k < nbrs.size(); k++)
+				if (nbrs[k] > v)
+					queue_edge(v, nbrs[k]);
+		}
+		size_t goal = nt - target;
+		for (size_t pops = 0; live_tris > target && !heap.empty(); pops++) {
+			// every so often, as the clock is read
+			if (progress != NULL && pops % 4096 == 0) {
+				if (progress_cancelled(progress) != NULL)
+					break;
+				progress_update(progress, (double)(nt - live_tris) / goal);
+			}
+			collapse c = heap.top();
+			heap.pop();
+			if (!vertex_alive[c.a] || !vertex_alive[c.b] || stamp[c.a] != c.stamp_a || stamp[c.b] != c.stamp_b)
+				continue;
+			double p[3];
+			double cost;
+			if (!edge_cost(c.a, c.b, p, cost))
+				continue;
+			if (!can_collapse(c.a, c.b, p))
+				continue;
+			do_collapse(c.a, c.b, p);
+		}
+		// compact the surviving triangles
+		size_t out = 0;
+		for (size_t t = 0; t < nt; t++)
+			if (tri_alive[t]) {
+				for (int k = 0; k < 3; k++)
+					tris[3 * out + k] = tris[3 * t + k];
+				out++;
+			}
+		tris.resize(3 * out);
+	}
+
+private:
+	vector<double>& pos;
+	vector<uint32_t>& tris;
+	size_t nv, nt, live_tris;
+	vector<uint8_t> locked, tri_alive, vertex_alive, border;
+	vector<uint32_t> stamp;
+	vector<double> q;
+	// per-vertex triangle lists; a vertex that absorbs another gets a fresh list at the end
+	vector<uint32_t> refs, ref_start, ref_count;
+	priority_queue<collapse, vector<collapse>, greater<collapse> > heap;
+	// scratch lists reused by every collapse
+	vector<uint32_t> na, nb, common, merged;
+
+	void build_refs() {
+		ref_start.assign(nv + 1, 0);
+		ref_count.assign(nv, 0);
+		for (size_t i = 0; i < 3 * nt; i++)
+			ref_count[tris[i]]++;
+		for (size_t v = 0; v < nv; v++)
+			ref_start[v + 1] = ref_start[v] + ref_count[v];
+		refs.resize(3 * nt);
+		vector<uint32_t> cursor(ref_start.begin(), ref_start.end() - 1);
+		for (size_t t = 0; t < nt; t++)
+			for (int k = 0; k < 3; k++)
+				refs[cursor[tris[3 * t + k]]++] = (uint32_t)t;
+		ref_start.resize(nv);
+	}
+
+	// surface planes weighted by area plus, for open edges, a plane through the edge at right angles
+	// to its triangle so that the border stays where it is
+	void build_quadrics(int lock_border) {
+		for (size_t t = 0; t < nt; t++) {
+			const uint32_t *v = &tris[3 * t];
+			double n[3];
+			triangle_normal(&pos[3 * v[0]], &pos[3 * v[1]], &pos[3 * v[2]], n);
+			double len = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+			if (len == 0)
+				continue;
+			for (int k = 0; k < 3; k++)
+				n[k] /= len;
+			double d = -(n[0] * pos[3 * v[0]] + n[1] * pos[3 * v[0] + 1] + n[2] * pos[3 * v[0] + 2]);
+			for (int k = 0; k < 3; k++)
+				add_plane(&q[10 * v[k]], n, d, 0.5 * len);
+		}
+		vector<uint32_t> nbrs;
+		for (uint32_t v = 0; v < nv; v++) {
+			// neighbours seen once are across an open edge
+			nbrs.clear();
+			for (uint32_t r = 0; r < ref_count[v]; r++) {
+				const uint32_t *tv = &tris[3 * refs[ref_start[v] + r]];
+				for (int k = 0; k < 3; k++)
+					if (tv[k] != v)
+						nbrs.push_back(tv[k]);
+			}
+			sort(nbrs.begin(), nbrs.end());
+			for (size_t k = 0; k < nbrs.size();) {
+				size_t run = k + 1;
+				while (run < nbrs.size() && nbrs[run] == nbrs[k])
+					run++;
+				if (run - k == 1) {
+					uint32_t w = nbrs[k];
+					border[v] = border[w] = 1;
+					if (v < w)
+						add_border_plane(v, w);
+				}
+				k = run;
+			}
+		}
+		if (lock_border)
+			for (size_t v = 0; v < nv; v++)
+				if (border[v])
+					locked[v] = 1;
+	}
+
+	void add_border_plane(uint32_t v, uint32_t w) {
+		// the single triangle on edge v-w
+		for (uint32_t r = 0; r < ref_count[v]; r++) {
+			const uint32_t *tv = &tris[3 * refs[ref_start[v] + r]];
+			if (tv[0] != w && tv[1] != w && tv[2] != w)
+				continue;
+			double n[3], e[3], b[3];
+			triangle_normal(&pos[3 * tv[0]], &pos[3 * tv[1]], &pos[3 * tv[2]], n);
+			for (int k = 0; k < 3; k++)
+				e[k] = pos[3 * w + k] - pos[3 * v + k];
+			cross(e, n, b);
+			double len = sqrt(b[0] * b[0] + b[1] * b[1] + b[2] * b[2]);
+			if (len == 0)
+				return;
+			for (int k = 0; k < 3; k++)
+				b[k] /= len;
+			double d = -(b[0] * pos[3 * v] + b[1] * pos[3 * v + 1] + b[2] * pos[3 * v + 2]);
+			double w2 = BORDER_WEIGHT * (e[0] * e[0] + e[1] * e[1] + e[2] * e[2]);
+			add_plane(&q[10 * v], b, d, w2);
+			add_plane(&q[10 * w], b, d, w2);
+			return;
+		}
+	}
+
+	// distinct vertices sharing a live triangle with v
+	void neighbours(uint32_t v, vector<uint32_t>& nbrs) {
+		nbrs.clear();
+		for (uint32_t r = 0; r < ref_count[v]; r++) {
+			uint32_t t = refs[ref_start[v] + r];
+			if (!tri_alive[t])
+				continue;
+			for (int k = 0; k < 3; k++)
+				if (tris[3 * t + k] != v)
+					nbrs.push_back(tris[3 * t + k]);
+		}
+		sort(nbrs.begin(), nbrs.end());
+		nbrs.erase(unique(nbrs.begin(), nbrs.end()), nbrs.end());
+	}
+
+	// error and position of the merged vertex; false if the edge cannot move at all
+	bool edge_cost(uint32_t a, uint32_t b, double p[3], double& cost) {
+		if (locked[a] && locked[b])
+			return false;
+		double qs[10];
+		for (int k = 0; k < 10; k++)
+			qs[k] = q[10 * a + k] + q[10 * b + k];
+		const double *pa = &pos[3 * a], *pb = &pos[3 * b];
+		if (locked[a] || locked[b]) {
+			const double *keep = locked[a] ? pa : pb;
+			p[0] = keep[0]; p[1] = keep[1]; p[2] = keep[2];
+			cost = max(0.0, quadric_error(qs, p));
+			return true;
+		}
+		// the minimiser of the quadric unless it is ill-conditioned or far off the edge
+		double a11 = qs[0], a12 = qs[1], a13 = qs[2], a22 = qs[4], a23 = qs[5], a33 = qs[7];
+		double det = a11 * (a22 * a33 - a23 * a23) - a12 * (a12 * a33 - a23 * a13) + a13 * (a12 * a23 - a22 * a13);
+		double trace = a11 + a22 + a33;
+		double mid[3] = {0.5 * (pa[0] + pb[0]), 0.5 * (pa[1] + pb[1]), 0.5 * (pa[2] + pb[2])};
+		double len2 = (pa[0] - pb[0]) * (pa[0] - pb[0]) + (pa[1] - pb[1]) * (pa[1] - pb[1]) + (pa[2] - pb[2]) * (pa[2] - pb[2]);
+		if (fabs(det) > 1e-9 * trace * trace * trace && trace > 0) {
+			double b1 = -qs[3], b2 = -qs[6], b3 = -qs[8];
+			double x[3];
+			x[0] = (b1 * (a22 * a33 - a23 * a23) - a12 * (b2 * a33 - a23 * b3) + a13 * (b2 * a23 - a22 * b3)) / det;
+			x[1] = (a11 * (b2 * a33 - a23 * b3) - b1 * (a12 * a33 - a23 * a13) + a13 * (a12 * b3 - b2 * a13)) / det;
+			x[2] = (a11 * (a22 * b3 - b2 * a23) - a12 * (a12 * b3 - b2 * a13) + b1 * (a12 * a23 - a22 * a13)) / det;
+			double off2 = (x[0] - mid[0]) * (x[0] - mid[0]) + (x[1] - mid[1]) * (x[1] - mid[1]) + (x[2] - mid[2]) * (x[2] - mid[2]);
+			if (off2 <= len2) {
+				p[0] = x[0]; p[1] = x[1]; p[2] = x[2];
+				cost = max(0.0, quadric_error(qs, p));
+				return true;
+			}
+		}
+		// otherwise the best of the end points and the midpoint
+		const double *candidates[3] = {pa, pb, mid};
+		cost = -1;
+		for (int c = 0; c < 3; c++) {
+			double e = quadric_error(qs, candidates[c]);
+			if (cost < 0 || e < cost) {
+				cost = e;
+				p[0] = candidates[c][0]; p[1] = candidates[c][1]; p[2] = candidates[c][2];
+			}
+		}
+		cost = max(0.0, cost);
+		return true;
+	}
+
+	void queue_edge(uint32_t a, uint32_t b) {
+		double p[3];
+		collapse c;
+		if (!edge_cost(a, b, p, c.cost))
+			return;
+		c.a = a;
+		c.b = b;
+		c.stamp_a = stamp[a];
+		c.stamp_b = stamp[b];
+		heap.push(c);
+	}
+
+	// the link condition keeps the surface manifold and no triangle may fold over
+	bool can_collapse(uint32_t a, uint32_t b, const double p[3]) {
+		neighbours(a, na);
+		neighbours(b, nb);
+		common.clear();
+		set_intersection(na.begin(), na.end(), nb.begin(), nb.end(), back_inserter(common));
+		size_t shared = 0;
+		for (uint32_t r = 0; r < ref_count[a]; r++) {
+			uint32_t t = refs[ref_start[a] + r];
+			if (tri_alive[t] && (tris[3 * t] == b || tris[3 * t + 1] == b || tris[3 * t + 2] == b))
+				shared++;
+		}
+		if (shared == 0 || common.size() != shared)
+			return false;
+		// an interior edge between two border vertices would pinch the surface
+		if (shared == 2 && border[a] && border[b])
+			return false;
+		uint32_t ends[2] = {a, b};
+		for (int e = 0; e < 2; e++) {
+			uint32_t v = ends[e];
+			for (uint32_t r = 0; r < ref_count[v]; r++) {
+				uint32_t t = refs[ref_start[v] + r];
+				if (!tri_alive[t])
+					continue;
+				const uint32_t *tv = &tris[3 * t];
+				if (tv[0] == ends[1 - e] || tv[1] == ends[1 - e] || tv[2] == ends[1 - e])
+					continue;
+				const double *corner[3];
+				for (int k = 0; k < 3; k++)
+					corner[k] = &pos[3 * tv[k]];
+				double before[3], after[3];
+				triangle_normal(corner[0], corner[1], corner[2], before);
+				for (int k = 0; k < 3; k++)
+					if (tv[k] == v)
+						corner[k] = p;
+				triangle_normal(corner[0], corner[1], corner[2], after);
+				double lb = sqrt(before[0] * before[0] + before[1] * before[1] + before[2] * before[2]);
+				double la = sqrt(after[0] * after[0] + after[1] * after[1] + after[2] * after[2]);
+				if (la == 0)
+					return false;
+				if (lb > 0 && (before[0] * after[0] + before[1] * after[1] + before[2] * after[2]) < MIN_NORMAL_COSINE * la * lb)
+					return false;
+			}
+		}
+		return true;
+	}
+
+	void do_collapse(uint32_t a, uint32_t b, const double p[3]) {
+		// a locked vertex always survives
+		uint32_t s = locked[b] ? b : a, r = locked[b] ? a : b;
+		for (int k = 0; k < 3; k++)
+			pos[3 * s + k] = p[k];
+		for (int k = 0; k < 10; k++)
+			q[10 * s + k] += q[10 * r + k];
+		border[s] |= border[r];
+
+		// triangles on the edge go, the rest of r's now use s
+		merged.clear();
+		for (uint32_t i = 0; i < ref_count[r]; i++) {
+			uint32_t t = refs[ref_start[r] + i];
+			if (!tri_alive[t])
+				continue;
+			uint32_t *tv = &tris[3 * t];
+			if (tv[0] == s || tv[1] == s || tv[2] == s) {
+				tri_alive[t] = 0;
+				live_tris--;
+				continue;
+			}
+			for (int k = 0; k < 3; k++)
+				if (tv[k] == r)
+					tv[k] = s;
+			merged.push_back(t);
+		}
+		for (uint32_t i = 0; i < ref_count[s]; i++) {
+			uint32_t t = refs[ref_start[s] + i];
+			if (tri_alive[t])
+				merged.push_back(t);
+		}
+		ref_start[s] = (uint32_t)refs.size();
+		ref_count[s] = (uint32_t)merged.size();
+		refs.insert(refs.end(), merged.begin(), merged.end());
+		ref_count[r] = 0;
+		vertex_alive[r] = 0;
+		stamp[s]++;
+		stamp[r]++;
+
+		neighbours(s, na);
+		for (size_t k = 0; k < na.size(); k++)
+			queue_edge(s, na[k]);
+	}
+};
+
+}
+
+void quadric_collapse(vector<double>& pos, vector<uint32_t>& tris, const vector<uint8_t>& locked, size_t target, int lock_border,
+		struct progress *progress) {
+	if (tris.size() / 3 <= target)
+		return;
+	collapser c(pos, tris, locked, lock_border);
+	c.run(target, progress);
+}
+
+// the vertices used by tris renumbered from 0 (ids[local] is the original id)
+static void compact(const vector<double>& pos, vector<uint32_t>& tris, vector<uint32_t>& ids, vector<double>& local_pos) {
+	ids.assign(tris.begin(), tris.end());
+	sort(ids.begin(), ids.end());
+	ids.erase(unique(ids.begin(), ids.end()), ids.end());
+	for (size_t i = 0; i < tris.size(); i++)
+		tris[i] = (uint32_t)(lower_bound(ids.begin(), ids.end(), tris[i]) - ids.begin());
+	local_pos.resize(3 * ids.size());
+	for (size_t v = 0; v < ids.size(); v++)
+		for (int k = 0; k < 3; k++)
+			local_pos[3 * v + k] = pos[3 * ids[v] + k];
+}
+
+vtkSmartPointer<vtkPolyData> quadric_decimate(vtkPolyData *mesh, double target_reduction, int fix_boundary, int partitions,
+		struct progress *progress) {
+	vtkIdType npts = mesh->GetNumberOfPoints();
+	vtkPoints *in_points = mesh->GetPoints();
+	vector<double> pos(3 * npts);
+	auto load = [&](vtkIdType first, vtkIdType last) {
+		for (vtkIdType v = first; v < last; v++)
+			in_points->GetPoint(v, &pos[3 * v]);
+	};
+	vtkSMPTools::For(0, npts, load);
+
+	vector<uint32_t> tris;
+	tris.reserve(3 * mesh->GetNumberOfPolys());
+	vtkIdType n;
+	const vtkIdType *pts;
+	vtkCellArray *polys = mesh->GetPolys();
+	for (polys->InitTraversal(); polys->GetNextCell(n, pts);)
+		if (n == 3)
+			for (int k = 0; k < 3; k++)
+				tris.push_back((uint32_t)pts[k]);
+	size_t nt = tris.size() / 3;
+	size_t target = (size_t)(nt * (1.0 - target_reduction));
+	// slabs of fewer than 65536 triangles are not worth it; slab ids are bytes
+	partitions = min(partitions, min((int)(nt / 65536), 255));
+
+	if (partitions > 1) {
+		// slabs with equal numbers of triangles (by centroid) along the longest axis
+		double bounds[6];
+		mesh->GetBounds(bounds);
+		int axis = 0;
+		for (int a = 1; a < 3; a++)
+			if (bounds[2 * a + 1] - bounds[2 * a] > bounds[2 * axis + 1] - bounds[2 * axis])
+				axis = a;
+		vector<double> centroid(nt);
+		for (size_t t = 0; t < nt; t++)
+			centroid[t] = pos[3 * tris[3 * t] + axis] + pos[3 * tris[3 * t + 1] + axis] + pos[3 * tris[3 * t + 2] + axis];
+		vector<double> sorted(centroid);
+		vector<double> cuts(partitions - 1);
+		for (int p = 1; p < partitions; p++) {
+			size_t k = nt * p / partitions;
+			nth_element(sorted.begin(), sorted.begin() + k, sorted.end());
+			cuts[p - 1] = sorted[k];
+		}
+		vector<uint8_t> part(nt);
+		for (size_t t = 0; t < nt; t++)
+			part[t] = (uint8_t)(upper_bound(cuts.begin(), cuts.end(), centroid[t]) - cuts.begin());
+
+		// vertices on triangles of more than one slab are locked while the slabs are decimated
+		vector<int> owner(npts, -1);
+		vector<uint8_t> shared(npts, 0);
+		for (size_t t = 0; t < nt; t++)
+			for (int k = 0; k < 3; k++) {
+				uint32_t v = tris[3 * t + k];
+				if (owner[v] < 0)
+					owner[v] = part[t];
+				else if (owner[v] != part[t])
+					shared[v] = 1;
+			}
+		vector<vector<uint32_t> > part_tris(partitions);
+		for (size_t t = 0; t < nt; t++)
+			part_tris[part[t]].insert(part_tris[part[t]].end(), &tris[3 * t], &tris[3 * t] + 3);
+
+		// slabs only move and remove the vertices they own, so they can write to pos concurrently
+		auto work = [&](vtkIdType first, vtkIdType last) {
+			for (vtkIdType p = first; p < last; p++) {
+				vector<uint32_t>& local_tris = part_tris[p];
+				vector<uint32_t> ids;
+				vector<double> local_pos;
+				compact(pos, local_tris, ids, local_pos);
+				vector<uint8_t> locked(ids.size());
+				for (size_t v = 0; v < ids.size(); v++)
+					locked[v] = shared[ids[v]];
+				quadric_collapse(local_pos, local_tris, locked, (size_t)(local_tris.size() / 3 * (1.0 - target_reduction)), 1, progress);
+				for (size_t v = 0; v < ids.size(); v++)
+					if (!locked[v])
+						for (int k = 0; k < 3; k++)
+							pos[3 * ids[v] + k] = local_pos[3 * v + k];
+				for (size_t i = 0; i < local_tris.size(); i++)
+					local_tris[i] = ids[local_tris[i]];
+			}
+		};
+		vtkSMPTools::For(0, partitions, 1, work);
+		tris.clear();
+		for (int p = 0; p < partitions; p++) {
+			tris.insert(tris.end(), part_tris[p].begin(), part_tris[p].end());
+			vector<uint32_t>().swap(part_tris[p]);
+		}
+	}
+
+	// the whole (remaining) mesh, seams included
+	vector<uint32_t> ids;
+	vector<double> local_pos;
+	compact(pos, tris, ids, local_pos);
+	vector<double>().swap(pos);
+	quadric_collapse(local_pos, tris, vector<uint8_t>(ids.size(), 0), target, fix_boundary, progress);
+
+	// surviving points keep their point data
+	vector<vtkIdType> new_id(ids.size(), -1);
+	vector<uint32_t> kept;
+	for (size_t i = 0; i < tris.size(); i++)
+		if (new_id[tris[i]] < 0) {
+			new_id[tris[i]] = (vtkIdType)kept.size();
+			kept.push_back(tris[i]);
+		}
+	vtkSmartPointer<vtkPoints> out_points = pool_points(in_points->GetDataType(), kept.size());
+	vtkSmartPointer<vtkPolyData> output = vtkSmartPointer<vtkPolyData>::New();
+	output->GetPointData()->CopyAllocate(mesh->GetPointData(), kept.size());
+	for (size_t v = 0; v < kept.size(); v++) {
+		out_points->SetPoint(v, &local_pos[3 * kept[v]]);
+		output->GetPointData()->CopyData(mesh->GetPointData(), ids[kept[v]], v);
+	}
+	vtkTypeInt64 *conn;
+	vtkSmartPointer<vtkCellArray> out_polys = pool_triangles(tris.size() / 3, conn);
+	for (size_t i = 0; i < tris.size(); i++)
+		conn[i] = new_id[tris[i]];
+	output->SetPoints(out_points);
+	output->SetPolys(out_polys);
+	return output;
+}
@@ -0,0 +1,41 @@
+/*
+ * quadric
+ *
+ * Heap-based quadric edge-collapse decimation (Garland & Heckbert) of
+ * triangle meshes, optionally run on spatial partitions concurrently
+ *
+ * License: Apache
+ */
+
+#ifndef MESHMAKER_QUADRIC_H
+#define MESHMAKER_QUADRIC_H
+
+// standard headers
+#include <cstdint>
+#include <vector>
+
+// VTK headers
+#include "vtkSmartPointer.h"
+#include "vtkPolyData.h"
+
+#include "progress.h"
+
+// collapse edges of the triangles (3 vertex indices each) into pos (x, y, z per vertex) in order
+// of increasing quadric error until at most target triangles are left; vertices flagged in locked
+// neither move nor go away, and with lock_border neither do vertices on open edges (otherwise
+// open edges are only constrained). Collapses that would make the surface non-manifold or fold
+// a triangle over are skipped. On return tris holds the surviving triangles. The share of the
+// collapses done is reported to progress, and collapsing stops early once its job is cancelled.
+void quadric_collapse(std::vector<double>& pos, std::vector<uint32_t>& tris, const std::vector<uint8_t>& locked, size_t target, int lock_border,
+		struct progress *progress = NULL);
+
+// decimate the triangles of mesh by target_reduction (in (0, 1)); with partitions > 1 the mesh is
+// first cut into that many slabs along its longest axis that are decimated concurrently with
+// their shared vertices locked, and the result then decimated as a whole to the target. With
+// fix_boundary, vertices on open edges are kept as they are (as for bricks). Point data of the
+// surviving points is kept; point ids must fit in 32 bits. Progress and cancellation as for
+// quadric_collapse() (the slabs stop early too).
+vtkSmartPointer<vtkPolyData> quadric_decimate(vtkPolyData *mesh, double target_reduction, int fix_boundary, int partitions,
+		struct progress *progress = NULL);
+
+#endif
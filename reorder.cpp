@@ -0,0 +1,205 @@
+/*
+ * reorder
+ *
+ * Tipsify and first-use renumbering (see reorder.h)
+ *
+ * License: Apache
+ */
+
+// standard headers
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// VTK headers
+#include "vtkCellArray.h"
+#include "vtkCellData.h"
+#include "vtkPointData.h"
+#include "vtkPoints.h"
+#include "vtkSMPTools.h"
+
+#include "reorder.h"
+#include "pool.h"
+
+using namespace std;
+
+// the bits of v (10 of them) spread out to every third bit
+static uint32_t spread_bits(uint32_t v) {
+	v &= 0x3ff;
+	v = (v | (v << 16)) & 0x30000ff;
+	v = (v | (v << 8)) & 0x300f00f;
+	v = (v | (v << 4)) & 0x30c30c3;
+	v = (v | (v << 2)) & 0x9249249;
+	return v;
+}
+
+vector<vtkIdType> tipsify(const vector<vtkIdType>& tris, vtkIdType npts, int cache_size) {
+	vtkIdType ntris = tris.size() / 3;
+	// triangles of each vertex (CSR)
+	pool_vector<vtkIdType> first(npts + 1, 0), adjacent(tris.size());
+	for (size_t k = 0; k < tris.size(); k++)
+		first[tris[k] + 1]++;
+	for (vtkIdType v = 0; v < npts; v++)
+		first[v + 1] += first[v];
+	pool_vector<vtkIdType> fill(first.begin(), first.end() - 1);
+	for (size_t k = 0; k < tris.size(); k++)
+		adjacent[fill[tris[k]]++] = k / 3;
+
+	pool_vector<int> live(npts);
+	for (vtkIdType v = 0; v < npts; v++)
+		live[v] = (int)(first[v + 1] - first[v]);
+	pool_vector<long long> cache_time(npts, 0);
+	pool_vector<unsigned char> emitted(ntris, 0);
+	vector<vtkIdType> dead_end, order, candidates;
+	order.reserve(ntris);
+	long long time = cache_size + 1;
+	vtkIdType cursor = 0; // the next triangle in input order to restart from
+
+	vtkIdType fan = ntris > 0 ? tris[0] : -1;
+	while (fan >= 0) {
+		// emit all the triangles around the fanning vertex
+		candidates.clear();
+		for (vtkIdType a = first[fan]; a < first[fan + 1]; a++) {
+			vtkIdType t = adjacent[a];
+			if (emitted[t])
+				continue;
+			emitted[t] = 1;
+			order.push_back(t);
+			for (int k = 0; k < 3; k++) {
+				vtkIdType v = tris[3 * t + k];
+				dead_end.push_back(v);
+				candidates.push_back(v);
+				live[v]--;
+				// a vertex not in the cache enters it
+				if (time - cache_time[v] > cache_size)
+					cache_time[v] = time++;
+			}
+		}
+
+		// the next fan is the candidate that will still be in the cache longest while it has
+		// triangles left
+		vtkIdType next = -1;
+		long long best = -1;
+		for (size_t c = 0; c < candidates.size(); c++) {
+			vtkIdType v = candidates[c];
+			if (live[v] <= 0)
+				continue;
+			long long priority = 0;
+			if (time - cache_time[v] + 2 * live[v] <= cache_size)
+				priority = time - cache_time[v];
+			if (priority > best) {
+				best = priority;
+				next = v;
+			}
+		}
+		// otherwise a recently used vertex with triangles left, otherwise the next unemitted triangle
+		while (next < 0 && !dead_end.empty()) {
+			vtkIdType v = dead_end.back();
+			dead_end.pop_back();
+			if (live[v] > 0)
+				next = v;
+		}
+		while (next < 0 && cursor < ntris) {
+			if (!emitted[cursor])
+				next = tris[3 * cursor];
+			else
+				cursor++;
+		}
+		fan = next;
+	}
+	return order;
+}
+
+vtkSmartPointer<vtkPolyData> reorder_mesh(vtkPolyData *mesh, int cache_size, int morton) {
+	vtkIdType npts = mesh->GetNumberOfPoints();
+	vtkCellArray *polys = mesh->GetPolys();
+	vtkIdType ntris = polys->GetNumberOfCells();
+	vector<vtkIdType> tris;
+	tris.reserve(3 * ntris);
+	vtkIdType n;
+	const vtkIdType *pts;
+	for (polys->InitTraversal(); polys->GetNextCell(n, pts);)
+		tris.insert(tris.end(), pts, pts + 3);
+
+	// sort along a Morton curve over the bounding box (10 bits per axis) to start from; ties keep
+	// their input order
+	pool_vector<vtkIdType> input_order(ntris);
+	for (vtkIdType t = 0; t < ntris; t++)
+		input_order[t] = t;
+	if (morton && ntris > 0) {
+		double bounds[6];
+		mesh->GetPoints()->GetBounds(bounds);
+		pool_vector<pair<uint32_t, vtkIdType> > codes(ntris);
+		auto encode = [&](vtkIdType first, vtkIdType last) {
+			double x[3][3];
+			for (vtkIdType t = first; t < last; t++) {
+				uint32_t code = 0;
+				for (int k = 0; k < 3; k++)
+					mesh->GetPoints()->GetPoint(tris[3 * t + k], x[k]);
+				for (int a = 0; a < 3; a++) {
+					double extent = bounds[2 * a + 1] - bounds[2 * a];
+					double centre = (x[0][a] + x[1][a] + x[2][a]) / 3.0;
+					uint32_t cell = extent > 0 ? (uint32_t)min(1023.0, max(0.0, (centre - bounds[2 * a]) / extent * 1024.0)) : 0;
+					code |= spread_bits(cell) << a;
+				}
+				codes[t] = make_pair(code, t);
+			}
+		};
+		vtkSMPTools::For(0, ntris, encode);
+		vtkSMPTools::Sort(codes.begin(), codes.end());
+		vector<vtkIdType> sorted(3 * ntris);
+		for (vtkIdType t = 0; t < ntris; t++) {
+			input_order[t] = codes[t].second;
+			for (int k = 0; k < 3; k++)
+				sorted[3 * t + k] = tris[3 * codes[t].second + k];
+		}
+		tris.swap(sorted);
+	}
+
+	vector<vtkIdType> order = tipsify(tris, npts, cache_size);
+
+	// vertices in order of first use; unused vertices go last
+	pool_vector<vtkIdType> new_id(npts, -1), old_id;
+	old_id.reserve(npts);
+	vtkTypeInt64 *conn;
+	vtkSmartPointer<vtkCellArray> out_polys = pool_triangles(order.size(), conn);
+	for (size_t o = 0; o < order.size(); o++)
+		for (int k = 0; k < 3; k++) {
+			vtkIdType v = tris[3 * order[o] + k];
+			if (new_id[v] < 0) {
+				new_id[v] = old_id.size();
+				old_id.push_back(v);
+			}
+			conn[3 * o + k] = new_id[v];
+		}
+	for (vtkIdType v = 0; v < npts; v++)
+		if (new_id[v] < 0) {
+			new_id[v] = old_id.size();
+			old_id.push_back(v);
+		}
+
+	vtkSmartPointer<vtkPolyData> output = vtkSmartPointer<vtkPolyData>::New();
+	vtkSmartPointer<vtkPoints> points = pool_points(mesh->GetPoints()->GetDataType(), npts);
+	vtkPoints *in_points = mesh->GetPoints();
+	auto move = [&](vtkIdType first, vtkIdType last) {
+		double x[3];
+		for (vtkIdType p = first; p < last; p++) {
+			in_points->GetPoint(old_id[p], x);
+			points->SetPoint(p, x);
+		}
+	};
+	vtkSMPTools::For(0, npts, move);
+	output->SetPoints(points);
+	output->SetPolys(out_polys);
+	output->GetFieldData()->PassData(mesh->GetFieldData());
+	output->GetPointData()->CopyAllocate(mesh->GetPointData(), npts);
+	for (vtkIdType p = 0; p < npts; p++)
+		output->GetPointData()->CopyData(mesh->GetPointData(), old_id[p], p);
+	if (mesh->GetCellData()->GetNumberOfArrays() > 0) {
+		output->GetCellData()->CopyAllocate(mesh->GetCellData(), ntris);
+		for (size_t o = 0; o < order.size(); o++)
+			output->GetCellData()->CopyData(mesh->GetCellData(), input_order[order[o]], o);
+	}
+	return output;
+}
@@ -0,0 +1,31 @@
+/*
+ * reorder
+ *
+ * Vertex-cache optimisation of triangle meshes: triangles are reordered
+ * with Tipsify (Sander, Nehab & Barczak 2007), optionally after a sort
+ * along a Morton curve, and vertices renumbered in order of first use
+ *
+ * License: Apache
+ */
+
+#ifndef MESHMAKER_REORDER_H
+#define MESHMAKER_REORDER_H
+
+// standard headers
+#include <vector>
+
+// VTK headers
+#include "vtkSmartPointer.h"
+#include "vtkPolyData.h"
+
+// the order in which to emit the triangles (3 vertex ids each) of a mesh of npts vertices so that a
+// FIFO vertex cache of cache_size entries misses rarely; restarts follow the input order
+std::vector<vtkIdType> tipsify(const std::vector<vtkIdType>& tris, vtkIdType npts, int cache_size);
+
+// the triangles of mesh (a triangle mesh) reordered for a vertex cache of cache_size entries and its
+// points (and point data) renumbered in order of first use; with morton the triangles are first
+// sorted along a Morton curve through their centroids so that the order is also spatially coherent.
+// Cell data follows the triangles; points on no triangle go last
+vtkSmartPointer<vtkPolyData> reorder_mesh(vtkPolyData *mesh, int cache_size, int morton);
+
+#endif
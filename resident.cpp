@@ -0,0 +1,125 @@
+/*
+ * resident
+ *
+ * In-memory LRU cache of maps (see resident.h)
+ *
+ * License: Apache
+ */
+
+// standard headers
+#include <sstream>
+
+// VTK headers
+#include "vtkDataArray.h"
+#include "vtkPointData.h"
+
+// POSIX headers
+#include <sys/stat.h>
+
+#include "resident.h"
+
+using namespace std;
+
+// a file that has been replaced gets a new key
+static string file_key(const string& fn) {
+	struct stat st;
+	if (stat(fn.c_str(), &st) != 0)
+		return "";
+	ostringstream key;
+	key << fn << "\n" << st.st_size << "\n" << st.st_mtime;
+	return key.str();
+}
+
+// drop the least recently used entries (but the most recent) until the cache fits again
+static void evict(struct resident_cache& cache) {
+	while (cache.bytes > cache.capacity && cache.entries.size() > 1) {
+		cache.bytes -= cache.entries.back().bytes;
+		cache.entries.pop_back();
+	}
+}
+
+// an image of the same structure whose scalars share the voxels of image (but not its array object)
+static vtkSmartPointer<vtkImageData> view(vtkImageData *image) {
+	vtkSmartPointer<vtkImageData> v = vtkSmartPointer<vtkImageData>::New();
+	v->CopyStructure(image);
+	vtkDataArray *scalars = image->GetPointData()->GetScalars();
+	if (scalars != NULL) {
+		vtkSmartPointer<vtkDataArray> shared;
+		shared.TakeReference(scalars->NewInstance());
+		shared->ShallowCopy(scalars);
+		v->GetPointData()->SetScalars(shared);
+	}
+	return v;
+}
+
+// whether image is a view of entry
+static int views(const struct resident_entry& entry, vtkImageData *image) {
+	return entry.image->GetScalarPointer() == image->GetScalarPointer();
+}
+
+vtkSmartPointer<vtkImageData> resident_image(struct resident_cache& cache, const string& fn) {
+	string key = file_key(fn);
+	lock_guard<mutex> guard(cache.lock);
+	for (list<struct resident_entry>::iterator e = cache.entries.begin(); e != cache.entries.end(); ++e) {
+		if (e->key.compare(key) != 0)
+			continue;
+		cache.entries.splice(cache.entries.begin(), cache.entries, e);
+		return view(cache.entries.front().image);
+	}
+	return NULL;
+}
+
+vtkSmartPointer<vtkImageData> resident_add_image(struct resident_cache& cache, const string& fn, vtkSmartPointer<vtkImageData> image) {
+	string key = file_key(fn);
+	if (key.empty() || cache.capacity == 0)
+		return image;
+	// the image is only read from now on
+	image->GetScalarRange();
+	image->GetScalarPointer();
+	struct resident_entry entry;
+	entry.key = key;
+	entry.image = image;
+	entry.bytes = (size_t)image->GetActualMemorySize() * 1024;
+	lock_guard<mutex> guard(cache.lock);
+	// another job may have read the same map meanwhile
+	for (list<struct resident_entry>::iterator e = cache.entries.begin(); e != cache.entries.end(); ++e)
+		if (e->key.compare(key) == 0) {
+			cache.bytes -= e->bytes;
+			cache.entries.erase(e);
+			break;
+		}
+	cache.entries.push_front(entry);
+	cache.bytes += entry.bytes;
+	evict(cache);
+	return view(image);
+}
+
+shared_ptr<const struct volume_ranges> resident_ranges(struct resident_cache& cache, vtkImageData *image, int block) {
+	lock_guard<mutex> guard(cache.lock);
+	for (list<struct resident_entry>::iterator e = cache.entries.begin(); e != cache.entries.end(); ++e) {
+		if (!views(*e, image))
+			continue;
+		for (size_t r = 0; r < e->ranges.size(); r++)
+			if (e->ranges[r]->block == block)
+				return e->ranges[r];
+		break;
+	}
+	return shared_ptr<const struct volume_ranges>();
+}
+
+void resident_add_ranges(struct resident_cache& cache, vtkImageData *image, shared_ptr<const struct volume_ranges> ranges) {
+	lock_guard<mutex> guard(cache.lock);
+	for (list<struct resident_entry>::iterator e = cache.entries.begin(); e != cache.entries.end(); ++e) {
+		if (!views(*e, image))
+			continue;
+		for (size_t r = 0; r < e->ranges.size(); r++)
+			if (e->ranges[r]->block == ranges->block)
+				return;
+		e->ranges.push_back(ranges);
+		size_t size = (ranges->lo.size() + ranges->hi.size()) * sizeof(float);
+		e->bytes += size;
+		cache.bytes += size;
+		evict(cache);
+		return;
+	}
+}
@@ -0,0 +1,57 @@
+/*
+ * resident
+ *
+ * LRU cache of maps kept in memory between the jobs of a server, together
+ * with the min/max block grids built over them
+ *
+ * License: Apache
+ */
+
+#ifndef MESHMAKER_RESIDENT_H
+#define MESHMAKER_RESIDENT_H
+
+// standard headers
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// VTK headers
+#include "vtkSmartPointer.h"
+#include "vtkImageData.h"
+
+#include "volume.h"
+
+struct resident_entry {
+	std::string key; // file name, size and modification time
+	vtkSmartPointer<vtkImageData> image; // never modified or handed to a pipeline once cached (jobs get views)
+	std::vector<std::shared_ptr<const struct volume_ranges> > ranges; // one per block size
+	size_t bytes = 0;
+};
+
+struct resident_cache {
+	size_t capacity = 0; // bytes
+	size_t bytes = 0;
+	std::list<struct resident_entry> entries; // most recently used first
+	std::mutex lock;
+};
+
+// a view of the cached image of map fn for one job (NULL if it is not cached or has changed on disk).
+// Views share the voxels, which must not be modified, but each has its own image and scalar array
+// (and so its own pipeline information and cached range), so that jobs can use them concurrently
+vtkSmartPointer<vtkImageData> resident_image(struct resident_cache& cache, const std::string& fn);
+
+// cache image as read from map fn, dropping the least recently used maps beyond the capacity; image is
+// not to be used again: the view returned is (image itself if it is not cached)
+vtkSmartPointer<vtkImageData> resident_add_image(struct resident_cache& cache, const std::string& fn, vtkSmartPointer<vtkImageData> image);
+
+// the min/max grid with blocks of block voxels built over the whole of a cached image (NULL if none);
+// image is any view of it
+std::shared_ptr<const struct volume_ranges> resident_ranges(struct resident_cache& cache, vtkImageData *image, int block);
+
+// keep ranges with the cached image they were built over, given by a view (ignored if it is no longer cached)
+void resident_add_ranges(struct resident_cache& cache, vtkImageData *image, std::shared_ptr<const struct volume_ranges> ranges);
+
+#endif
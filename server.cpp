@@ -0,0 +1,396 @@
+/*
+ * server
+ *
+ * JSON-lines request loop and worker pool (see server.h)
+ *
+ * License: Apache
+ */
+
+// standard headers
+#include <cctype>
+#include <condition_variable>
+#include <cstdlib>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+#include "profile.h"
+#include "server.h"
+
+using namespace std;
+
+// a recursive-descent reader for the little JSON a request needs
+struct json_reader {
+	const string& s;
+	size_t p;
+	string error;
+
+	json_reader(const string& text) : s(text), p(0) {}
+
+	void skip_space(void) {
+		while (p < s.size() && (s[p] == ' ' || s[p] == '\t' || s[p] == '\r' || s[p] == '\n'))
+			p++;
+	}
+
+	int expect(char c) {
+		skip_space();
+		if (p >= s.size() || s[p] != c) {
+			ostringstream e;
+			e << "expected '" << c << "' at offset " << p;
+			error = e.str();
+			return -1;
+		}
+		p++;
+		return 0;
+	}
+
+	// the 4 hex digits of a \u escape
+	int read_hex4(unsigned long& u) {
+		if (p + 4 > s.size()) {
+			error = "truncated \\u escape";
+			return -1;
+		}
+		for (size_t k = p; k < p + 4; k++)
+			if (!isxdigit((unsigned char)s[k])) {
+				error = "invalid \\u escape";
+				return -1;
+			}
+		u = strtoul(s.substr(p, 4).c_str(), NULL, 16);
+		p += 4;
+		return 0;
+	}
+
+	// a string, with its escapes decoded (\u escapes, including surrogate pairs, are written as UTF-8)
+	int read_string(string& out) {
+		if (expect('"') != 0)
+			return -1;
+		out.clear();
+		while (p < s.size() && s[p] != '"') {
+			char c = s[p++];
+			if (c != '\\') {
+				out += c;
+				continue;
+			}
+			if (p >= s.size())
+				break;
+			char e = s[p++];
+			switch (e) {
+				case 'b': out += '\b'; break;
+				case 'f': out += '\f'; break;
+				case 'n': out += '\n'; break;
+				case 'r': out += '\r'; break;
+				case 't': out += '\t'; break;
+				case 'u': {
+					unsigned long u;
+					if (read_hex4(u) != 0)
+						return -1;
+					// characters beyond the BMP come as a high and a low surrogate
+					if (u >= 0xdc00 && u <= 0xdfff) {
+						error = "unpaired low surrogate";
+						return -1;
+					}
+					if (u >= 0xd800 && u <= 0xdbff) {
+						unsigned long low;
+						if (p + 2 > s.size() || s[p] != '\\' || s[p + 1] != 'u') {
+							error = "unpaired high surrogate";
+							return -1;
+						}
+						p += 2;
+						if (read_hex4(low) != 0)
+							return -1;
+						if (low < 0xdc00 || low > 0xdfff) {
+							error = "unpaired high surrogate";
+							return -1;
+						}
+						u = 0x10000 + ((u - 0xd800) << 10) + (low - 0xdc00);
+					}
+					if (u < 0x80)
+						out += (char)u;
+					else if (u < 0x800) {
+						out += (char)(0xc0 | (u >> 6));
+						out += (char)(0x80 | (u & 0x3f));
+					}
+					else if (u < 0x10000) {
+						out += (char)(0xe0 | (u >> 12));
+						out += (char)(0x80 | ((u >> 6) & 0x3f));
+						out += (char)(0x80 | (u & 0x3f));
+					}
+					else {
+						out += (char)(0xf0 | (u >> 18));
+						out += (char)(0x80 | ((u >> 12) & 0x3f));
+						out += (char)(0x80 | ((u >> 6) & 0x3f));
+						out += (char)(0x80 | (u & 0x3f));
+					}
+					break;
+				}
+				default: out += e; break;
+			}
+		}
+		if (p >= s.size()) {
+			error = "unterminated string";
+			return -1;
+		}
+		p++;
+		return 0;
+	}
+
+	// a number as JSON has it (-?int[.frac][e[+-]exp]), re-encoded: integers as such, others to 17 digits
+	int read_number(string& text) {
+		skip_space();
+		size_t start = p;
+		if (p < s.size() && s[p] == '-')
+			p++;
+		size_t digits = p;
+		while (p < s.size() && isdigit((unsigned char)s[p]))
+			p++;
+		int valid = p > digits && !(s[digits] == '0' && p - digits > 1), integral = 1;
+		if (valid && p < s.size() && s[p] == '.') {
+			integral = 0;
+			size_t frac = ++p;
+			while (p < s.size() && isdigit((unsigned char)s[p]))
+				p++;
+			valid = p > frac;
+		}
+		if (valid && p < s.size() && (s[p] == 'e' || s[p] == 'E')) {
+			integral = 0;
+			p++;
+			if (p < s.size() && (s[p] == '+' || s[p] == '-'))
+				p++;
+			size_t exp = p;
+			while (p < s.size() && isdigit((unsigned char)s[p]))
+				p++;
+			valid = p > exp;
+		}
+		if (!valid) {
+			ostringstream e;
+			e << "invalid number at offset " << start;
+			error = e.str();
+			return -1;
+		}
+		string number = s.substr(start, p - start);
+		ostringstream out;
+		errno = 0;
+		long long n = integral ? strtoll(number.c_str(), NULL, 10) : 0;
+		if (integral && errno == 0)
+			out << n;
+		else
+			out << setprecision(17) << strtod(number.c_str(), NULL);
+		text = out.str();
+		return 0;
+	}
+
+	// a request id: a string, a number or null, re-encoded as JSON
+	int read_id(string& text) {
+		skip_space();
+		if (p < s.size() && s[p] == '"') {
+			string id;
+			if (read_string(id) != 0)
+				return -1;
+			text = json_string(id);
+			return 0;
+		}
+		if (s.compare(p, 4, "null") == 0) {
+			p += 4;
+			text = "null";
+			return 0;
+		}
+		if (p < s.size() && (s[p] == '-' || isdigit((unsigned char)s[p])))
+			return read_number(text);
+		error = "id must be a string, a number or null";
+		return -1;
+	}
+
+	// any value, kept as its JSON text (nested containers are skipped over)
+	int read_value(string& text) {
+		skip_space();
+		size_t start = p;
+		if (p < s.size() && s[p] == '"') {
+			string ignored;
+			if (read_string(ignored) != 0)
+				return -1;
+		}
+		else if (p < s.size() && (s[p] == '{' || s[p] == '[')) {
+			int depth = 0;
+			do {
+				if (s[p] == '"') {
+					string ignored;
+					if (read_string(ignored) != 0)
+						return -1;
+					continue;
+				}
+				if (s[p] == '{' || s[p] == '[')
+					depth++;
+				else if (s[p] == '}' || s[p] == ']')
+					depth--;
+				p++;
+			} while (depth > 0 && p < s.size());
+			if (depth > 0) {
+				error = "unterminated container";
+				return -1;
+			}
+		}
+		else
+			while (p < s.size() && s[p] != ',' && s[p] != '}' && s[p] != ']' && s[p] != ' ')
+				p++;
+		if (p == start) {
+			ostringstream e;
+			e << "expected a value at offset " << p;
+			error = e.str();
+			return -1;
+		}
+		text = s.substr(start, p - start);
+		return 0;
+	}
+};
+
+int server_parse(const string& line, struct server_request& req, string& error) {
+	struct json_reader json(line);
+	req.id = "null";
+	req.args.clear();
+	int has_args = 0;
+	if (json.expect('{') != 0) {
+		error = json.error;
+		return -1;
+	}
+	json.skip_space();
+	if (json.p < line.size() && line[json.p] == '}')
+		json.p++;
+	else
+		for (;;) {
+			string name;
+			if (json.read_string(name) != 0 || json.expect(':') != 0) {
+				error = json.error;
+				return -1;
+			}
+			if (name.compare("args") == 0) {
+				if (json.expect('[') != 0) {
+					error = json.error;
+					return -1;
+				}
+				json.skip_space();
+				if (json.p < line.size() && line[json.p] == ']')
+					json.p++;
+				else
+					for (;;) {
+						string arg;
+						if (json.read_string(arg) != 0) {
+							error = "args must be an array of strings: " + json.error;
+							return -1;
+						}
+						req.args.push_back(arg);
+						json.skip_space();
+						if (json.p < line.size() && line[json.p] == ',') {
+							json.p++;
+							continue;
+						}
+						if (json.expect(']') != 0) {
+							error = json.error;
+							return -1;
+						}
+						break;
+					}
+				has_args = 1;
+			}
+			else if (name.compare("id") == 0) {
+				string id;
+				if (json.read_id(id) != 0) {
+					error = json.error;
+					return -1;
+				}
+				req.id = id;
+			}
+			else {
+				string value;
+				if (json.read_value(value) != 0) {
+					error = json.error;
+					return -1;
+				}
+			}
+			json.skip_space();
+			if (json.p < line.size() && line[json.p] == ',') {
+				json.p++;
+				continue;
+			}
+			if (json.expect('}') != 0) {
+				error = json.error;
+				return -1;
+			}
+			break;
+		}
+	if (!has_args) {
+		error = "no args";
+		return -1;
+	}
+	return 0;
+}
+
+string server_response(const struct server_request& req, const string& error, double wall_s) {
+	ostringstream out;
+	out << setprecision(6) << "{\"id\": " << req.id << ", \"status\": ";
+	if (error.empty())
+		out << "\"ok\"";
+	else
+		out << "\"error\", \"error\": " << json_string(error);
+	out << ", \"wall_s\": " << wall_s << "}";
+	return out.str();
+}
+
+void server_run(istream& in, ostream& out, int workers, size_t queue_length,
+		function<string(const struct server_request&)> handle) {
+	deque<struct server_request> queue;
+	int done = 0;
+	mutex lock, out_lock;
+	condition_variable ready, space;
+
+	auto respond = [&](const string& response) {
+		lock_guard<mutex> guard(out_lock);
+		out << response << endl;
+	};
+	auto work = [&]() {
+		for (;;) {
+			struct server_request req;
+			{
+				unique_lock<mutex> guard(lock);
+				ready.wait(guard, [&]() { return !queue.empty() || done; });
+				if (queue.empty())
+					return;
+				req = queue.front();
+				queue.pop_front();
+			}
+			space.notify_one();
+			respond(handle(req));
+		}
+	};
+	vector<thread> pool;
+	for (int w = 0; w < workers; w++)
+		pool.push_back(thread(work));
+
+	// reading stops while the queue is full so that a burst of requests cannot run away with memory
+	string line;
+	while (getline(in, line)) {
+		if (line.find_first_not_of(" \t\r") == string::npos)
+			continue;
+		struct server_request req;
+		string error;
+		if (server_parse(line, req, error) != 0) {
+			respond(server_response(req, "invalid request: " + error, 0.0));
+			continue;
+		}
+		unique_lock<mutex> guard(lock);
+		space.wait(guard, [&]() { return queue.size() < queue_length; });
+		queue.push_back(req);
+		guard.unlock();
+		ready.notify_one();
+	}
+	{
+		lock_guard<mutex> guard(lock);
+		done = 1;
+	}
+	ready.notify_all();
+	for (size_t w = 0; w < pool.size(); w++)
+		pool[w].join();
+}
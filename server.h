@@ -0,0 +1,38 @@
+/*
+ * server
+ *
+ * Long-running server mode: requests are read as JSON lines, run on a
+ * bounded pool of worker threads and answered with one JSON line each
+ *
+ * License: Apache
+ */
+
+#ifndef MESHMAKER_SERVER_H
+#define MESHMAKER_SERVER_H
+
+// standard headers
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+struct server_request {
+	std::string id; // re-encoded as JSON: a string, a number or null
+	std::vector<std::string> args; // command-line arguments as for meshmaker itself
+};
+
+// parse a request line {"id": <string, number or null>, "args": [<string>, ...]} (other members are
+// ignored); the id is re-encoded rather than kept as given. Returns 0, otherwise sets error and returns
+// -1 (req.id is then the id if it was read before the error, otherwise null)
+int server_parse(const std::string& line, struct server_request& req, std::string& error);
+
+// the response to a request as a JSON line: {"id": ..., "status": "ok"|"error"[, "error": ...], "wall_s": ...}
+std::string server_response(const struct server_request& req, const std::string& error, double wall_s);
+
+// read requests from in until it ends and run handle on each on workers threads, at most queue_length
+// of them waiting; handle returns the response line, which is written to out as soon as it is done
+// (i.e. responses come in completion order, matched to requests by id)
+void server_run(std::istream& in, std::ostream& out, int workers, size_t queue_length,
+		std::function<std::string(const struct server_request&)> handle);
+
+#endif
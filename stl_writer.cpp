@@ -0,0 +1,244 @@
+/*
+ * stl_writer
+ *
+ * Parallel binary STL writer (see stl_writer.h)
+ *
+ * License: Apache
+ */
+
+// standard headers
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+// VTK headers
+#include "vtkCellArray.h"
+#include "vtkFloatArray.h"
+#include "vtkPoints.h"
+#include "vtkSMPTools.h"
+
+#include "stl_writer.h"
+
+using namespace std;
+
+// 80-byte header, facet count, then per facet a normal, three vertices and a 2-byte attribute
+static const size_t STL_HEADER_SIZE = 80;
+static const size_t STL_FACET_SIZE = 50;
+// facets per buffer (50 MB)
+static const vtkIdType CHUNK_FACETS = 1 << 20;
+
+static int host_is_little_endian(void) {
+	uint16_t one = 1;
+	return *reinterpret_cast<unsigned char *>(&one) == 1;
+}
+
+// STL is little-endian
+static inline void put_float(unsigned char *p, float f, int swap) {
+	memcpy(p, &f, 4);
+	if (swap) {
+		unsigned char t = p[0]; p[0] = p[3]; p[3] = t;
+		t = p[1]; p[1] = p[2]; p[2] = t;
+	}
+}
+
+// cell offsets and connectivity of a cell array whichever its storage (VTK 9 arrays start at 0)
+struct cells {
+	vtkIdType ncells = 0;
+	int strips = 0; // triangle strips rather than polygons
+	int is64 = 0;
+	const vtkTypeInt64 *offsets64 = NULL, *conn64 = NULL;
+	const vtkTypeInt32 *offsets32 = NULL, *conn32 = NULL;
+
+	vtkIdType offset(vtkIdType c) const { return is64 ? (vtkIdType)offsets64[c] : (vtkIdType)offsets32[c]; }
+	vtkIdType id(vtkIdType k) const { return is64 ? (vtkIdType)conn64[k] : (vtkIdType)conn32[k]; }
+	// fans and strips of n points have n - 2 triangles
+	vtkIdType facets(vtkIdType c) const {
+		vtkIdType n = offset(c + 1) - offset(c);
+		return n > 2 ? n - 2 : 0;
+	}
+};
+
+static struct cells view_cells(vtkCellArray *array, int strips) {
+	struct cells c;
+	c.strips = strips;
+	if (array == NULL || array->GetNumberOfCells() == 0)
+		return c;
+	c.ncells = array->GetNumberOfCells();
+	c.is64 = array->IsStorage64Bit();
+	if (c.is64) {
+		c.offsets64 = array->GetOffsetsArray64()->GetPointer(0);
+		c.conn64 = array->GetConnectivityArray64()->GetPointer(0);
+	}
+	else {
+		c.offsets32 = array->GetOffsetsArray32()->GetPointer(0);
+		c.conn32 = array->GetConnectivityArray32()->GetPointer(0);
+	}
+	return c;
+}
+
+int stl_write(vtkPolyData *mesh, const string& fn) {
+	FILE *out = fopen(fn.c_str(), "wb");
+	if (out == NULL) {
+		cerr << "Unable to write '" << fn << "': " << strerror(errno) << endl;
+		return -1;
+	}
+	int failed = stl_write(mesh, out, fn);
+	if (fclose(out) != 0 && !failed) {
+		cerr << "Unable to write '" << fn << "': " << strerror(errno) << endl;
+		failed = -1;
+	}
+	return failed;
+}
+
+int stl_write(vtkPolyData *mesh, FILE *out, const string& name) {
+	// strips go first, as with vtkSTLWriter
+	struct cells sources[2] = { view_cells(mesh->GetStrips(), 1), view_cells(mesh->GetPolys(), 0) };
+	vtkPoints *points = mesh->GetPoints();
+	const float *fpoints = NULL;
+	if (points != NULL) {
+		vtkFloatArray *data = vtkFloatArray::SafeDownCast(points->GetData());
+		if (data != NULL && data->GetNumberOfComponents() == 3)
+			fpoints = data->GetPointer(0);
+	}
+
+	// the facet count goes in the header
+	uint64_t nfacets = 0;
+	for (int s = 0; s < 2; s++) {
+		const struct cells& src = sources[s];
+		if (!src.strips && src.ncells > 0 && mesh->GetPolys()->IsHomogeneous() == 3)
+			nfacets += src.ncells;
+		else
+			for (vtkIdType c = 0; c < src.ncells; c++)
+				nfacets += src.facets(c);
+	}
+	if (nfacets > UINT32_MAX) {
+		cerr << "Too many facets (" << nfacets << ") for binary STL" << endl;
+		return -1;
+	}
+
+	// the buffers are big enough already
+	setvbuf(out, NULL, _IONBF, 0);
+	int swap = !host_is_little_endian();
+	unsigned char header[STL_HEADER_SIZE + 4];
+	memset(header, ' ', STL_HEADER_SIZE);
+	const char *title = "meshmaker binary STL";
+	memcpy(header, title, strlen(title));
+	uint32_t count = (uint32_t)nfacets;
+	memcpy(header + STL_HEADER_SIZE, &count, 4);
+	if (swap)
+		for (int b = 0; b < 2; b++) {
+			unsigned char t = header[STL_HEADER_SIZE + b];
+			header[STL_HEADER_SIZE + b] = header[STL_HEADER_SIZE + 3 - b];
+			header[STL_HEADER_SIZE + 3 - b] = t;
+		}
+	int failed = fwrite(header, 1, sizeof(header), out) != sizeof(header);
+
+	// chunks of whole cells of about CHUNK_FACETS facets are packed into one buffer while
+	// the other is written
+	vector<unsigned char> buffers[2];
+	vector<vtkIdType> first_facet; // of each cell of the chunk (for fans and strips)
+	thread writer;
+	int write_failed = 0;
+	int current = 0;
+	for (int s = 0; s < 2 && !failed; s++) {
+		const struct cells& src = sources[s];
+		int triangles = !src.strips && src.ncells > 0 && mesh->GetPolys()->IsHomogeneous() == 3;
+		for (vtkIdType c0 = 0; c0 < src.ncells && !failed;) {
+			vtkIdType c1, chunk_facets = 0;
+			if (triangles) {
+				c1 = min(src.ncells, c0 + CHUNK_FACETS);
+				chunk_facets = c1 - c0;
+			}
+			else {
+				first_facet.clear();
+				for (c1 = c0; c1 < src.ncells && chunk_facets < CHUNK_FACETS; c1++) {
+					first_facet.push_back(chunk_facets);
+					chunk_facets += src.facets(c1);
+				}
+			}
+
+			vector<unsigned char>& buffer = buffers[current];
+			buffer.resize(chunk_facets * STL_FACET_SIZE);
+			unsigned char *base = buffer.empty() ? NULL : &buffer[0];
+			const vtkIdType *starts = first_facet.empty() ? NULL : &first_facet[0];
+			auto pack = [&](vtkIdType first, vtkIdType last) {
+				for (vtkIdType c = first; c < last; c++) {
+					vtkIdType begin = src.offset(c), n = src.offset(c + 1) - begin;
+					unsigned char *facet = base + (triangles ? c - c0 : starts[c - c0]) * STL_FACET_SIZE;
+					for (vtkIdType t = 0; t + 2 < n; t++, facet += STL_FACET_SIZE) {
+						// fans share the first point; every other strip triangle is reversed
+						vtkIdType ids[3];
+						if (src.strips) {
+							ids[0] = src.id(begin + t + (t & 1));
+							ids[1] = src.id(begin + t + 1 - (t & 1));
+							ids[2] = src.id(begin + t + 2);
+						}
+						else {
+							ids[0] = src.id(begin);
+							ids[1] = src.id(begin + t + 1);
+							ids[2] = src.id(begin + t + 2);
+						}
+						double p[3][3];
+						for (int k = 0; k < 3; k++) {
+							if (fpoints != NULL) {
+								const float *f = fpoints + 3 * ids[k];
+								p[k][0] = f[0];
+								p[k][1] = f[1];
+								p[k][2] = f[2];
+							}
+							else
+								points->GetPoint(ids[k], p[k]);
+						}
+						// as vtkTriangle::ComputeNormal
+						double u[3], v[3], nrm[3];
+						for (int d = 0; d < 3; d++) {
+							u[d] = p[2][d] - p[1][d];
+							v[d] = p[0][d] - p[1][d];
+						}
+						nrm[0] = u[1] * v[2] - u[2] * v[1];
+						nrm[1] = u[2] * v[0] - u[0] * v[2];
+						nrm[2] = u[0] * v[1] - u[1] * v[0];
+						double length = sqrt(nrm[0] * nrm[0] + nrm[1] * nrm[1] + nrm[2] * nrm[2]);
+						if (length != 0)
+							for (int d = 0; d < 3; d++)
+								nrm[d] /= length;
+						for (int d = 0; d < 3; d++)
+							put_float(facet + 4 * d, (float)nrm[d], swap);
+						for (int k = 0; k < 3; k++)
+							for (int d = 0; d < 3; d++)
+								put_float(facet + 12 + 12 * k + 4 * d, (float)p[k][d], swap);
+						facet[48] = facet[49] = 0;
+					}
+				}
+			};
+			vtkSMPTools::For(c0, c1, pack);
+
+			// the previous buffer has to be out before this one goes
+			if (writer.joinable())
+				writer.join();
+			failed = write_failed;
+			if (!buffer.empty() && !failed) {
+				auto flush = [&write_failed, &buffer, out]() {
+					write_failed = fwrite(&buffer[0], 1, buffer.size(), out) != buffer.size();
+				};
+				writer = thread(flush);
+			}
+			current = 1 - current;
+			c0 = c1;
+		}
+	}
+	if (writer.joinable())
+		writer.join();
+	failed = failed || write_failed || fflush(out) != 0;
+	if (failed) {
+		cerr << "Unable to write '" << name << "': " << strerror(errno) << endl;
+		return -1;
+	}
+	return 0;
+}
@@ -0,0 +1,30 @@
+/*
+ * stl_writer
+ *
+ * Binary STL output: facets and their normals are packed into large
+ * buffers on vtkSMPTools while the previous buffer is being written
+ *
+ * License: Apache
+ */
+
+#ifndef MESHMAKER_STL_WRITER_H
+#define MESHMAKER_STL_WRITER_H
+
+// standard headers
+#include <cstdio>
+#include <string>
+
+// VTK headers
+#include "vtkPolyData.h"
+
+// write the triangle strips and polygons of mesh to fn as binary STL with the same facets and
+// normals as vtkSTLWriter (polygons of more than three points are split into fans rather than
+// triangulated); other cells are ignored.
+// Returns 0 on success, otherwise prints the reason and returns -1
+int stl_write(vtkPolyData *mesh, const std::string& fn);
+
+// the same to the stream out (e.g. a pipe: it is written strictly in order), which is flushed but left
+// open; name is only used in messages
+int stl_write(vtkPolyData *mesh, FILE *out, const std::string& name);
+
+#endif
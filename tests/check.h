@@ -0,0 +1,35 @@
+/*
+ * check
+ *
+ * The assertions of the tests: a failed check is printed with where it is
+ * and counted, and the test exits with failure if any did
+ *
+ * License: Apache
+ */
+
+#ifndef MESHMAKER_CHECK_H
+#define MESHMAKER_CHECK_H
+
+// standard headers
+#include <cstdlib>
+#include <iostream>
+
+static int check_failures = 0;
+
+static void check(int ok, const char *what, const char *file, int line) {
+	if (ok)
+		return;
+	std::cerr << file << ":" << line << ": check failed: " << what << std::endl;
+	check_failures++;
+}
+
+#define CHECK(condition) check((condition) ? 1 : 0, #condition, __FILE__, __LINE__)
+
+// the exit code of a test
+static int check_result(void) {
+	if (check_failures > 0)
+		std::cerr << check_failures << " check(s) failed" << std::endl;
+	return check_failures > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+#endif
@@ -0,0 +1,138 @@
+/*
+ * meshes
+ *
+ * Small surfaces for the tests of the mesh stages (spheres, cubes and a
+ * bumpy open sheet) and the checks of their shape and topology
+ *
+ * License: Apache
+ */
+
+#ifndef MESHMAKER_MESHES_H
+#define MESHMAKER_MESHES_H
+
+// standard headers
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <set>
+#include <utility>
+
+// VTK headers
+#include "vtkSmartPointer.h"
+#include "vtkAppendPolyData.h"
+#include "vtkCellArray.h"
+#include "vtkCleanPolyData.h"
+#include "vtkCubeSource.h"
+#include "vtkIdList.h"
+#include "vtkPlaneSource.h"
+#include "vtkPoints.h"
+#include "vtkPolyData.h"
+#include "vtkSphereSource.h"
+#include "vtkTriangleFilter.h"
+
+// the output of a source or filter, apart from it
+template <class T>
+inline vtkSmartPointer<vtkPolyData> mesh_of(T *algorithm) {
+	algorithm->Update();
+	vtkSmartPointer<vtkPolyData> mesh = vtkSmartPointer<vtkPolyData>::New();
+	mesh->DeepCopy(algorithm->GetOutput());
+	return mesh;
+}
+
+// a closed triangulated sphere
+inline vtkSmartPointer<vtkPolyData> sphere_mesh(double radius, int resolution, double x = 0.0, double y = 0.0, double z = 0.0) {
+	vtkSmartPointer<vtkSphereSource> sphere = vtkSmartPointer<vtkSphereSource>::New();
+	sphere->SetRadius(radius);
+	sphere->SetCenter(x, y, z);
+	sphere->SetThetaResolution(resolution);
+	sphere->SetPhiResolution(resolution);
+	return mesh_of(sphere.GetPointer());
+}
+
+// a closed cube of 12 triangles that share their corners
+inline vtkSmartPointer<vtkPolyData> cube_mesh(double edge, double x = 0.0, double y = 0.0, double z = 0.0) {
+	vtkSmartPointer<vtkCubeSource> cube = vtkSmartPointer<vtkCubeSource>::New();
+	cube->SetXLength(edge);
+	cube->SetYLength(edge);
+	cube->SetZLength(edge);
+	cube->SetCenter(x, y, z);
+	vtkSmartPointer<vtkTriangleFilter> triangles = vtkSmartPointer<vtkTriangleFilter>::New();
+	triangles->SetInputConnection(cube->GetOutputPort());
+	// the source has points of its own for the normals of each face
+	vtkSmartPointer<vtkCleanPolyData> clean = vtkSmartPointer<vtkCleanPolyData>::New();
+	clean->SetInputConnection(triangles->GetOutputPort());
+	clean->PointMergingOn();
+	return mesh_of(clean.GetPointer());
+}
+
+// an open unit square of 2 x resolution^2 triangles in z = 0, raised by a wave of amplitude inside
+// (its border stays flat)
+inline vtkSmartPointer<vtkPolyData> sheet_mesh(int resolution, double amplitude) {
+	vtkSmartPointer<vtkPlaneSource> plane = vtkSmartPointer<vtkPlaneSource>::New();
+	plane->SetOrigin(0.0, 0.0, 0.0);
+	plane->SetPoint1(1.0, 0.0, 0.0);
+	plane->SetPoint2(0.0, 1.0, 0.0);
+	plane->SetResolution(resolution, resolution);
+	vtkSmartPointer<vtkTriangleFilter> triangles = vtkSmartPointer<vtkTriangleFilter>::New();
+	triangles->SetInputConnection(plane->GetOutputPort());
+	vtkSmartPointer<vtkPolyData> sheet = mesh_of(triangles.GetPointer());
+	vtkPoints *points = sheet->GetPoints();
+	for (vtkIdType p = 0; p < points->GetNumberOfPoints(); p++) {
+		double x[3];
+		points->GetPoint(p, x);
+		x[2] = amplitude * sin(20.0 * x[0]) * sin(20.0 * x[1]) * sin(M_PI * x[0]) * sin(M_PI * x[1]);
+		points->SetPoint(p, x);
+	}
+	return sheet;
+}
+
+// the surfaces of a and b as one mesh, without merging any points
+inline vtkSmartPointer<vtkPolyData> append_meshes(vtkPolyData *a, vtkPolyData *b) {
+	vtkSmartPointer<vtkAppendPolyData> append = vtkSmartPointer<vtkAppendPolyData>::New();
+	append->AddInputData(a);
+	append->AddInputData(b);
+	return mesh_of(append.GetPointer());
+}
+
+// the number of polygons on each edge of mesh (the smaller point id first)
+inline std::map<std::pair<vtkIdType, vtkIdType>, int> edge_uses(vtkPolyData *mesh) {
+	std::map<std::pair<vtkIdType, vtkIdType>, int> uses;
+	vtkSmartPointer<vtkIdList> ids = vtkSmartPointer<vtkIdList>::New();
+	vtkCellArray *polys = mesh->GetPolys();
+	for (polys->InitTraversal(); polys->GetNextCell(ids);)
+		for (vtkIdType k = 0; k < ids->GetNumberOfIds(); k++) {
+			vtkIdType a = ids->GetId(k), b = ids->GetId((k + 1) % ids->GetNumberOfIds());
+			uses[std::make_pair(std::min(a, b), std::max(a, b))]++;
+		}
+	return uses;
+}
+
+// whether every edge of mesh has exactly two polygons and V - E + F = 2 (a closed surface of genus 0)
+inline int is_closed_sphere(vtkPolyData *mesh) {
+	std::map<std::pair<vtkIdType, vtkIdType>, int> uses = edge_uses(mesh);
+	for (std::map<std::pair<vtkIdType, vtkIdType>, int>::const_iterator e = uses.begin(); e != uses.end(); ++e)
+		if (e->second != 2)
+			return 0;
+	return mesh->GetNumberOfPoints() - (vtkIdType)uses.size() + mesh->GetNumberOfPolys() == 2;
+}
+
+// the points of mesh on its open edges
+inline std::set<vtkIdType> border_points(vtkPolyData *mesh) {
+	std::map<std::pair<vtkIdType, vtkIdType>, int> uses = edge_uses(mesh);
+	std::set<vtkIdType> border;
+	for (std::map<std::pair<vtkIdType, vtkIdType>, int>::const_iterator e = uses.begin(); e != uses.end(); ++e)
+		if (e->second == 1) {
+			border.insert(e->first.first);
+			border.insert(e->first.second);
+		}
+	return border;
+}
+
+// the distance of point p of mesh from (x, y, z)
+inline double point_distance(vtkPolyData *mesh, vtkIdType p, double x = 0.0, double y = 0.0, double z = 0.0) {
+	double q[3];
+	mesh->GetPoint(p, q);
+	return sqrt((q[0] - x) * (q[0] - x) + (q[1] - y) * (q[1] - y) + (q[2] - z) * (q[2] - z));
+}
+
+#endif
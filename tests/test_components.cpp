@@ -0,0 +1,98 @@
+/*
+ * test_components
+ *
+ * Filtering the components of a big sphere, a small sphere and a cube: by
+ * rank, by polygons and by enclosed volume, and ranked within groups of
+ * points as for the levels of a multi-level surface
+ *
+ * License: Apache
+ */
+
+// standard headers
+#include <vector>
+
+// VTK headers
+#include "vtkSmartPointer.h"
+#include "vtkPolyData.h"
+
+#include "components.h"
+#include "check.h"
+#include "meshes.h"
+
+using namespace std;
+
+static vtkSmartPointer<vtkPolyData> big, small, cube, all;
+
+static vtkSmartPointer<vtkPolyData> filtered(const struct component_filter& filter, vtkIdType nkept_expected,
+		const vector<unsigned short> *groups = NULL) {
+	vtkIdType ncomponents = 0, nkept = 0;
+	vtkSmartPointer<vtkPolyData> kept = filter_components(all, filter, ncomponents, nkept, groups);
+	CHECK(ncomponents == 3);
+	CHECK(nkept == nkept_expected);
+	return kept;
+}
+
+// whether mesh holds exactly the polygons and points of the meshes a and b
+static int holds(vtkPolyData *mesh, vtkPolyData *a, vtkPolyData *b = NULL) {
+	vtkIdType polys = a->GetNumberOfPolys() + (b != NULL ? b->GetNumberOfPolys() : 0);
+	vtkIdType points = a->GetNumberOfPoints() + (b != NULL ? b->GetNumberOfPoints() : 0);
+	return mesh->GetNumberOfPolys() == polys && mesh->GetNumberOfPoints() == points;
+}
+
+static void test_filters(void) {
+	struct component_filter none;
+	CHECK(holds(filtered(none, 3), all));
+
+	// the big sphere has the most polygons
+	struct component_filter largest;
+	largest.largest = 1;
+	vtkSmartPointer<vtkPolyData> kept = filtered(largest, 1);
+	CHECK(holds(kept, big));
+	int on_big = 1;
+	for (vtkIdType p = 0; p < kept->GetNumberOfPoints(); p++)
+		on_big = on_big && point_distance(kept, p) < 1.0 + 1e-6;
+	CHECK(on_big);
+	CHECK(is_closed_sphere(kept));
+	largest.largest = 5;
+	CHECK(holds(filtered(largest, 3), all));
+
+	// the cube has 12 triangles, the small sphere far more
+	struct component_filter polys;
+	polys.min_polys = 50;
+	CHECK(holds(filtered(polys, 2), append_meshes(big, small)));
+	polys.min_polys = big->GetNumberOfPolys() + 1;
+	CHECK(filtered(polys, 0)->GetNumberOfPolys() == 0);
+
+	// but the cube (0.125) encloses more than the small sphere (under 0.034)
+	struct component_filter volume;
+	volume.min_volume = 0.1;
+	CHECK(holds(filtered(volume, 2), append_meshes(big, cube)));
+
+	// the filters all apply
+	struct component_filter both;
+	both.min_polys = 50;
+	both.min_volume = 0.1;
+	CHECK(holds(filtered(both, 1), big));
+}
+
+static void test_groups(void) {
+	// the small sphere at a level of its own is the largest there
+	vector<unsigned short> groups(all->GetNumberOfPoints(), 0);
+	for (vtkIdType p = big->GetNumberOfPoints(); p < big->GetNumberOfPoints() + small->GetNumberOfPoints(); p++)
+		groups[p] = 1;
+	struct component_filter largest;
+	largest.largest = 1;
+	CHECK(holds(filtered(largest, 2, &groups), append_meshes(big, small)));
+	largest.largest = 2;
+	CHECK(holds(filtered(largest, 3, &groups), all));
+}
+
+int main(void) {
+	big = sphere_mesh(1.0, 32);
+	small = sphere_mesh(0.2, 8, 3.0, 0.0, 0.0);
+	cube = cube_mesh(0.5, -3.0, 0.0, 0.0);
+	all = append_meshes(append_meshes(big, small), cube);
+	test_filters();
+	test_groups();
+	return check_result();
+}
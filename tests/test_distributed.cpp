@@ -0,0 +1,188 @@
+/*
+ * test_distributed
+ *
+ * The gathering of strings and meshes on rank 0 and the .pvtp index of the
+ * pieces of all ranks: on a single rank without MPI, and on every rank of
+ * an MPI run (e.g. mpiexec -n 2) when built with it
+ *
+ * License: Apache
+ */
+
+// standard headers
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// VTK headers
+#include "vtkSmartPointer.h"
+#include "vtkPointData.h"
+#include "vtkPoints.h"
+#include "vtkPolyData.h"
+#include "vtkUnsignedShortArray.h"
+#include "vtkXMLPPolyDataReader.h"
+
+#include "distributed.h"
+#include "normals.h"
+#include "vtp_writer.h"
+#include "check.h"
+#include "meshes.h"
+
+using namespace std;
+
+// the sphere of rank r, with the point arrays of a surface of several levels
+static vtkSmartPointer<vtkPolyData> piece_of(int r) {
+	vtkSmartPointer<vtkPolyData> mesh = sphere_mesh(1.0, 16, 3.0 * r, 0.0, 0.0);
+	mesh->GetPointData()->AddArray(vertex_normals(mesh));
+	vtkSmartPointer<vtkUnsignedShortArray> levels = vtkSmartPointer<vtkUnsignedShortArray>::New();
+	levels->SetName("level");
+	levels->SetNumberOfTuples(mesh->GetNumberOfPoints());
+	for (vtkIdType p = 0; p < mesh->GetNumberOfPoints(); p++)
+		levels->SetTuple1(p, r + p % 2);
+	mesh->GetPointData()->AddArray(levels);
+	return mesh;
+}
+
+// whether b has the points, polygons and point arrays of a
+static int same_mesh(vtkPolyData *a, vtkPolyData *b) {
+	if (a == NULL || b == NULL || a->GetNumberOfPoints() != b->GetNumberOfPoints() || a->GetNumberOfPolys() != b->GetNumberOfPolys())
+		return 0;
+	for (vtkIdType p = 0; p < a->GetNumberOfPoints(); p++) {
+		double x[3];
+		b->GetPoint(p, x);
+		if (point_distance(a, p, x[0], x[1], x[2]) != 0.0)
+			return 0;
+	}
+	if (edge_uses(a) != edge_uses(b))
+		return 0;
+	const char *names[2] = {"Normals", "level"};
+	for (int n = 0; n < 2; n++) {
+		vtkDataArray *x = a->GetPointData()->GetArray(names[n]), *y = b->GetPointData()->GetArray(names[n]);
+		if (x == NULL || y == NULL || x->GetDataType() != y->GetDataType() || x->GetNumberOfComponents() != y->GetNumberOfComponents())
+			return 0;
+		for (vtkIdType t = 0; t < x->GetNumberOfTuples(); t++)
+			for (int c = 0; c < x->GetNumberOfComponents(); c++)
+				if (x->GetComponent(t, c) != y->GetComponent(t, c))
+					return 0;
+	}
+	return 1;
+}
+
+static void test_ranks(void) {
+	int rank = distributed_rank(), size = distributed_size();
+	CHECK(size >= 1 && rank >= 0 && rank < size);
+	if (!distributed_available())
+		CHECK(size == 1 && rank == 0);
+}
+
+static void test_gather(void) {
+	int rank = distributed_rank(), size = distributed_size();
+	ostringstream mine;
+	mine << "rank " << rank;
+	vector<string> all = distributed_gather(mine.str());
+	// empty strings too
+	vector<string> empty = distributed_gather("");
+	if (rank != 0) {
+		CHECK(all.empty() && empty.empty());
+		return;
+	}
+	CHECK(empty.size() == (size_t)size);
+	CHECK(all.size() == (size_t)size);
+	for (size_t r = 0; r < all.size(); r++) {
+		ostringstream theirs;
+		theirs << "rank " << r;
+		CHECK(all[r] == theirs.str());
+	}
+}
+
+static void test_gather_meshes(void) {
+	int rank = distributed_rank(), size = distributed_size();
+	vtkSmartPointer<vtkPolyData> mine = piece_of(rank);
+
+	// the VTP that other ranks send reads back as the same mesh
+	string vtp;
+	CHECK(distributed_encode_mesh(mine, vtp) == 0);
+	CHECK(same_mesh(mine, distributed_decode_mesh(vtp)));
+
+	vector<vtkSmartPointer<vtkPolyData> > meshes = distributed_gather_meshes(mine);
+	if (rank != 0) {
+		CHECK(meshes.empty());
+		return;
+	}
+	CHECK(meshes.size() == (size_t)size);
+	// rank 0 keeps its own
+	CHECK(!meshes.empty() && meshes[0].GetPointer() == mine.GetPointer());
+	for (size_t r = 1; r < meshes.size(); r++)
+		CHECK(same_mesh(piece_of((int)r), meshes[r]));
+}
+
+static string read_text(const string& fn) {
+	ifstream in(fn.c_str());
+	return string((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+}
+
+static void test_index(void) {
+	int rank = distributed_rank(), size = distributed_size();
+	vector<string> pieces;
+	for (int r = 0; r < size; r++) {
+		ostringstream fn;
+		fn << "./test_distributed_" << r << ".vtp";
+		pieces.push_back(fn.str());
+	}
+	vtkSmartPointer<vtkPolyData> mine = piece_of(rank);
+	struct vtp_options opts;
+	CHECK(vtp_write(mine, pieces[rank], opts) == 0);
+	const string index_fn = "test_distributed.pvtp";
+	CHECK(distributed_write_index(index_fn, pieces, mine) == 0);
+	if (rank != 0)
+		return;
+
+	// every piece, without its directory, and the arrays they all have
+	string index = read_text(index_fn);
+	for (int r = 0; r < size; r++) {
+		ostringstream piece;
+		piece << "<Piece Source=\"test_distributed_" << r << ".vtp\"/>";
+		CHECK(index.find(piece.str()) != string::npos);
+	}
+	CHECK(index.find("./") == string::npos);
+	CHECK(index.find("<PDataArray type=\"Float32\" Name=\"Normals\" NumberOfComponents=\"3\"/>") != string::npos);
+	CHECK(index.find("<PDataArray type=\"UInt16\" Name=\"level\"/>") != string::npos);
+	CHECK(index.find("<PDataArray type=\"Float32\" Name=\"Points\" NumberOfComponents=\"3\"/>") != string::npos);
+
+	vtkSmartPointer<vtkXMLPPolyDataReader> reader = vtkSmartPointer<vtkXMLPPolyDataReader>::New();
+	reader->SetFileName(index_fn.c_str());
+	vtkSmartPointer<vtkPolyData> all = mesh_of(reader.GetPointer());
+	CHECK(reader->GetErrorCode() == 0);
+	CHECK(all->GetNumberOfPoints() == size * mine->GetNumberOfPoints());
+	CHECK(all->GetNumberOfPolys() == size * mine->GetNumberOfPolys());
+	CHECK(all->GetPointData()->GetArray("level") != NULL);
+	for (int r = 0; r < size; r++)
+		remove(pieces[r].c_str());
+	remove(index_fn.c_str());
+}
+
+// pieces without points declare Float32 points alone
+static void test_empty_index(void) {
+	vtkSmartPointer<vtkPolyData> empty = vtkSmartPointer<vtkPolyData>::New();
+	const string index_fn = "test_distributed_empty.pvtp";
+	CHECK(distributed_write_index(index_fn, vector<string>(distributed_size(), "none.vtp"), empty) == 0);
+	if (distributed_rank() != 0)
+		return;
+	string index = read_text(index_fn);
+	CHECK(index.find("<PPoints>") != string::npos && index.find("PPointData") == string::npos);
+	remove(index_fn.c_str());
+}
+
+int main(int argc, char **argv) {
+	distributed_init(&argc, &argv);
+	test_ranks();
+	test_gather();
+	test_gather_meshes();
+	test_index();
+	test_empty_index();
+	int result = check_result();
+	distributed_finalize();
+	return result;
+}
@@ -0,0 +1,242 @@
+/*
+ * test_glb_writer
+ *
+ * GLB files of a sphere: the header and chunk lengths and their padding,
+ * the accessors' counts and bounds, indices in range, and oct-encoded
+ * normals declared with KHR_mesh_quantization and decoded near the originals
+ *
+ * License: Apache
+ */
+
+// standard headers
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// VTK headers
+#include "vtkSmartPointer.h"
+#include "vtkFloatArray.h"
+#include "vtkPointData.h"
+#include "vtkPolyData.h"
+#include "vtkShortArray.h"
+
+#include "glb_writer.h"
+#include "normals.h"
+#include "check.h"
+#include "meshes.h"
+
+using namespace std;
+
+static uint32_t get32(const string& data, size_t at) {
+	uint32_t v = 0;
+	for (int b = 3; b >= 0; b--)
+		v = (v << 8) | (unsigned char)data[at + b];
+	return v;
+}
+
+static float get_float(const string& data, size_t at) {
+	uint32_t v = get32(data, at);
+	float f;
+	memcpy(&f, &v, 4);
+	return f;
+}
+
+static short get16(const string& data, size_t at) {
+	return (short)((unsigned char)data[at] | ((unsigned char)data[at + 1] << 8));
+}
+
+// the JSON and BIN chunks of a GLB, or empty strings if its layout is wrong
+struct glb {
+	string json, bin;
+};
+
+static struct glb parse_glb(const string& data) {
+	struct glb g;
+	if (data.size() < 20 || get32(data, 0) != 0x46546C67 || get32(data, 4) != 2 || get32(data, 8) != data.size())
+		return g;
+	size_t json_length = get32(data, 12);
+	if (json_length % 4 != 0 || get32(data, 16) != 0x4E4F534A || 20 + json_length > data.size())
+		return g;
+	string json = data.substr(20, json_length);
+	size_t at = 20 + json_length;
+	if (at < data.size()) {
+		if (at + 8 > data.size())
+			return g;
+		size_t bin_length = get32(data, at);
+		if (bin_length % 4 != 0 || get32(data, at + 4) != 0x004E4942 || at + 8 + bin_length != data.size())
+			return g;
+		g.bin = data.substr(at + 8, bin_length);
+	}
+	g.json = json;
+	return g;
+}
+
+// the numbers following each occurrence of key (e.g. "\"count\":") in json, in order
+static vector<double> numbers_after(const string& json, const string& key) {
+	vector<double> numbers;
+	for (size_t at = json.find(key); at != string::npos; at = json.find(key, at + 1)) {
+		const char *p = json.c_str() + at + key.size();
+		while (*p == '[')
+			p++;
+		numbers.push_back(strtod(p, NULL));
+	}
+	return numbers;
+}
+
+// the three numbers of the first array after key
+static vector<double> array_after(const string& json, const string& key) {
+	vector<double> numbers;
+	size_t at = json.find(key);
+	if (at == string::npos)
+		return numbers;
+	const char *p = json.c_str() + at + key.size() + 1;
+	for (int k = 0; k < 3; k++) {
+		char *end;
+		numbers.push_back(strtod(p, &end));
+		p = end + 1;
+	}
+	return numbers;
+}
+
+static string glb_of(vtkPolyData *mesh) {
+	const string fn = "test_glb_writer.glb";
+	CHECK(glb_write(mesh, fn) == 0);
+	ifstream in(fn.c_str(), ios::binary);
+	string data((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+	in.close();
+	remove(fn.c_str());
+
+	// the same to a stream
+	char *stream = NULL;
+	size_t n = 0;
+	FILE *out = open_memstream(&stream, &n);
+	if (out != NULL) {
+		CHECK(glb_write(mesh, out, "stream") == 0);
+		fclose(out);
+		CHECK(string(stream, n) == data);
+		free(stream);
+	}
+	return data;
+}
+
+static void test_float(void) {
+	vtkSmartPointer<vtkPolyData> sphere = sphere_mesh(1.0, 24);
+	sphere->GetPointData()->AddArray(vertex_normals(sphere));
+	vtkIdType npts = sphere->GetNumberOfPoints(), ntris = sphere->GetNumberOfPolys();
+	struct glb g = parse_glb(glb_of(sphere));
+	CHECK(!g.json.empty() && !g.bin.empty());
+	CHECK(g.json.find("KHR_mesh_quantization") == string::npos);
+
+	// positions, normals, then the indices
+	vector<double> counts = numbers_after(g.json, "\"count\":");
+	CHECK(counts.size() == 3 && counts[0] == npts && counts[1] == npts && counts[2] == 3 * ntris);
+	vector<double> types = numbers_after(g.json, "\"componentType\":");
+	CHECK(types.size() == 3 && types[0] == 5126 && types[1] == 5126 && types[2] == 5123);
+	vector<double> offsets = numbers_after(g.json, "\"byteOffset\":");
+	vector<double> lengths = numbers_after(g.json, "\"byteLength\":");
+	// the buffer, then each of its views
+	CHECK(lengths.size() == 4 && lengths[0] == g.bin.size());
+	CHECK(offsets.size() >= 3 && offsets[0] == 0 && offsets[1] == 12 * npts && offsets[2] == 24 * npts);
+	if (lengths.size() != 4 || offsets.size() < 3 || g.bin.size() < offsets[2] + 2 * 3 * ntris)
+		return;
+	CHECK(lengths[3] == 2 * 3 * ntris);
+
+	// the bounds are those of the Float32 positions written
+	double bounds[6];
+	for (int a = 0; a < 3; a++) {
+		bounds[2 * a] = 1e30;
+		bounds[2 * a + 1] = -1e30;
+	}
+	int same = 1;
+	for (vtkIdType p = 0; p < npts; p++) {
+		double x[3];
+		sphere->GetPoint(p, x);
+		for (int a = 0; a < 3; a++) {
+			float f = get_float(g.bin, 12 * p + 4 * a);
+			same = same && f == (float)x[a];
+			bounds[2 * a] = fmin(bounds[2 * a], f);
+			bounds[2 * a + 1] = fmax(bounds[2 * a + 1], f);
+		}
+	}
+	CHECK(same);
+	vector<double> lo = array_after(g.json, "\"min\":"), hi = array_after(g.json, "\"max\":");
+	CHECK(lo.size() == 3 && hi.size() == 3);
+	for (int a = 0; a < 3 && lo.size() == 3 && hi.size() == 3; a++) {
+		CHECK((float)lo[a] == (float)bounds[2 * a]);
+		CHECK((float)hi[a] == (float)bounds[2 * a + 1]);
+	}
+
+	int in_range = 1;
+	for (vtkIdType k = 0; k < 3 * ntris; k++)
+		in_range = in_range && (uint16_t)get16(g.bin, (size_t)offsets[2] + 2 * k) < npts;
+	CHECK(in_range);
+}
+
+static void test_oct(void) {
+	vtkSmartPointer<vtkPolyData> sphere = sphere_mesh(1.0, 24);
+	vtkSmartPointer<vtkFloatArray> normals = vertex_normals(sphere);
+	sphere->GetPointData()->AddArray(oct_encode(normals));
+	vtkIdType npts = sphere->GetNumberOfPoints();
+	struct glb g = parse_glb(glb_of(sphere));
+	CHECK(!g.json.empty() && !g.bin.empty());
+	CHECK(g.json.find("\"extensionsUsed\":[\"KHR_mesh_quantization\"]") != string::npos);
+	CHECK(g.json.find("\"extensionsRequired\":[\"KHR_mesh_quantization\"]") != string::npos);
+	vector<double> types = numbers_after(g.json, "\"componentType\":");
+	CHECK(types.size() == 3 && types[1] == 5122);
+	CHECK(g.json.find("\"normalized\":true") != string::npos);
+	vector<double> offsets = numbers_after(g.json, "\"byteOffset\":");
+	CHECK(offsets.size() >= 2 && offsets[1] == 12 * npts);
+	if (offsets.size() < 2 || g.bin.size() < offsets[1] + 8 * npts)
+		return;
+
+	// the shorts in the file point where the normals did
+	int near = 1;
+	for (vtkIdType p = 0; p < npts; p++) {
+		double dot = 0.0;
+		for (int a = 0; a < 3; a++)
+			dot += get16(g.bin, (size_t)offsets[1] + 8 * p + 2 * a) / 32767.0 * normals->GetValue(3 * p + a);
+		near = near && dot > 0.999;
+	}
+	CHECK(near);
+}
+
+// oct_decode() undoes oct_encode() to the precision of 16 bits, over both halves of the octahedron
+static void test_oct_round_trip(void) {
+	vtkSmartPointer<vtkFloatArray> normals = vtkSmartPointer<vtkFloatArray>::New();
+	normals->SetNumberOfComponents(3);
+	const float directions[][3] = {{0, 0, 1}, {0, 0, -1}, {1, 0, 0}, {0, -1, 0}, {0.6f, -0.8f, 0}, {0.48f, 0.6f, -0.64f}, {-0.48f, -0.6f, -0.64f}};
+	for (size_t d = 0; d < sizeof(directions) / sizeof(directions[0]); d++)
+		normals->InsertNextTuple3(directions[d][0], directions[d][1], directions[d][2]);
+	vtkSmartPointer<vtkShortArray> oct = oct_encode(normals);
+	int near = 1;
+	for (vtkIdType p = 0; p < normals->GetNumberOfTuples(); p++) {
+		short s[3];
+		oct_decode(oct->GetPointer(2 * p), s);
+		for (int a = 0; a < 3; a++)
+			near = near && fabs(s[a] / 32767.0 - normals->GetValue(3 * p + a)) < 1e-3;
+	}
+	CHECK(near);
+}
+
+// no triangles: a JSON chunk alone
+static void test_empty(void) {
+	vtkSmartPointer<vtkPolyData> empty = vtkSmartPointer<vtkPolyData>::New();
+	struct glb g = parse_glb(glb_of(empty));
+	CHECK(!g.json.empty() && g.bin.empty());
+	CHECK(g.json.find("\"accessors\"") == string::npos);
+}
+
+int main(void) {
+	test_float();
+	test_oct();
+	test_oct_round_trip();
+	test_empty();
+	return check_result();
+}
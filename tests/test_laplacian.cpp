@@ -0,0 +1,103 @@
+/*
+ * test_laplacian
+ *
+ * Parallel Laplacian smoothing against vtkSmoothPolyDataFilter: the same
+ * triangles, convex surfaces shrink, fixed borders stay put and the points
+ * end up close to where VTK's filter puts them
+ *
+ * License: Apache
+ */
+
+// standard headers
+#include <cmath>
+#include <set>
+
+// VTK headers
+#include "vtkSmartPointer.h"
+#include "vtkPolyData.h"
+#include "vtkSmoothPolyDataFilter.h"
+
+#include "laplacian.h"
+#include "check.h"
+#include "meshes.h"
+
+using namespace std;
+
+// the mean distance between the points of a and b (which have the same number of them)
+static double mean_difference(vtkPolyData *a, vtkPolyData *b) {
+	double sum = 0.0;
+	for (vtkIdType p = 0; p < a->GetNumberOfPoints(); p++) {
+		double x[3];
+		b->GetPoint(p, x);
+		sum += point_distance(a, p, x[0], x[1], x[2]);
+	}
+	return a->GetNumberOfPoints() > 0 ? sum / a->GetNumberOfPoints() : 0.0;
+}
+
+static vtkSmartPointer<vtkPolyData> vtk_smooth(vtkPolyData *mesh, int iterations, int boundary_smoothing) {
+	vtkSmartPointer<vtkSmoothPolyDataFilter> smooth = vtkSmartPointer<vtkSmoothPolyDataFilter>::New();
+	smooth->SetInputData(mesh);
+	smooth->SetNumberOfIterations(iterations);
+	smooth->SetBoundarySmoothing(boundary_smoothing);
+	return mesh_of(smooth.GetPointer());
+}
+
+static void test_sphere(void) {
+	vtkSmartPointer<vtkPolyData> sphere = sphere_mesh(1.0, 32);
+	vtkSmartPointer<vtkPolyData> smoothed = laplacian_smooth(sphere, 20, 1);
+	CHECK(smoothed->GetNumberOfPoints() == sphere->GetNumberOfPoints());
+	CHECK(smoothed->GetNumberOfPolys() == sphere->GetNumberOfPolys());
+	CHECK(is_closed_sphere(smoothed));
+	// every point moves towards the centroid of its neighbours, which lies inside the sphere
+	int inside = 1, finite = 1;
+	for (vtkIdType p = 0; p < smoothed->GetNumberOfPoints(); p++) {
+		double r = point_distance(smoothed, p);
+		finite = finite && std::isfinite(r);
+		inside = inside && r <= point_distance(sphere, p) + 1e-6 && r > 0.9;
+	}
+	CHECK(finite);
+	CHECK(inside);
+
+	// Jacobi rather than Gauss-Seidel steps only change the result by a fraction of the movement
+	vtkSmartPointer<vtkPolyData> reference = vtk_smooth(sphere, 20, 1);
+	double moved = mean_difference(sphere, reference);
+	CHECK(moved > 0.0);
+	CHECK(mean_difference(smoothed, reference) < 0.25 * moved);
+
+	// no iterations, no change
+	CHECK(mean_difference(laplacian_smooth(sphere, 0, 1), sphere) == 0.0);
+}
+
+static void test_border(void) {
+	vtkSmartPointer<vtkPolyData> sheet = sheet_mesh(40, 0.05);
+	set<vtkIdType> border = border_points(sheet);
+	CHECK(!border.empty());
+	vtkSmartPointer<vtkPolyData> smoothed = laplacian_smooth(sheet, 50, 0);
+	CHECK(smoothed->GetNumberOfPoints() == sheet->GetNumberOfPoints());
+	// the border is fixed, the bumps inside are flattened
+	int fixed = 1;
+	for (set<vtkIdType>::const_iterator p = border.begin(); p != border.end(); ++p) {
+		double x[3];
+		sheet->GetPoint(*p, x);
+		fixed = fixed && point_distance(smoothed, *p, x[0], x[1], x[2]) == 0.0;
+	}
+	CHECK(fixed);
+	double before = 0.0, after = 0.0;
+	for (vtkIdType p = 0; p < sheet->GetNumberOfPoints(); p++) {
+		double x[3], y[3];
+		sheet->GetPoint(p, x);
+		smoothed->GetPoint(p, y);
+		before += x[2] * x[2];
+		after += y[2] * y[2];
+	}
+	CHECK(after < before);
+
+	vtkSmartPointer<vtkPolyData> reference = vtk_smooth(sheet, 50, 0);
+	CHECK(mean_difference(smoothed, reference) < 0.25 * mean_difference(sheet, reference));
+}
+
+int main(void) {
+	test_sphere();
+	test_border();
+	return check_result();
+}
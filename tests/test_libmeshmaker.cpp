@@ -0,0 +1,215 @@
+/*
+ * test_libmeshmaker
+ *
+ * The C and C++ API on a synthetic sphere in memory: closed meshes with
+ * indices in range, one mesh per level, the caller's voxels left as they
+ * were, cancellation by the progress callback and concurrent calls
+ *
+ * License: Apache
+ */
+
+// standard headers
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "libmeshmaker.h"
+#include "check.h"
+
+using namespace std;
+
+static const int N = 32;
+
+// N^3 voxels of 10 minus the distance from the centre of the box, so level c is a sphere of radius 10 - c
+static vector<float> sphere_voxels(void) {
+	vector<float> voxels((size_t)N * N * N);
+	double c = 0.5 * (N - 1);
+	for (int k = 0; k < N; k++)
+		for (int j = 0; j < N; j++)
+			for (int i = 0; i < N; i++)
+				voxels[((size_t)k * N + j) * N + i] = (float)(10.0 - sqrt((i - c) * (i - c) + (j - c) * (j - c) + (k - c) * (k - c)));
+	return voxels;
+}
+
+static struct meshmaker_volume volume_of(const vector<float>& voxels) {
+	struct meshmaker_volume volume;
+	volume.voxels = &voxels[0];
+	for (int a = 0; a < 3; a++) {
+		volume.dims[a] = N;
+		volume.spacing[a] = 1.0;
+		volume.origin[a] = 0.0;
+	}
+	return volume;
+}
+
+static meshmaker_result *run(const struct meshmaker_volume& volume, const vector<const char *>& args, string& error,
+		int (*progress)(void *, const char *, int) = NULL, void *user = NULL) {
+	char reason[256] = "";
+	meshmaker_result *result = meshmaker_run(&volume, (int)args.size(), args.empty() ? NULL : &args[0], progress, user, reason, sizeof(reason));
+	error = reason;
+	return result;
+}
+
+// whether mesh is a closed surface of genus 0 whose indices are all in range and whose points lie
+// within a voxel of radius around the centre
+static int closed_sphere(const struct meshmaker_mesh& mesh, double radius) {
+	if (mesh.npoints <= 0 || mesh.ntriangles <= 0 || mesh.points == NULL || mesh.triangles == NULL)
+		return 0;
+	map<pair<int64_t, int64_t>, int> edges;
+	vector<char> used(mesh.npoints, 0);
+	int64_t nused = 0;
+	for (int64_t t = 0; t < mesh.ntriangles; t++)
+		for (int k = 0; k < 3; k++) {
+			int64_t a = mesh.triangles[3 * t + k], b = mesh.triangles[3 * t + (k + 1) % 3];
+			if (a < 0 || a >= mesh.npoints || b < 0 || b >= mesh.npoints)
+				return 0;
+			nused += !used[a];
+			used[a] = 1;
+			edges[make_pair(min(a, b), max(a, b))]++;
+		}
+	for (map<pair<int64_t, int64_t>, int>::const_iterator e = edges.begin(); e != edges.end(); ++e)
+		if (e->second != 2)
+			return 0;
+	if (nused - (int64_t)edges.size() + mesh.ntriangles != 2)
+		return 0;
+	double c = 0.5 * (N - 1);
+	for (int64_t p = 0; p < mesh.npoints; p++) {
+		const float *x = mesh.points + 3 * p;
+		double r = sqrt((x[0] - c) * (x[0] - c) + (x[1] - c) * (x[1] - c) + (x[2] - c) * (x[2] - c));
+		if (used[p] && fabs(r - radius) > 1.0)
+			return 0;
+	}
+	return 1;
+}
+
+static void test_sphere(void) {
+	vector<float> voxels = sphere_voxels(), original = voxels;
+	struct meshmaker_volume volume = volume_of(voxels);
+	string error;
+	meshmaker_result *result = run(volume, {"-c", "4", "-N"}, error);
+	CHECK(result != NULL);
+	CHECK(error.empty());
+	CHECK(meshmaker_count(result) == 1);
+	struct meshmaker_mesh mesh;
+	CHECK(meshmaker_get(result, 0, &mesh) == 0);
+	CHECK(meshmaker_get(result, 1, &mesh) != 0);
+	CHECK(meshmaker_get(result, 0, &mesh) == 0 && closed_sphere(mesh, 6.0));
+	CHECK(mesh.has_level && mesh.clevel == 4.0 && mesh.lod == -1);
+	CHECK(mesh.normals != NULL);
+	meshmaker_free(result);
+
+	// the voxels are borrowed, never written to, even by a filter that runs in place on a map it reads
+	result = run(volume, {"-c", "4", "--gaussian", "1.0", "-s"}, error);
+	CHECK(result != NULL && meshmaker_count(result) == 1);
+	CHECK(meshmaker_get(result, 0, &mesh) == 0 && closed_sphere(mesh, 6.0));
+	CHECK(memcmp(&voxels[0], &original[0], voxels.size() * sizeof(float)) == 0);
+	meshmaker_free(result);
+}
+
+static void test_levels(void) {
+	vector<float> voxels = sphere_voxels();
+	struct meshmaker_volume volume = volume_of(voxels);
+	string error;
+	meshmaker_result *result = run(volume, {"-c", "2,4"}, error);
+	CHECK(result != NULL && meshmaker_count(result) == 2);
+	map<double, double> radius;
+	radius[2.0] = 8.0;
+	radius[4.0] = 6.0;
+	int found = 0;
+	for (int i = 0; i < meshmaker_count(result); i++) {
+		struct meshmaker_mesh mesh;
+		CHECK(meshmaker_get(result, i, &mesh) == 0);
+		CHECK(mesh.has_level && radius.count(mesh.clevel) == 1);
+		if (mesh.has_level && radius.count(mesh.clevel) == 1) {
+			CHECK(closed_sphere(mesh, radius[mesh.clevel]));
+			found += mesh.clevel == 2.0 ? 1 : 2;
+		}
+	}
+	CHECK(found == 3);
+	meshmaker_free(result);
+
+	// with -1 they come back together
+	result = run(volume, {"-c", "2,4", "-1"}, error);
+	CHECK(result != NULL && meshmaker_count(result) == 1);
+	struct meshmaker_mesh mesh;
+	CHECK(meshmaker_get(result, 0, &mesh) == 0 && !mesh.has_level);
+	meshmaker_free(result);
+}
+
+static int cancel_at_once(void *user, const char *, int) {
+	(*static_cast<int *>(user))++;
+	return 1;
+}
+
+static void test_errors(void) {
+	vector<float> voxels = sphere_voxels();
+	struct meshmaker_volume volume = volume_of(voxels);
+	string error;
+	int calls = 0;
+	CHECK(run(volume, {"-c", "4", "-s"}, error, cancel_at_once, &calls) == NULL);
+	CHECK(calls > 0);
+	CHECK(error.find("cancelled") == 0);
+
+	CHECK(run(volume, {"-c", "4", "--quantize"}, error) == NULL && !error.empty());
+	CHECK(run(volume, {"-c", "4", "--distributed", "merge"}, error) == NULL && !error.empty());
+	CHECK(run(volume, {"-c", "4", "other.map"}, error) == NULL && !error.empty());
+	struct meshmaker_volume empty = volume;
+	empty.voxels = NULL;
+	CHECK(run(empty, {"-c", "4"}, error) == NULL && !error.empty());
+	CHECK(meshmaker_count(NULL) == 0);
+	meshmaker_free(NULL);
+
+	int thrown = 0;
+	try {
+		meshmaker_run(volume, vector<string>(1, "--quantize"));
+	}
+	catch (invalid_argument& e) {
+		thrown = 1;
+	}
+	CHECK(thrown);
+}
+
+// calls on threads of their own give the same meshes as one after the other
+static void test_threads(void) {
+	vector<float> voxels = sphere_voxels();
+	struct meshmaker_volume volume = volume_of(voxels);
+	const char *levels[2] = {"2", "4"};
+	int64_t serial[2], concurrent[2] = {-1, -1};
+	for (int t = 0; t < 2; t++) {
+		shared_ptr<meshmaker_result> result = meshmaker_run(volume, {"-c", levels[t], "-s"});
+		struct meshmaker_mesh mesh;
+		serial[t] = meshmaker_get(result.get(), 0, &mesh) == 0 ? mesh.ntriangles : -1;
+	}
+	int closed[2] = {0, 0};
+	vector<thread> threads;
+	for (int t = 0; t < 2; t++)
+		threads.push_back(thread([&, t]() {
+			string error;
+			meshmaker_result *result = run(volume, {"-c", levels[t], "-s"}, error);
+			struct meshmaker_mesh mesh;
+			if (meshmaker_get(result, 0, &mesh) == 0) {
+				concurrent[t] = mesh.ntriangles;
+				closed[t] = closed_sphere(mesh, t == 0 ? 8.0 : 6.0);
+			}
+			meshmaker_free(result);
+		}));
+	for (size_t t = 0; t < threads.size(); t++)
+		threads[t].join();
+	for (int t = 0; t < 2; t++) {
+		CHECK(serial[t] > 0 && concurrent[t] == serial[t]);
+		CHECK(closed[t]);
+	}
+}
+
+int main(void) {
+	test_sphere();
+	test_levels();
+	test_errors();
+	test_threads();
+	return check_result();
+}
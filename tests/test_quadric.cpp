@@ -0,0 +1,138 @@
+/*
+ * test_quadric
+ *
+ * Quadric edge collapse: flat grids stay flat down to the target, locked
+ * and border vertices survive where they were, and decimated spheres stay
+ * closed, on the sphere and near the target with any number of partitions
+ *
+ * License: Apache
+ */
+
+// standard headers
+#include <cmath>
+#include <cstdint>
+#include <set>
+#include <vector>
+
+// VTK headers
+#include "vtkSmartPointer.h"
+#include "vtkPolyData.h"
+
+#include "quadric.h"
+#include "check.h"
+#include "meshes.h"
+
+using namespace std;
+
+// a flat grid of n x n squares in z = 0, two triangles each
+static void flat_grid(int n, vector<double>& pos, vector<uint32_t>& tris) {
+	pos.clear();
+	tris.clear();
+	for (int j = 0; j <= n; j++)
+		for (int i = 0; i <= n; i++) {
+			pos.push_back(i);
+			pos.push_back(j);
+			pos.push_back(0.0);
+		}
+	for (int j = 0; j < n; j++)
+		for (int i = 0; i < n; i++) {
+			uint32_t a = j * (n + 1) + i, b = a + 1, c = a + n + 1, d = c + 1;
+			uint32_t quad[6] = {a, b, d, a, d, c};
+			tris.insert(tris.end(), quad, quad + 6);
+		}
+}
+
+static void test_collapse(void) {
+	int n = 20;
+	vector<double> pos, original;
+	vector<uint32_t> tris;
+	flat_grid(n, pos, tris);
+	original = pos;
+	size_t nt = tris.size() / 3, nv = pos.size() / 3;
+	vector<uint8_t> locked(nv, 0);
+	// the centre
+	uint32_t centre = (n / 2) * (n + 1) + n / 2;
+	locked[centre] = 1;
+	quadric_collapse(pos, tris, locked, nt / 4, 1);
+	CHECK(tris.size() % 3 == 0);
+	CHECK(tris.size() / 3 <= nt / 4 + nt / 40);
+	CHECK(tris.size() / 3 > 0);
+
+	set<uint32_t> used(tris.begin(), tris.end());
+	int flat = 1, kept = 1;
+	for (set<uint32_t>::const_iterator v = used.begin(); v != used.end(); ++v)
+		flat = flat && pos[3 * *v + 2] == 0.0;
+	// the border of the grid and the locked centre are where they were
+	for (int j = 0; j <= n; j++)
+		for (int i = 0; i <= n; i++) {
+			uint32_t v = j * (n + 1) + i;
+			if (i != 0 && i != n && j != 0 && j != n && v != centre)
+				continue;
+			kept = kept && used.count(v) == 1;
+			for (int a = 0; a < 3; a++)
+				kept = kept && pos[3 * v + a] == original[3 * v + a];
+		}
+	CHECK(flat);
+	CHECK(kept);
+
+	// no triangle is folded over: all still face +z
+	int facing = 1;
+	for (size_t t = 0; t < tris.size(); t += 3) {
+		const double *a = &pos[3 * tris[t]], *b = &pos[3 * tris[t + 1]], *c = &pos[3 * tris[t + 2]];
+		facing = facing && (b[0] - a[0]) * (c[1] - a[1]) - (b[1] - a[1]) * (c[0] - a[0]) > 0.0;
+	}
+	CHECK(facing);
+
+	// nothing to do at or above the target
+	flat_grid(4, pos, tris);
+	vector<uint32_t> before = tris;
+	quadric_collapse(pos, tris, vector<uint8_t>(pos.size() / 3, 0), tris.size() / 3, 0);
+	CHECK(tris == before);
+}
+
+static void test_sphere(void) {
+	vtkSmartPointer<vtkPolyData> sphere = sphere_mesh(1.0, 48);
+	vtkIdType polys = sphere->GetNumberOfPolys();
+	for (int partitions = 1; partitions <= 4; partitions += 3) {
+		vtkSmartPointer<vtkPolyData> decimated = quadric_decimate(sphere, 0.8, 0, partitions);
+		CHECK(decimated->GetNumberOfPolys() <= 0.21 * polys);
+		CHECK(decimated->GetNumberOfPolys() >= 0.1 * polys);
+		CHECK(is_closed_sphere(decimated));
+		int near = 1;
+		for (vtkIdType p = 0; p < decimated->GetNumberOfPoints(); p++) {
+			double r = point_distance(decimated, p);
+			near = near && r > 0.97 && r < 1.01;
+		}
+		CHECK(near);
+	}
+}
+
+static void test_border(void) {
+	vtkSmartPointer<vtkPolyData> sheet = sheet_mesh(40, 0.05);
+	set<vtkIdType> border = border_points(sheet);
+	vtkSmartPointer<vtkPolyData> decimated = quadric_decimate(sheet, 0.7, 1, 1);
+	CHECK(decimated->GetNumberOfPolys() < sheet->GetNumberOfPolys());
+	// the border points are all still there, and still on the border
+	set<vtkIdType> kept = border_points(decimated);
+	CHECK(kept.size() == border.size());
+	set<vector<double> > corners;
+	for (set<vtkIdType>::const_iterator p = kept.begin(); p != kept.end(); ++p) {
+		double x[3];
+		decimated->GetPoint(*p, x);
+		corners.insert(vector<double>(x, x + 3));
+	}
+	int found = 1;
+	for (set<vtkIdType>::const_iterator p = border.begin(); p != border.end(); ++p) {
+		double x[3];
+		sheet->GetPoint(*p, x);
+		found = found && corners.count(vector<double>(x, x + 3)) == 1;
+	}
+	CHECK(found);
+}
+
+int main(void) {
+	test_collapse();
+	test_sphere();
+	test_border();
+	return check_result();
+}
@@ -0,0 +1,142 @@
+/*
+ * test_server
+ *
+ * Requests of server mode: ids, args and escapes that are accepted, the
+ * malformed lines that are refused, and one response for every line
+ *
+ * License: Apache
+ */
+
+// standard headers
+#include <set>
+#include <sstream>
+#include <string>
+
+#include "server.h"
+#include "check.h"
+
+using namespace std;
+
+// the request of line, which must parse
+static struct server_request parsed(const string& line) {
+	struct server_request req;
+	string error;
+	CHECK(server_parse(line, req, error) == 0);
+	CHECK(error.empty());
+	return req;
+}
+
+// the error of line, which must not parse
+static string refused(const string& line) {
+	struct server_request req;
+	string error;
+	CHECK(server_parse(line, req, error) != 0);
+	CHECK(!error.empty());
+	return error;
+}
+
+static void test_ids(void) {
+	CHECK(parsed("{\"id\": 7, \"args\": []}").id == "7");
+	CHECK(parsed("{\"id\": -12, \"args\": []}").id == "-12");
+	CHECK(parsed("{\"id\": 2.5e1, \"args\": []}").id == "25");
+	CHECK(parsed("{\"id\": \"job \\\"a\\\"\", \"args\": []}").id == "\"job \\\"a\\\"\"");
+	CHECK(parsed("{\"id\": null, \"args\": []}").id == "null");
+	// no id is a null one
+	CHECK(parsed("{\"args\": []}").id == "null");
+	// ids are re-encoded, so control characters never reach a response raw
+	CHECK(parsed("{\"id\": \"a\\nb\", \"args\": []}").id == "\"a\\u000ab\"");
+
+	refused("{\"id\": true, \"args\": []}");
+	refused("{\"id\": [1], \"args\": []}");
+	refused("{\"id\": 01, \"args\": []}");
+	refused("{\"id\": 1., \"args\": []}");
+	refused("{\"id\": -, \"args\": []}");
+	refused("{\"id\": 1e, \"args\": []}");
+}
+
+static void test_args(void) {
+	struct server_request req = parsed(" { \"args\" : [ \"-c\" , \"0.5\", \"emd_1234.map\" ] , \"id\" : 1 } ");
+	CHECK(req.args.size() == 3);
+	CHECK(req.args.size() == 3 && req.args[0] == "-c" && req.args[1] == "0.5" && req.args[2] == "emd_1234.map");
+	CHECK(req.id == "1");
+	CHECK(parsed("{\"args\": []}").args.empty());
+
+	// escapes, including a character beyond the BMP as a surrogate pair, come out as UTF-8
+	req = parsed("{\"args\": [\"a\\tb\", \"\\\\share\\/maps\", \"\\u00e9\", \"\\u20ac\", \"\\ud83d\\ude00\"]}");
+	CHECK(req.args.size() == 5);
+	if (req.args.size() == 5) {
+		CHECK(req.args[0] == "a\tb");
+		CHECK(req.args[1] == "\\share/maps");
+		CHECK(req.args[2] == "\xc3\xa9");
+		CHECK(req.args[3] == "\xe2\x82\xac");
+		CHECK(req.args[4] == "\xf0\x9f\x98\x80");
+	}
+
+	// other members are skipped over, whatever they hold
+	req = parsed("{\"meta\": {\"tags\": [\"a]\", {\"b\": \"}\"}]}, \"n\": 3, \"ok\": false, \"args\": [\"x.map\"]}");
+	CHECK(req.args.size() == 1 && req.args[0] == "x.map");
+
+	CHECK(refused("{\"id\": 1}") == "no args");
+	CHECK(refused("{}") == "no args");
+	refused("{\"args\": [1, 2]}");
+	refused("{\"args\": \"-c 0.5\"}");
+	refused("{\"args\": [\"a\" \"b\"]}");
+	refused("{\"args\": [\"a\",]}");
+	refused("{\"args\": [\"a\"}");
+}
+
+static void test_malformed(void) {
+	refused("");
+	refused("[\"args\"]");
+	refused("{\"args\": [\"unterminated]}");
+	refused("{\"args\": [\"a\"] \"id\": 1}");
+	refused("{args: []}");
+	refused("{\"args\": []");
+	refused("{\"meta\": {\"a\": [1, 2}, \"args\": []");
+	refused("{\"args\": [\"\\u12\"]}");
+	refused("{\"args\": [\"\\u12zz\"]}");
+	refused("{\"args\": [\"\\ud83d\"]}");
+	refused("{\"args\": [\"\\ud83dx\"]}");
+	refused("{\"args\": [\"\\ude00\"]}");
+
+	// an id read before the error still goes into its response
+	struct server_request req;
+	string error;
+	CHECK(server_parse("{\"id\": 9, \"args\": [3]}", req, error) != 0);
+	CHECK(req.id == "9");
+}
+
+static void test_responses(void) {
+	struct server_request req;
+	req.id = "\"a\"";
+	CHECK(server_response(req, "", 0.5) == "{\"id\": \"a\", \"status\": \"ok\", \"wall_s\": 0.5}");
+	CHECK(server_response(req, "bad \"map\"", 0) == "{\"id\": \"a\", \"status\": \"error\", \"error\": \"bad \\\"map\\\"\", \"wall_s\": 0}");
+
+	// every line but blank ones is answered once, malformed or not
+	istringstream in("{\"id\": 1, \"args\": [\"a\"]}\n\n{\"id\": 2, \"args\": [\"b\"]}\nnot json\n  \n{\"id\": 3, \"args\": [\"c\"]}\n");
+	ostringstream out;
+	server_run(in, out, 2, 1, [](const struct server_request& r) {
+		return server_response(r, r.args[0] == "b" ? "failed" : "", 0.0);
+	});
+	istringstream lines(out.str());
+	string line;
+	multiset<string> responses;
+	while (getline(lines, line))
+		responses.insert(line);
+	CHECK(responses.size() == 4);
+	CHECK(responses.count("{\"id\": 1, \"status\": \"ok\", \"wall_s\": 0}") == 1);
+	CHECK(responses.count("{\"id\": 2, \"status\": \"error\", \"error\": \"failed\", \"wall_s\": 0}") == 1);
+	CHECK(responses.count("{\"id\": 3, \"status\": \"ok\", \"wall_s\": 0}") == 1);
+	int invalid = 0;
+	for (multiset<string>::const_iterator r = responses.begin(); r != responses.end(); ++r)
+		invalid += r->find("{\"id\": null, \"status\": \"error\", \"error\": \"invalid request: ") == 0;
+	CHECK(invalid == 1);
+}
+
+int main(void) {
+	test_ids();
+	test_args();
+	test_malformed();
+	test_responses();
+	return check_result();
+}
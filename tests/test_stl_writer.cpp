@@ -0,0 +1,166 @@
+/*
+ * test_stl_writer
+ *
+ * Binary STL of triangles, strips and quads: the same facets as
+ * vtkSTLWriter, the same file to a stream as to a path, and the same
+ * surface once read back by vtkSTLReader
+ *
+ * License: Apache
+ */
+
+// standard headers
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+// VTK headers
+#include "vtkSmartPointer.h"
+#include "vtkPlaneSource.h"
+#include "vtkPolyData.h"
+#include "vtkSTLReader.h"
+#include "vtkSTLWriter.h"
+#include "vtkStripper.h"
+
+#include "stl_writer.h"
+#include "check.h"
+#include "meshes.h"
+
+using namespace std;
+
+static const size_t STL_HEADER_SIZE = 80;
+static const size_t STL_FACET_SIZE = 50;
+
+static string read_bytes(const string& fn) {
+	ifstream in(fn.c_str(), ios::binary);
+	return string(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+}
+
+// the facet count of a binary STL, or -1 if its size does not match it (on a little-endian host)
+static long facet_count(const string& stl) {
+	if (stl.size() < STL_HEADER_SIZE + 4)
+		return -1;
+	uint32_t count;
+	memcpy(&count, stl.data() + STL_HEADER_SIZE, 4);
+	return stl.size() == STL_HEADER_SIZE + 4 + (size_t)count * STL_FACET_SIZE ? (long)count : -1;
+}
+
+// whether the facets of two binary STLs are the same: vertices exactly, normals to rounding
+static int same_facets(const string& a, const string& b) {
+	long n = facet_count(a);
+	if (n < 0 || n != facet_count(b))
+		return 0;
+	for (long f = 0; f < n; f++) {
+		float fa[12], fb[12];
+		memcpy(fa, a.data() + STL_HEADER_SIZE + 4 + f * STL_FACET_SIZE, sizeof(fa));
+		memcpy(fb, b.data() + STL_HEADER_SIZE + 4 + f * STL_FACET_SIZE, sizeof(fb));
+		for (int k = 0; k < 3; k++)
+			if (fabs(fa[k] - fb[k]) > 1e-6)
+				return 0;
+		if (memcmp(fa + 3, fb + 3, 9 * sizeof(float)) != 0)
+			return 0;
+	}
+	return 1;
+}
+
+static string vtk_stl(vtkPolyData *mesh) {
+	const string fn = "test_stl_writer_vtk.stl";
+	vtkSmartPointer<vtkSTLWriter> writer = vtkSmartPointer<vtkSTLWriter>::New();
+	writer->SetInputData(mesh);
+	writer->SetFileName(fn.c_str());
+	writer->SetFileTypeToBinary();
+	writer->Write();
+	string stl = read_bytes(fn);
+	remove(fn.c_str());
+	return stl;
+}
+
+// mesh written to a path, also checked against the same written to a stream
+static string our_stl(vtkPolyData *mesh) {
+	const string fn = "test_stl_writer.stl";
+	CHECK(stl_write(mesh, fn) == 0);
+	string stl = read_bytes(fn);
+	remove(fn.c_str());
+
+	char *data = NULL;
+	size_t n = 0;
+	FILE *out = open_memstream(&data, &n);
+	if (out != NULL) {
+		CHECK(stl_write(mesh, out, "stream") == 0);
+		fclose(out);
+		CHECK(string(data, n) == stl);
+		free(data);
+	}
+	return stl;
+}
+
+// the surface vtkSTLReader makes of stl, with the coincident points of its facets merged
+static vtkSmartPointer<vtkPolyData> read_stl(const string& stl) {
+	const string fn = "test_stl_writer_read.stl";
+	FILE *out = fopen(fn.c_str(), "wb");
+	if (out != NULL) {
+		fwrite(stl.data(), 1, stl.size(), out);
+		fclose(out);
+	}
+	vtkSmartPointer<vtkSTLReader> reader = vtkSmartPointer<vtkSTLReader>::New();
+	reader->SetFileName(fn.c_str());
+	reader->MergingOn();
+	vtkSmartPointer<vtkPolyData> mesh = mesh_of(reader.GetPointer());
+	remove(fn.c_str());
+	return mesh;
+}
+
+static void test_triangles(void) {
+	vtkSmartPointer<vtkPolyData> sphere = sphere_mesh(1.0, 24);
+	string stl = our_stl(sphere);
+	CHECK(facet_count(stl) == sphere->GetNumberOfPolys());
+	CHECK(same_facets(stl, vtk_stl(sphere)));
+	vtkSmartPointer<vtkPolyData> read = read_stl(stl);
+	CHECK(read->GetNumberOfPoints() == sphere->GetNumberOfPoints());
+	CHECK(read->GetNumberOfPolys() == sphere->GetNumberOfPolys());
+	CHECK(is_closed_sphere(read));
+}
+
+static void test_strips(void) {
+	vtkSmartPointer<vtkPolyData> sphere = sphere_mesh(1.0, 24);
+	vtkSmartPointer<vtkStripper> stripper = vtkSmartPointer<vtkStripper>::New();
+	stripper->SetInputData(sphere);
+	vtkSmartPointer<vtkPolyData> strips = mesh_of(stripper.GetPointer());
+	CHECK(strips->GetNumberOfStrips() > 0);
+	string stl = our_stl(strips);
+	CHECK(facet_count(stl) == sphere->GetNumberOfPolys());
+	CHECK(same_facets(stl, vtk_stl(strips)));
+	CHECK(is_closed_sphere(read_stl(stl)));
+}
+
+// quads are split into fans, which vtkSTLWriter only matches in number
+static void test_quads(void) {
+	vtkSmartPointer<vtkPlaneSource> plane = vtkSmartPointer<vtkPlaneSource>::New();
+	plane->SetResolution(5, 4);
+	vtkSmartPointer<vtkPolyData> quads = mesh_of(plane.GetPointer());
+	string stl = our_stl(quads);
+	CHECK(facet_count(stl) == 2 * 5 * 4);
+	CHECK(facet_count(vtk_stl(quads)) == 2 * 5 * 4);
+	vtkSmartPointer<vtkPolyData> read = read_stl(stl);
+	CHECK(read->GetNumberOfPoints() == quads->GetNumberOfPoints());
+	CHECK(border_points(read).size() == 2 * (5 + 4));
+}
+
+// no facets is still a valid file
+static void test_empty(void) {
+	vtkSmartPointer<vtkPolyData> empty = vtkSmartPointer<vtkPolyData>::New();
+	CHECK(facet_count(our_stl(empty)) == 0);
+}
+
+int main(void) {
+	test_triangles();
+	test_strips();
+	test_quads();
+	test_empty();
+	return check_result();
+}
@@ -0,0 +1,101 @@
+/*
+ * test_volume
+ *
+ * The min/max grid of -E on an extent that is a whole number of blocks:
+ * the voxels on the face between two blocks count for both, but a level
+ * only crossed on one side of it is never seen from the other
+ *
+ * License: Apache
+ */
+
+// standard headers
+#include <vector>
+
+#include "volume.h"
+#include "check.h"
+
+using namespace std;
+
+// a float32 volume of dims voxels holding value(i, j, k)
+template <class F>
+static struct volume float_volume(const int dims[3], vector<float>& voxels, F value) {
+	struct volume vol;
+	voxels.resize((size_t)dims[0] * dims[1] * dims[2]);
+	for (int k = 0; k < dims[2]; k++)
+		for (int j = 0; j < dims[1]; j++)
+			for (int i = 0; i < dims[0]; i++)
+				voxels[((size_t)k * dims[1] + j) * dims[0] + i] = value(i, j, k);
+	for (int a = 0; a < 3; a++)
+		vol.dims[a] = dims[a];
+	vol.mode = 2;
+	vol.voxel_size = 4;
+	vol.data = reinterpret_cast<const unsigned char *>(&voxels[0]);
+	return vol;
+}
+
+static int straddles(const struct volume_ranges& ranges, int x0, int x1, float level) {
+	int extent[6] = {x0, x1, ranges.extent[2], ranges.extent[3], ranges.extent[4], ranges.extent[5]};
+	return volume_ranges_straddle(ranges, extent, vector<float>(1, level));
+}
+
+// a ramp along x over exactly two blocks of 32 voxels: x = 0..64
+static void test_ramp(void) {
+	int dims[3] = {65, 3, 3};
+	vector<float> voxels;
+	struct volume vol = float_volume(dims, voxels, [](int i, int, int) { return (float)i; });
+	int whole[6] = {0, 64, 0, 2, 0, 2};
+	struct volume_ranges ranges;
+	volume_ranges_build(vol, whole, 32, ranges);
+	CHECK(ranges.nblocks[0] == 2 && ranges.nblocks[1] == 1 && ranges.nblocks[2] == 1);
+	CHECK(ranges.lo.size() == 2 && ranges.hi.size() == 2);
+	if (ranges.lo.size() != 2)
+		return;
+	// voxel 32 is the last of block 0 and the first of block 1
+	CHECK(ranges.lo[0] == 0.0f && ranges.hi[0] == 32.0f);
+	CHECK(ranges.lo[1] == 32.0f && ranges.hi[1] == 64.0f);
+
+	int block[6];
+	volume_ranges_block(ranges, 1, 0, 0, block);
+	CHECK(block[0] == 32 && block[1] == 64);
+
+	// the cells of each block lie on its own side of the face
+	CHECK(straddles(ranges, 0, 32, 16.0f));
+	CHECK(!straddles(ranges, 0, 32, 48.0f));
+	CHECK(straddles(ranges, 32, 64, 48.0f));
+	CHECK(!straddles(ranges, 32, 64, 16.0f));
+	// a level on the face is crossed on both sides, and extents over it see both blocks
+	CHECK(straddles(ranges, 0, 32, 32.0f));
+	CHECK(straddles(ranges, 32, 64, 32.0f));
+	CHECK(straddles(ranges, 31, 33, 16.0f));
+	CHECK(straddles(ranges, 31, 33, 48.0f));
+	// the face alone lies in the block it starts
+	CHECK(!straddles(ranges, 32, 32, 16.0f));
+	CHECK(straddles(ranges, 32, 32, 48.0f));
+	// outside the grid or its values
+	CHECK(!straddles(ranges, 65, 80, 48.0f));
+	CHECK(!straddles(ranges, 0, 64, 65.0f));
+	CHECK(!straddles(ranges, 0, 64, -1.0f));
+}
+
+// a bump in one corner block of a 2 x 2 x 2 grid is only seen by the extents that reach into it
+static void test_corner(void) {
+	int dims[3] = {33, 33, 33};
+	vector<float> voxels;
+	struct volume vol = float_volume(dims, voxels, [](int i, int j, int k) { return i > 16 && j > 16 && k > 16 ? 1.0f : 0.0f; });
+	int whole[6] = {0, 32, 0, 32, 0, 32};
+	struct volume_ranges ranges;
+	volume_ranges_build(vol, whole, 16, ranges);
+	CHECK(ranges.nblocks[0] == 2 && ranges.nblocks[1] == 2 && ranges.nblocks[2] == 2);
+	vector<float> half(1, 0.5f);
+	int corner[6] = {16, 32, 16, 32, 16, 32}, near[6] = {0, 16, 0, 16, 0, 16}, side[6] = {0, 32, 0, 16, 0, 32};
+	CHECK(volume_ranges_straddle(ranges, whole, half));
+	CHECK(volume_ranges_straddle(ranges, corner, half));
+	CHECK(!volume_ranges_straddle(ranges, near, half));
+	CHECK(!volume_ranges_straddle(ranges, side, half));
+}
+
+int main(void) {
+	test_ramp();
+	test_corner();
+	return check_result();
+}
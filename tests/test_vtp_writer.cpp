@@ -0,0 +1,216 @@
+/*
+ * test_vtp_writer
+ *
+ * VTP files of a sphere with point, cell and field data, written with each
+ * compressor and header, id and alignment option to a file and to a stream,
+ * read back by vtkXMLPolyDataReader with the same points, cells and arrays
+ *
+ * License: Apache
+ */
+
+// standard headers
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+// VTK headers
+#include "vtkSmartPointer.h"
+#include "vtkCellArray.h"
+#include "vtkCellData.h"
+#include "vtkDoubleArray.h"
+#include "vtkFieldData.h"
+#include "vtkFloatArray.h"
+#include "vtkIdList.h"
+#include "vtkIntArray.h"
+#include "vtkPointData.h"
+#include "vtkPolyData.h"
+#include "vtkUnsignedShortArray.h"
+#include "vtkXMLPolyDataReader.h"
+
+#include "vtp_writer.h"
+#include "check.h"
+#include "meshes.h"
+
+using namespace std;
+
+// a sphere with the kinds of arrays meshmaker writes: normals and levels of the points, ids of
+// the cells and the contour values in the field data
+static vtkSmartPointer<vtkPolyData> sphere_with_arrays(void) {
+	vtkSmartPointer<vtkPolyData> mesh = sphere_mesh(1.0, 24);
+	vtkIdType npts = mesh->GetNumberOfPoints(), ncells = mesh->GetNumberOfPolys();
+	vtkSmartPointer<vtkFloatArray> normals = vtkSmartPointer<vtkFloatArray>::New();
+	normals->SetName("Normals");
+	normals->SetNumberOfComponents(3);
+	normals->SetNumberOfTuples(npts);
+	vtkSmartPointer<vtkUnsignedShortArray> levels = vtkSmartPointer<vtkUnsignedShortArray>::New();
+	levels->SetName("level");
+	levels->SetNumberOfTuples(npts);
+	for (vtkIdType p = 0; p < npts; p++) {
+		double x[3];
+		mesh->GetPoint(p, x);
+		normals->SetTuple3(p, x[0], x[1], x[2]);
+		levels->SetTuple1(p, p % 3);
+	}
+	vtkSmartPointer<vtkIntArray> ids = vtkSmartPointer<vtkIntArray>::New();
+	ids->SetName("id");
+	ids->SetNumberOfTuples(ncells);
+	for (vtkIdType c = 0; c < ncells; c++)
+		ids->SetTuple1(c, ncells - c);
+	vtkSmartPointer<vtkDoubleArray> contours = vtkSmartPointer<vtkDoubleArray>::New();
+	contours->SetName("contour");
+	contours->SetNumberOfTuples(3);
+	for (int l = 0; l < 3; l++)
+		contours->SetTuple1(l, 0.5 + l);
+	mesh->GetPointData()->AddArray(normals);
+	mesh->GetPointData()->AddArray(levels);
+	mesh->GetCellData()->AddArray(ids);
+	mesh->GetFieldData()->AddArray(contours);
+	return mesh;
+}
+
+// whether b is a copy of a (of the same type)
+static int same_array(vtkDataArray *a, vtkDataArray *b) {
+	if (a == NULL || b == NULL || a->GetDataType() != b->GetDataType() || a->GetNumberOfComponents() != b->GetNumberOfComponents()
+			|| a->GetNumberOfTuples() != b->GetNumberOfTuples())
+		return 0;
+	for (vtkIdType t = 0; t < a->GetNumberOfTuples(); t++)
+		for (int c = 0; c < a->GetNumberOfComponents(); c++)
+			if (a->GetComponent(t, c) != b->GetComponent(t, c))
+				return 0;
+	return 1;
+}
+
+// whether b has the points, polygons and arrays of a
+static int same_mesh(vtkPolyData *a, vtkPolyData *b) {
+	if (a->GetNumberOfPoints() != b->GetNumberOfPoints() || a->GetNumberOfPolys() != b->GetNumberOfPolys()
+			|| a->GetNumberOfCells() != b->GetNumberOfCells())
+		return 0;
+	if (!same_array(a->GetPoints()->GetData(), b->GetPoints()->GetData()))
+		return 0;
+	vtkSmartPointer<vtkIdList> ida = vtkSmartPointer<vtkIdList>::New(), idb = vtkSmartPointer<vtkIdList>::New();
+	vtkCellArray *pa = a->GetPolys(), *pb = b->GetPolys();
+	pa->InitTraversal();
+	pb->InitTraversal();
+	while (pa->GetNextCell(ida)) {
+		if (!pb->GetNextCell(idb) || ida->GetNumberOfIds() != idb->GetNumberOfIds())
+			return 0;
+		for (vtkIdType k = 0; k < ida->GetNumberOfIds(); k++)
+			if (ida->GetId(k) != idb->GetId(k))
+				return 0;
+	}
+	return same_array(a->GetPointData()->GetArray("Normals"), b->GetPointData()->GetArray("Normals"))
+		&& same_array(a->GetPointData()->GetArray("level"), b->GetPointData()->GetArray("level"))
+		&& same_array(a->GetCellData()->GetArray("id"), b->GetCellData()->GetArray("id"))
+		&& same_array(a->GetFieldData()->GetArray("contour"), b->GetFieldData()->GetArray("contour"));
+}
+
+static vtkSmartPointer<vtkPolyData> read_file(const string& fn) {
+	vtkSmartPointer<vtkXMLPolyDataReader> reader = vtkSmartPointer<vtkXMLPolyDataReader>::New();
+	reader->SetFileName(fn.c_str());
+	vtkSmartPointer<vtkPolyData> mesh = mesh_of(reader.GetPointer());
+	CHECK(reader->GetErrorCode() == 0);
+	return mesh;
+}
+
+static vtkSmartPointer<vtkPolyData> read_string(const string& data) {
+	vtkSmartPointer<vtkXMLPolyDataReader> reader = vtkSmartPointer<vtkXMLPolyDataReader>::New();
+	reader->ReadFromInputStringOn();
+	reader->SetInputString(data);
+	vtkSmartPointer<vtkPolyData> mesh = mesh_of(reader.GetPointer());
+	CHECK(reader->GetErrorCode() == 0);
+	return mesh;
+}
+
+// mesh written with opts to a stream
+static string vtp_of(vtkPolyData *mesh, const struct vtp_options& opts) {
+	char *data = NULL;
+	size_t n = 0;
+	FILE *out = open_memstream(&data, &n);
+	if (out == NULL)
+		return "";
+	int written = vtp_write(mesh, out, "stream", opts) == 0;
+	fclose(out);
+	string vtp = written ? string(data, n) : string();
+	free(data);
+	return vtp;
+}
+
+// mesh written with opts to a file and to a stream reads back the same both ways
+static int round_trip(vtkPolyData *mesh, const struct vtp_options& opts) {
+	const string fn = "test_vtp_writer.vtp";
+	int same = vtp_write(mesh, fn, opts) == 0 && same_mesh(mesh, read_file(fn));
+	remove(fn.c_str());
+	string vtp = vtp_of(mesh, opts);
+	return same && !vtp.empty() && same_mesh(mesh, read_string(vtp));
+}
+
+// the number of arrays of vtp whose data (after the byte count of a raw array, of header bytes) or
+// whose header (of a compressed array) starts at a multiple of align in the file, or -1 if one
+// does not
+static int aligned_arrays(const string& vtp, size_t align, size_t header) {
+	size_t marker = vtp.find("<AppendedData encoding=\"raw\">");
+	marker = marker != string::npos ? vtp.find('_', marker) : string::npos;
+	if (marker == string::npos || (marker + 1) % align != 0)
+		return -1;
+	int compressed = vtp.find("compressor=") < marker;
+	int narrays = 0;
+	const string key = " offset=\"";
+	for (size_t at = vtp.find(key); at < marker; at = vtp.find(key, at + 1)) {
+		size_t offset = strtoull(vtp.c_str() + at + key.size(), NULL, 10);
+		if ((marker + 1 + offset + (compressed ? 0 : header)) % align != 0)
+			return -1;
+		narrays++;
+	}
+	return narrays;
+}
+
+static void test_round_trips(void) {
+	vtkSmartPointer<vtkPolyData> mesh = sphere_with_arrays();
+	const char *compressors[] = {"none", "zlib", "lz4", "lzma"};
+	for (int c = 0; c < 4; c++) {
+		struct vtp_options opts;
+		opts.compressor = compressors[c];
+		CHECK(round_trip(mesh, opts));
+		// many blocks, the last of them short
+		struct vtp_options blocks = opts;
+		blocks.block_size = 1000;
+		blocks.level = 9;
+		CHECK(round_trip(mesh, blocks));
+		struct vtp_options int32 = opts;
+		int32.int32 = 1;
+		CHECK(round_trip(mesh, int32));
+		struct vtp_options uint64 = opts;
+		uint64.uint64 = 1;
+		CHECK(round_trip(mesh, uint64));
+		struct vtp_options align = opts;
+		align.align = 4096;
+		align.int32 = 1;
+		CHECK(round_trip(mesh, align));
+		// the contour values, 2 point arrays, 1 cell array, the points, and the offsets and
+		// connectivity of 4 kinds of cells
+		CHECK(aligned_arrays(vtp_of(mesh, align), 4096, 4) == 13);
+		align.uint64 = 1;
+		align.align = 64;
+		CHECK(aligned_arrays(vtp_of(mesh, align), 64, 8) == 13);
+	}
+}
+
+// a surface without any points is still a valid file
+static void test_empty(void) {
+	vtkSmartPointer<vtkPolyData> empty = vtkSmartPointer<vtkPolyData>::New();
+	empty->SetPoints(vtkSmartPointer<vtkPoints>::New());
+	empty->SetPolys(vtkSmartPointer<vtkCellArray>::New());
+	struct vtp_options opts;
+	const string fn = "test_vtp_writer_empty.vtp";
+	CHECK(vtp_write(empty, fn, opts) == 0);
+	vtkSmartPointer<vtkPolyData> read = read_file(fn);
+	CHECK(read->GetNumberOfPoints() == 0 && read->GetNumberOfCells() == 0);
+	remove(fn.c_str());
+}
+
+int main(void) {
+	test_round_trips();
+	test_empty();
+	return check_result();
+}
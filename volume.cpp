@@ -0,0 +1,410 @@
+/*
+ * volume
+ *
+ * Memory-mapped MRC/CCP4 voxels (see volume.h)
+ *
+ * License: Apache
+ */
+
+// standard headers
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <cstdint>
+#include <climits>
+#include <iostream>
+#include <limits>
+#include <set>
+#include <vector>
+
+// POSIX headers
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// VTK headers
+#include "vtkFloatArray.h"
+#include "vtkPointData.h"
+#include "vtkSMPTools.h"
+
+#include "volume.h"
+
+using namespace std;
+
+// the MRC header is 256 4-byte words followed by nsymbt bytes of extended header
+static const size_t MRC_HEADER_SIZE = 1024;
+
+static uint32_t swap32(uint32_t v) {
+	return ((v & 0xff) << 24) | ((v & 0xff00) << 8) | ((v >> 8) & 0xff00) | (v >> 24);
+}
+
+// the header word at index w as an int/float, byte-swapped if required
+static int32_t header_int(const unsigned char *header, int w, int swap) {
+	uint32_t v;
+	memcpy(&v, header + 4 * w, 4);
+	if (swap)
+		v = swap32(v);
+	int32_t i;
+	memcpy(&i, &v, 4);
+	return i;
+}
+
+static float header_float(const unsigned char *header, int w, int swap) {
+	uint32_t v;
+	memcpy(&v, header + 4 * w, 4);
+	if (swap)
+		v = swap32(v);
+	float f;
+	memcpy(&f, &v, 4);
+	return f;
+}
+
+static int host_is_little_endian(void) {
+	uint16_t one = 1;
+	return *reinterpret_cast<unsigned char *>(&one) == 1;
+}
+
+int volume_map(struct volume& vol, const string& fn) {
+	vol = volume();
+	vol.fd = open(fn.c_str(), O_RDONLY);
+	if (vol.fd < 0) {
+		cerr << "Unable to open '" << fn << "': " << strerror(errno) << endl;
+		return -1;
+	}
+	struct stat st;
+	if (fstat(vol.fd, &st) != 0 || (size_t)st.st_size < MRC_HEADER_SIZE) {
+		cerr << "'" << fn << "' is too short to be an MRC/CCP4 file" << endl;
+		volume_unmap(vol);
+		return -1;
+	}
+	vol.map_len = st.st_size;
+	vol.map_addr = mmap(NULL, vol.map_len, PROT_READ, MAP_PRIVATE, vol.fd, 0);
+	if (vol.map_addr == MAP_FAILED) {
+		cerr << "Unable to map '" << fn << "': " << strerror(errno) << endl;
+		vol.map_addr = NULL;
+		volume_unmap(vol);
+		return -1;
+	}
+	// slabs are visited in order of z
+	madvise(vol.map_addr, vol.map_len, MADV_SEQUENTIAL);
+	const unsigned char *header = static_cast<const unsigned char *>(vol.map_addr);
+
+	// byte order from the machine stamp (0x44 little-endian, 0x11 big-endian); files without
+	// a stamp are assumed to be native unless the mode only makes sense swapped
+	int little = host_is_little_endian();
+	if (header[212] == 0x44 || header[212] == 0x11)
+		vol.swap = (header[212] == 0x44) != little;
+	else
+		vol.swap = (unsigned)header_int(header, 3, 0) > 16;
+
+	vol.mode = header_int(header, 3, vol.swap);
+	switch (vol.mode) {
+		case 0: vol.voxel_size = 1; break; // int8
+		case 1: vol.voxel_size = 2; break; // int16
+		case 2: vol.voxel_size = 4; break; // float32
+		case 6: vol.voxel_size = 2; break; // uint16
+		default:
+			cerr << "Unsupported MRC mode " << vol.mode << " in '" << fn << "'" << endl;
+			volume_unmap(vol);
+			return -1;
+	}
+
+	// same geometry as vtkMRCReader: voxel size from the cell dimensions and the sampling
+	for (int i = 0; i < 3; i++) {
+		vol.dims[i] = header_int(header, i, vol.swap);
+		int m = header_int(header, 7 + i, vol.swap);
+		float cell = header_float(header, 10 + i, vol.swap);
+		vol.spacing[i] = (m > 0 && cell > 0) ? cell / m : 1.0;
+		vol.origin[i] = header_float(header, 49 + i, vol.swap);
+	}
+	int nsymbt = header_int(header, 23, vol.swap);
+	size_t offset = MRC_HEADER_SIZE + (nsymbt > 0 ? nsymbt : 0);
+	size_t nvoxels = (size_t)vol.dims[0] * vol.dims[1] * vol.dims[2];
+	if (vol.dims[0] <= 0 || vol.dims[1] <= 0 || vol.dims[2] <= 0 || offset + nvoxels * vol.voxel_size > vol.map_len) {
+		cerr << "'" << fn << "' is truncated or has an invalid header" << endl;
+		volume_unmap(vol);
+		return -1;
+	}
+	vol.data = header + offset;
+	return 0;
+}
+
+int volume_wrap(struct volume& vol, vtkImageData *image) {
+	vol = volume();
+	switch (image->GetScalarType()) {
+		case VTK_CHAR:
+		case VTK_SIGNED_CHAR: vol.mode = 0; vol.voxel_size = 1; break;
+		case VTK_UNSIGNED_CHAR: vol.mode = 0; vol.voxel_size = 1; vol.unsigned_bytes = 1; break;
+		case VTK_SHORT: vol.mode = 1; vol.voxel_size = 2; break;
+		case VTK_FLOAT: vol.mode = 2; vol.voxel_size = 4; break;
+		case VTK_UNSIGNED_SHORT: vol.mode = 6; vol.voxel_size = 2; break;
+		default:
+			cerr << "Unsupported scalar type " << image->GetScalarType() << endl;
+			return -1;
+	}
+	// volume indices start at 0 so the origin moves to the first voxel of the extent
+	int extent[6];
+	image->GetExtent(extent);
+	double *spacing = image->GetSpacing(), *origin = image->GetOrigin();
+	for (int i = 0; i < 3; i++) {
+		vol.dims[i] = extent[2 * i + 1] - extent[2 * i] + 1;
+		vol.spacing[i] = spacing[i];
+		vol.origin[i] = origin[i] + extent[2 * i] * spacing[i];
+	}
+	vol.data = static_cast<const unsigned char *>(image->GetScalarPointer());
+	return 0;
+}
+
+void volume_unmap(struct volume& vol) {
+	if (vol.map_addr != NULL)
+		munmap(vol.map_addr, vol.map_len);
+	if (vol.fd >= 0)
+		close(vol.fd);
+	vol.map_addr = NULL;
+	vol.map_len = 0;
+	vol.fd = -1;
+	vol.data = NULL;
+}
+
+// the voxel at byte address p as a float
+static inline float voxel(const struct volume& vol, const unsigned char *p) {
+	switch (vol.mode) {
+		case 0:
+			if (vol.unsigned_bytes)
+				return (float)*p;
+			return (float)*reinterpret_cast<const signed char *>(p);
+		case 1: {
+			uint16_t v;
+			memcpy(&v, p, 2);
+			if (vol.swap)
+				v = (uint16_t)((v << 8) | (v >> 8));
+			int16_t s;
+			memcpy(&s, &v, 2);
+			return (float)s;
+		}
+		case 6: {
+			uint16_t v;
+			memcpy(&v, p, 2);
+			if (vol.swap)
+				v = (uint16_t)((v << 8) | (v >> 8));
+			return (float)v;
+		}
+		default: {
+			uint32_t v;
+			memcpy(&v, p, 4);
+			if (vol.swap)
+				v = swap32(v);
+			float f;
+			memcpy(&f, &v, 4);
+			return f;
+		}
+	}
+}
+
+vtkSmartPointer<vtkImageData> volume_block(const struct volume& vol, const int extent[6]) {
+	vtkSmartPointer<vtkImageData> block = vtkSmartPointer<vtkImageData>::New();
+	block->SetExtent(extent[0], extent[1], extent[2], extent[3], extent[4], extent[5]);
+	block->SetSpacing(vol.spacing);
+	block->SetOrigin(vol.origin);
+
+	size_t nx = extent[1] - extent[0] + 1, ny = extent[3] - extent[2] + 1, nz = extent[5] - extent[4] + 1;
+	size_t row = (size_t)vol.dims[0], section = row * vol.dims[1];
+	vtkSmartPointer<vtkFloatArray> scalars = vtkSmartPointer<vtkFloatArray>::New();
+	scalars->SetName("density");
+	const unsigned char *first = vol.data + ((size_t)extent[4] * section + (size_t)extent[2] * row + extent[0]) * vol.voxel_size;
+
+	if (vol.mode == 2 && !vol.swap && nx == row && ny == (size_t)vol.dims[1] && reinterpret_cast<uintptr_t>(first) % sizeof(float) == 0) {
+		// whole sections of native floats are contiguous: use the mapping as is (save = 1: never freed by VTK)
+		scalars->SetArray(const_cast<float *>(reinterpret_cast<const float *>(first)), nx * ny * nz, 1);
+	}
+	else {
+		scalars->SetNumberOfValues(nx * ny * nz);
+		float *out = scalars->GetPointer(0);
+		for (size_t k = 0; k < nz; k++)
+			for (size_t j = 0; j < ny; j++) {
+				const unsigned char *in = first + (k * section + j * row) * vol.voxel_size;
+				for (size_t i = 0; i < nx; i++, in += vol.voxel_size)
+					*out++ = voxel(vol, in);
+			}
+	}
+	block->GetPointData()->SetScalars(scalars);
+	return block;
+}
+
+// the smallest extent within extent holding every voxel for which inside(value) holds, grown by margin
+template <class T>
+static int extent_where(const struct volume& vol, const int extent[6], T inside, int margin, int above[6]) {
+	// x and y bounds of each section on all threads, then z from the sections that have any
+	int nz = extent[5] - extent[4] + 1;
+	vector<int> bounds(4 * nz);
+	size_t row = (size_t)vol.dims[0], section = row * vol.dims[1];
+	auto scan = [&](vtkIdType first, vtkIdType last) {
+		for (vtkIdType k = first; k < last; k++) {
+			int *b = &bounds[4 * k];
+			b[0] = b[2] = INT_MAX;
+			b[1] = b[3] = INT_MIN;
+			for (int j = extent[2]; j <= extent[3]; j++) {
+				const unsigned char *in = vol.data + (((size_t)extent[4] + k) * section + (size_t)j * row + extent[0]) * vol.voxel_size;
+				for (int i = extent[0]; i <= extent[1]; i++, in += vol.voxel_size)
+					if (inside(voxel(vol, in))) {
+						b[0] = min(b[0], i);
+						b[1] = max(b[1], i);
+						b[2] = min(b[2], j);
+						b[3] = max(b[3], j);
+					}
+			}
+		}
+	};
+	vtkSMPTools::For(0, nz, scan);
+
+	int found = 0;
+	for (int k = 0; k < nz; k++) {
+		const int *b = &bounds[4 * k];
+		if (b[0] > b[1])
+			continue;
+		if (!found) {
+			above[0] = b[0]; above[1] = b[1]; above[2] = b[2]; above[3] = b[3];
+			above[4] = above[5] = extent[4] + k;
+			found = 1;
+			continue;
+		}
+		above[0] = min(above[0], b[0]);
+		above[1] = max(above[1], b[1]);
+		above[2] = min(above[2], b[2]);
+		above[3] = max(above[3], b[3]);
+		above[5] = extent[4] + k;
+	}
+	if (!found)
+		return -1;
+	for (int a = 0; a < 3; a++) {
+		above[2 * a] = max(extent[2 * a], above[2 * a] - margin);
+		above[2 * a + 1] = min(extent[2 * a + 1], above[2 * a + 1] + margin);
+	}
+	return 0;
+}
+
+int volume_extent_above(const struct volume& vol, const int extent[6], float level, int margin, int above[6]) {
+	return extent_where(vol, extent, [level](float v) { return v > level; }, margin, above);
+}
+
+int volume_extent_nonzero(const struct volume& vol, const int extent[6], int margin, int nonzero[6]) {
+	return extent_where(vol, extent, [](float v) { return v != 0; }, margin, nonzero);
+}
+
+int volume_labels(const struct volume& vol, const int extent[6], size_t max_labels, vector<float>& labels) {
+	// the distinct values of each section on all threads; labels come in runs, so only a change of
+	// value is looked up
+	int nz = extent[5] - extent[4] + 1;
+	vector<set<float> > found(nz);
+	size_t row = (size_t)vol.dims[0], section = row * vol.dims[1];
+	auto scan = [&](vtkIdType first, vtkIdType last) {
+		for (vtkIdType k = first; k < last; k++) {
+			set<float>& values = found[k];
+			float previous = 0;
+			for (int j = extent[2]; j <= extent[3] && values.size() <= max_labels; j++) {
+				const unsigned char *in = vol.data + (((size_t)extent[4] + k) * section + (size_t)j * row + extent[0]) * vol.voxel_size;
+				for (int i = extent[0]; i <= extent[1]; i++, in += vol.voxel_size) {
+					float v = voxel(vol, in);
+					if (v != previous && v != 0 && v == v)
+						values.insert(v);
+					previous = v;
+				}
+			}
+		}
+	};
+	vtkSMPTools::For(0, nz, scan);
+
+	set<float> all;
+	for (int k = 0; k < nz && all.size() <= max_labels; k++)
+		all.insert(found[k].begin(), found[k].end());
+	if (all.size() > max_labels) {
+		cerr << "More than " << max_labels << " distinct labels in the map" << endl;
+		return -1;
+	}
+	labels.assign(all.begin(), all.end());
+	return 0;
+}
+
+void volume_ranges_build(const struct volume& vol, const int extent[6], int block, struct volume_ranges& ranges) {
+	ranges.block = block;
+	memcpy(ranges.extent, extent, sizeof(ranges.extent));
+	for (int a = 0; a < 3; a++)
+		ranges.nblocks[a] = max(1, (extent[2 * a + 1] - extent[2 * a] + block - 1) / block);
+	size_t nx = ranges.nblocks[0], nrows = (size_t)ranges.nblocks[1] * ranges.nblocks[2];
+	ranges.lo.assign(nx * nrows, numeric_limits<float>::max());
+	ranges.hi.assign(nx * nrows, -numeric_limits<float>::max());
+
+	// each task scans the voxels of one row of blocks along x; a voxel on the face between two
+	// blocks along x belongs to both (rows along y and z are scanned over their own extents, which
+	// share their faces the same way)
+	size_t row = (size_t)vol.dims[0], section = row * vol.dims[1];
+	auto scan = [&](vtkIdType first, vtkIdType last) {
+		for (vtkIdType r = first; r < last; r++) {
+			int b[6];
+			volume_ranges_block(ranges, 0, (int)(r % ranges.nblocks[1]), (int)(r / ranges.nblocks[1]), b);
+			float *lo = &ranges.lo[r * nx], *hi = &ranges.hi[r * nx];
+			for (int k = b[4]; k <= b[5]; k++)
+				for (int j = b[2]; j <= b[3]; j++) {
+					const unsigned char *in = vol.data + ((size_t)k * section + (size_t)j * row + extent[0]) * vol.voxel_size;
+					for (int i = extent[0]; i <= extent[1]; i++, in += vol.voxel_size) {
+						float v = voxel(vol, in);
+						// blocks first to last (at most two) span this voxel, as in volume_ranges_block
+						int offset = i - extent[0];
+						int last = min(offset / block, (int)nx - 1);
+						int first = offset > 0 && offset % block == 0 ? min(offset / block - 1, last) : last;
+						for (int bi = first; bi <= last; bi++) {
+							lo[bi] = min(lo[bi], v);
+							hi[bi] = max(hi[bi], v);
+						}
+					}
+				}
+		}
+	};
+	vtkSMPTools::For(0, (vtkIdType)nrows, scan);
+}
+
+void volume_ranges_block(const struct volume_ranges& ranges, int i, int j, int k, int extent[6]) {
+	int b[3] = {i, j, k};
+	for (int a = 0; a < 3; a++) {
+		extent[2 * a] = ranges.extent[2 * a] + b[a] * ranges.block;
+		// the last block takes whatever is left
+		extent[2 * a + 1] = b[a] == ranges.nblocks[a] - 1 ? ranges.extent[2 * a + 1] : extent[2 * a] + ranges.block;
+	}
+}
+
+int volume_ranges_straddle(const struct volume_ranges& ranges, const int extent[6], const vector<float>& levels) {
+	int first[3], last[3];
+	for (int a = 0; a < 3; a++) {
+		int lo = max(extent[2 * a], ranges.extent[2 * a]) - ranges.extent[2 * a];
+		int hi = min(extent[2 * a + 1], ranges.extent[2 * a + 1]) - ranges.extent[2 * a];
+		if (lo > hi)
+			return 0;
+		// the blocks of the cells from voxel lo to voxel hi (a block ends on the first voxel of the next)
+		first[a] = min(lo / ranges.block, ranges.nblocks[a] - 1);
+		last[a] = min(max(hi - 1, lo) / ranges.block, ranges.nblocks[a] - 1);
+	}
+	for (int k = first[2]; k <= last[2]; k++)
+		for (int j = first[1]; j <= last[1]; j++)
+			for (int i = first[0]; i <= last[0]; i++) {
+				size_t b = ((size_t)k * ranges.nblocks[1] + j) * ranges.nblocks[0] + i;
+				for (size_t l = 0; l < levels.size(); l++)
+					if (ranges.lo[b] <= levels[l] && levels[l] <= ranges.hi[b])
+						return 1;
+			}
+	return 0;
+}
+
+void volume_release(const struct volume& vol, int z0, int z1) {
+	if (vol.map_addr == NULL)
+		return;
+	// madvise works on whole pages inside the range
+	size_t page = sysconf(_SC_PAGESIZE);
+	size_t section = (size_t)vol.dims[0] * vol.dims[1] * vol.voxel_size;
+	uintptr_t start = reinterpret_cast<uintptr_t>(vol.data) + z0 * section;
+	uintptr_t end = reinterpret_cast<uintptr_t>(vol.data) + (z1 + 1) * section;
+	start = (start + page - 1) / page * page;
+	end = end / page * page;
+	if (end > start)
+		madvise(reinterpret_cast<void *>(start), end - start, MADV_DONTNEED);
+}
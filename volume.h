@@ -0,0 +1,84 @@
+/*
+ * volume
+ *
+ * Read-only view of the voxels of an MRC/CCP4 map, either memory-mapped
+ * from the file so that sub-volumes can be meshed without holding the whole
+ * map in memory, or borrowed from an image that has already been read
+ *
+ * License: Apache
+ */
+
+#ifndef MESHMAKER_VOLUME_H
+#define MESHMAKER_VOLUME_H
+
+// standard headers
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// VTK headers
+#include "vtkSmartPointer.h"
+#include "vtkImageData.h"
+
+struct volume {
+	int dims[3] = {0, 0, 0}; // voxels along x (columns), y (rows) and z (sections)
+	double spacing[3] = {1.0, 1.0, 1.0};
+	double origin[3] = {0.0, 0.0, 0.0};
+	int mode = 2; // MRC data mode of the voxels
+	int swap = 0; // voxels are in the opposite byte order to this machine
+	int unsigned_bytes = 0; // mode 0 voxels are 0..255 rather than -128..127
+	size_t voxel_size = 4; // bytes per voxel
+	const unsigned char *data = NULL; // first voxel
+	void *map_addr = NULL; // the mapping (NULL when not mapped)
+	size_t map_len = 0;
+	int fd = -1;
+};
+
+// the range of values in each block of a coarse grid over part of a volume, so that blocks that no
+// isosurface crosses can be skipped; adjacent blocks share their boundary voxels
+struct volume_ranges {
+	int block = 0; // voxels along each edge of a block
+	int extent[6] = {0, 0, 0, 0, 0, 0}; // of the volume covered by the grid
+	int nblocks[3] = {0, 0, 0};
+	std::vector<float> lo, hi; // minimum and maximum of each block, x fastest
+};
+
+// map the MRC/CCP4 file fn into vol; returns 0 on success, otherwise prints the reason and returns -1
+int volume_map(struct volume& vol, const std::string& fn);
+
+// view the scalars of an in-memory image (e.g. from vtkMRCReader) through vol without copying them;
+// returns 0 on success, otherwise prints the reason and returns -1
+int volume_wrap(struct volume& vol, vtkImageData *image);
+
+// unmap the file (if mapped)
+void volume_unmap(struct volume& vol);
+
+// copy the voxels within extent (inclusive, as for vtkImageData::SetExtent) into a float image;
+// a block of whole native float32 sections refers to the mapping directly instead
+vtkSmartPointer<vtkImageData> volume_block(const struct volume& vol, const int extent[6]);
+
+// the smallest extent within extent (inclusive) holding every voxel above level, grown by margin
+// voxels on each side (within extent); returns 0, or -1 if no voxel is above level
+int volume_extent_above(const struct volume& vol, const int extent[6], float level, int margin, int above[6]);
+
+// as volume_extent_above(), for the voxels that are not zero (e.g. of any label of a label map)
+int volume_extent_nonzero(const struct volume& vol, const int extent[6], int margin, int nonzero[6]);
+
+// the distinct values other than zero (and NaN) of the voxels within extent (inclusive) in ascending
+// order, on all threads; returns 0, otherwise (more than max_labels of them) prints the reason and
+// returns -1
+int volume_labels(const struct volume& vol, const int extent[6], size_t max_labels, std::vector<float>& labels);
+
+// build the value ranges of blocks of block voxels along each edge over extent (inclusive) on all threads
+void volume_ranges_build(const struct volume& vol, const int extent[6], int block, struct volume_ranges& ranges);
+
+// the extent (inclusive) of block (i, j, k) of ranges
+void volume_ranges_block(const struct volume_ranges& ranges, int i, int j, int k, int extent[6]);
+
+// whether any of levels lies within the values of the blocks that overlap extent (inclusive)
+int volume_ranges_straddle(const struct volume_ranges& ranges, const int extent[6], const std::vector<float>& levels);
+
+// let the kernel reclaim the pages of sections z0 to z1 (inclusive) once they have been meshed
+void volume_release(const struct volume& vol, int z0, int z1);
+
+#endif
@@ -0,0 +1,448 @@
+/*
+ * vtp_writer
+ *
+ * Block-compressed VTP writer (see vtp_writer.h)
+ *
+ * License: Apache
+ */
+
+// standard headers
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+// VTK headers
+#include "vtkCellArray.h"
+#include "vtkCellData.h"
+#include "vtkDataArray.h"
+#include "vtkDataCompressor.h"
+#include "vtkFieldData.h"
+#include "vtkLZ4DataCompressor.h"
+#include "vtkLZMADataCompressor.h"
+#include "vtkPointData.h"
+#include "vtkPoints.h"
+#include "vtkSMPTools.h"
+#include "vtkSmartPointer.h"
+#include "vtkZLibDataCompressor.h"
+
+#include "vtp_writer.h"
+
+using namespace std;
+
+// one DataArray of the appended section
+struct vtp_array {
+	string name;
+	string type; // XML word type, e.g. Float32
+	int ncomp = 1;
+	vtkIdType ntuples = -1; // given for field data only
+	const unsigned char *data = NULL;
+	size_t nbytes = 0;
+	vector<unsigned char> copy; // data converted to the output type (if it had to be)
+	size_t first_block = 0, nblocks = 0;
+	uint64_t offset = 0; // in the appended section
+};
+
+static int host_is_little_endian(void) {
+	uint16_t one = 1;
+	return *reinterpret_cast<unsigned char *>(&one) == 1;
+}
+
+// the XML word type of a VTK data type (NULL if it cannot be written)
+static const char *word_type(int type, int size) {
+	switch (type) {
+		case VTK_FLOAT: return "Float32";
+		case VTK_DOUBLE: return "Float64";
+		case VTK_CHAR:
+		case VTK_SIGNED_CHAR: return "Int8";
+		case VTK_UNSIGNED_CHAR: return "UInt8";
+		case VTK_SHORT: return "Int16";
+		case VTK_UNSIGNED_SHORT: return "UInt16";
+		case VTK_INT: return "Int32";
+		case VTK_UNSIGNED_INT: return "UInt32";
+		case VTK_LONG:
+		case VTK_LONG_LONG:
+		case VTK_ID_TYPE: return size == 8 ? "Int64" : "Int32";
+		case VTK_UNSIGNED_LONG:
+		case VTK_UNSIGNED_LONG_LONG: return size == 8 ? "UInt64" : "UInt32";
+		default: return NULL;
+	}
+}
+
+static string xml_escape(const string& s) {
+	string out;
+	for (size_t i = 0; i < s.size(); i++)
+		switch (s[i]) {
+			case '&': out += "&amp;"; break;
+			case '<': out += "&lt;"; break;
+			case '>': out += "&gt;"; break;
+			case '"': out += "&quot;"; break;
+			default: out += s[i];
+		}
+	return out;
+}
+
+static vtkSmartPointer<vtkDataCompressor> new_compressor(const struct vtp_options& opts) {
+	vtkSmartPointer<vtkDataCompressor> compressor;
+	if (opts.compressor.compare("lz4") == 0)
+		compressor = vtkSmartPointer<vtkLZ4DataCompressor>::New();
+	else if (opts.compressor.compare("lzma") == 0)
+		compressor = vtkSmartPointer<vtkLZMADataCompressor>::New();
+	else
+		compressor = vtkSmartPointer<vtkZLibDataCompressor>::New();
+	compressor->SetCompressionLevel(opts.level);
+	return compressor;
+}
+
+static const char *compressor_class(const struct vtp_options& opts) {
+	if (opts.compressor.compare("lz4") == 0)
+		return "vtkLZ4DataCompressor";
+	if (opts.compressor.compare("lzma") == 0)
+		return "vtkLZMADataCompressor";
+	return "vtkZLibDataCompressor";
+}
+
+// a data array as it is in memory
+static struct vtp_array data_array(vtkDataArray *array, const char *name) {
+	struct vtp_array a;
+	const char *type = word_type(array->GetDataType(), array->GetDataTypeSize());
+	a.name = name != NULL ? name : (array->GetName() != NULL ? array->GetName() : "");
+	a.type = type != NULL ? type : "";
+	a.ncomp = array->GetNumberOfComponents();
+	a.nbytes = (size_t)array->GetNumberOfTuples() * a.ncomp * array->GetDataTypeSize();
+	a.data = a.nbytes > 0 ? static_cast<const unsigned char *>(array->GetVoidPointer(0)) : NULL;
+	return a;
+}
+
+// ids (or offsets after the leading 0) of a cell array in the output id type, borrowed when the
+// storage already has that type
+template <typename T>
+static struct vtp_array id_array(const char *name, const T *ids, vtkIdType n, int int32) {
+	struct vtp_array a;
+	a.name = name;
+	a.type = int32 ? "Int32" : "Int64";
+	a.nbytes = (size_t)n * (int32 ? 4 : 8);
+	if (a.nbytes == 0)
+		return a;
+	if (sizeof(T) == (int32 ? 4u : 8u)) {
+		a.data = reinterpret_cast<const unsigned char *>(ids);
+		return a;
+	}
+	a.copy.resize(a.nbytes);
+	unsigned char *out = &a.copy[0];
+	auto convert = [&](vtkIdType first, vtkIdType last) {
+		for (vtkIdType i = first; i < last; i++)
+			if (int32) {
+				int32_t v = (int32_t)ids[i];
+				memcpy(out + 4 * i, &v, 4);
+			}
+			else {
+				int64_t v = (int64_t)ids[i];
+				memcpy(out + 8 * i, &v, 8);
+			}
+	};
+	vtkSMPTools::For(0, n, convert);
+	a.data = out;
+	return a;
+}
+
+// connectivity and offsets of a cell array
+static void cell_arrays(vtkCellArray *cells, int int32, vector<struct vtp_array>& arrays) {
+	vtkIdType ncells = cells != NULL ? cells->GetNumberOfCells() : 0;
+	if (ncells == 0) {
+		arrays.push_back(id_array<vtkTypeInt64>("connectivity", NULL, 0, int32));
+		arrays.push_back(id_array<vtkTypeInt64>("offsets", NULL, 0, int32));
+	}
+	else if (cells->IsStorage64Bit()) {
+		const vtkTypeInt64 *offsets = cells->GetOffsetsArray64()->GetPointer(0);
+		arrays.push_back(id_array("connectivity", cells->GetConnectivityArray64()->GetPointer(0), offsets[ncells], int32));
+		arrays.push_back(id_array("offsets", offsets + 1, ncells, int32));
+	}
+	else {
+		const vtkTypeInt32 *offsets = cells->GetOffsetsArray32()->GetPointer(0);
+		arrays.push_back(id_array("connectivity", cells->GetConnectivityArray32()->GetPointer(0), offsets[ncells], int32));
+		arrays.push_back(id_array("offsets", offsets + 1, ncells, int32));
+	}
+}
+
+// the arrays of point or cell data that can be written, with the Scalars/Normals attributes
+static string attribute_arrays(vtkDataSetAttributes *data, vector<struct vtp_array>& arrays, vector<size_t>& indices) {
+	ostringstream attributes;
+	for (int i = 0; i < data->GetNumberOfArrays(); i++) {
+		vtkDataArray *array = data->GetArray(i);
+		if (array == NULL || word_type(array->GetDataType(), array->GetDataTypeSize()) == NULL)
+			continue;
+		indices.push_back(arrays.size());
+		arrays.push_back(data_array(array, NULL));
+		if (array == data->GetScalars() && array->GetName() != NULL)
+			attributes << " Scalars=\"" << xml_escape(array->GetName()) << "\"";
+		if (array == data->GetNormals() && array->GetName() != NULL)
+			attributes << " Normals=\"" << xml_escape(array->GetName()) << "\"";
+	}
+	return attributes.str();
+}
+
+// the data arrays of field data, which have no attributes
+static void field_arrays(vtkFieldData *data, vector<struct vtp_array>& arrays, vector<size_t>& indices) {
+	for (int i = 0; data != NULL && i < data->GetNumberOfArrays(); i++) {
+		vtkDataArray *array = data->GetArray(i);
+		if (array == NULL || word_type(array->GetDataType(), array->GetDataTypeSize()) == NULL)
+			continue;
+		indices.push_back(arrays.size());
+		arrays.push_back(data_array(array, NULL));
+		arrays.back().ntuples = array->GetNumberOfTuples();
+	}
+}
+
+static void array_element(ostream& xml, const struct vtp_array& a, const char *indent) {
+	xml << indent << "<DataArray type=\"" << a.type << "\" Name=\"" << xml_escape(a.name) << "\"";
+	if (a.ncomp != 1)
+		xml << " NumberOfComponents=\"" << a.ncomp << "\"";
+	if (a.ntuples >= 0)
+		xml << " NumberOfTuples=\"" << a.ntuples << "\"";
+	xml << " format=\"appended\" offset=\"" << a.offset << "\"/>\n";
+}
+
+int vtp_write(vtkPolyData *mesh, const string& fn, const struct vtp_options& opts) {
+	FILE *out = fopen(fn.c_str(), "wb");
+	if (out == NULL) {
+		cerr << "Unable to write '" << fn << "': " << strerror(errno) << endl;
+		return -1;
+	}
+	int failed = vtp_write(mesh, out, fn, opts);
+	if (fclose(out) != 0 && !failed) {
+		cerr << "Unable to write '" << fn << "': " << strerror(errno) << endl;
+		failed = -1;
+	}
+	return failed;
+}
+
+int vtp_write(vtkPolyData *mesh, FILE *out, const string& name, const struct vtp_options& opts) {
+	// in file order: field data, point data, cell data, points, then connectivity/offsets of verts, lines,
+	// strips and polys
+	vector<struct vtp_array> arrays;
+	vector<size_t> field_data, point_data, cell_data;
+	field_arrays(mesh->GetFieldData(), arrays, field_data);
+	string point_attributes = attribute_arrays(mesh->GetPointData(), arrays, point_data);
+	string cell_attributes = attribute_arrays(mesh->GetCellData(), arrays, cell_data);
+	size_t points = arrays.size();
+	if (mesh->GetPoints() != NULL)
+		arrays.push_back(data_array(mesh->GetPoints()->GetData(), "Points"));
+	else {
+		struct vtp_array none;
+		none.name = "Points";
+		none.type = "Float32";
+		none.ncomp = 3;
+		arrays.push_back(none);
+	}
+	size_t cells = arrays.size();
+	vtkCellArray *topology[4] = { mesh->GetVerts(), mesh->GetLines(), mesh->GetStrips(), mesh->GetPolys() };
+	for (int t = 0; t < 4; t++)
+		cell_arrays(topology[t], opts.int32, arrays);
+
+	// every block of every array is compressed independently
+	int compress = opts.compressor.compare("none") != 0;
+	struct block {
+		const unsigned char *data;
+		size_t size;
+	};
+	vector<struct block> blocks;
+	for (size_t i = 0; i < arrays.size(); i++) {
+		struct vtp_array& a = arrays[i];
+		if (!a.copy.empty())
+			a.data = &a.copy[0];
+		a.first_block = blocks.size();
+		for (size_t at = 0; compress && at < a.nbytes; at += opts.block_size) {
+			struct block b = { a.data + at, min(opts.block_size, a.nbytes - at) };
+			blocks.push_back(b);
+		}
+		a.nblocks = blocks.size() - a.first_block;
+	}
+	vector<vector<unsigned char> > compressed(blocks.size());
+	auto compress_blocks = [&](vtkIdType first, vtkIdType last) {
+		vtkSmartPointer<vtkDataCompressor> compressor = new_compressor(opts);
+		for (vtkIdType b = first; b < last; b++) {
+			vector<unsigned char>& out = compressed[b];
+			out.resize(compressor->GetMaximumCompressionSpace(blocks[b].size));
+			size_t size = compressor->Compress(blocks[b].data, blocks[b].size, &out[0], out.size());
+			out.resize(size);
+		}
+	};
+	vtkSMPTools::For(0, (vtkIdType)blocks.size(), compress_blocks);
+	for (size_t b = 0; b < blocks.size(); b++)
+		if (compressed[b].empty()) {
+			cerr << "Unable to compress '" << name << "' with " << opts.compressor << endl;
+			return -1;
+		}
+
+	// compressed arrays are a header of block count, block size, last partial block size and
+	// compressed block sizes followed by the blocks; raw arrays are their byte count followed by
+	// the data. With alignment, the data of raw arrays (or the headers of compressed ones) start
+	// at multiples of align in the file
+	size_t word = opts.uint64 ? 8 : 4;
+	size_t align = opts.align > 1 ? opts.align : 1;
+	uint64_t offset = 0;
+	for (size_t i = 0; i < arrays.size(); i++) {
+		struct vtp_array& a = arrays[i];
+		size_t lead = compress ? 0 : word;
+		a.offset = (offset + lead + align - 1) / align * align - lead;
+		offset = a.offset + (compress ? (3 + a.nblocks) * word : word + a.nbytes);
+		for (size_t b = a.first_block; b < a.first_block + a.nblocks; b++)
+			offset += compressed[b].size();
+		if (!opts.uint64 && (compress ? a.nblocks : a.nbytes) > UINT32_MAX) {
+			cerr << "Array '" << a.name << "' is too large for UInt32 headers in '" << name << "' (use UInt64 headers)" << endl;
+			return -1;
+		}
+	}
+
+	ostringstream xml;
+	xml << "<?xml version=\"1.0\"?>\n"
+		<< "<VTKFile type=\"PolyData\" version=\"1.0\" byte_order=\"" << (host_is_little_endian() ? "LittleEndian" : "BigEndian")
+		<< "\" header_type=\"" << (opts.uint64 ? "UInt64" : "UInt32") << "\"";
+	if (compress)
+		xml << " compressor=\"" << compressor_class(opts) << "\"";
+	xml << ">\n"
+		<< "  <PolyData>\n";
+	if (!field_data.empty()) {
+		xml << "    <FieldData>\n";
+		for (size_t i = 0; i < field_data.size(); i++)
+			array_element(xml, arrays[field_data[i]], "      ");
+		xml << "    </FieldData>\n";
+	}
+	xml << "    <Piece NumberOfPoints=\"" << mesh->GetNumberOfPoints()
+		<< "\" NumberOfVerts=\"" << mesh->GetNumberOfVerts()
+		<< "\" NumberOfLines=\"" << mesh->GetNumberOfLines()
+		<< "\" NumberOfStrips=\"" << mesh->GetNumberOfStrips()
+		<< "\" NumberOfPolys=\"" << mesh->GetNumberOfPolys() << "\">\n";
+	xml << "      <PointData" << point_attributes << ">\n";
+	for (size_t i = 0; i < point_data.size(); i++)
+		array_element(xml, arrays[point_data[i]], "        ");
+	xml << "      </PointData>\n      <CellData" << cell_attributes << ">\n";
+	for (size_t i = 0; i < cell_data.size(); i++)
+		array_element(xml, arrays[cell_data[i]], "        ");
+	xml << "      </CellData>\n      <Points>\n";
+	array_element(xml, arrays[points], "        ");
+	xml << "      </Points>\n";
+	const char *names[4] = { "Verts", "Lines", "Strips", "Polys" };
+	for (int t = 0; t < 4; t++) {
+		xml << "      <" << names[t] << ">\n";
+		array_element(xml, arrays[cells + 2 * t], "        ");
+		array_element(xml, arrays[cells + 2 * t + 1], "        ");
+		xml << "      </" << names[t] << ">\n";
+	}
+	xml << "    </Piece>\n  </PolyData>\n  <AppendedData encoding=\"raw\">\n   ";
+	// the appended data starts after the '_' so that is aligned too
+	while ((xml.tellp() + (streamoff)1) % align != 0)
+		xml << " ";
+	xml << "_";
+
+	// everything is written in order so that out can be a pipe
+	int failed = 0;
+	auto put = [&failed, out](const void *data, size_t n) {
+		if (!failed && n > 0)
+			failed = fwrite(data, 1, n, out) != n;
+	};
+	string head = xml.str();
+	put(head.data(), head.size());
+	vector<unsigned char> header;
+	uint64_t at = 0;
+	for (size_t i = 0; i < arrays.size() && !failed; i++) {
+		const struct vtp_array& a = arrays[i];
+		if (a.offset > at) {
+			header.assign(a.offset - at, 0);
+			put(&header[0], header.size());
+		}
+		size_t nwords = compress ? 3 + a.nblocks : 1;
+		uint64_t words[3] = { compress ? a.nblocks : a.nbytes, opts.block_size, a.nbytes % opts.block_size };
+		header.resize(nwords * word);
+		for (size_t w = 0; w < nwords; w++) {
+			uint64_t v = w < 3 ? words[w] : compressed[a.first_block + w - 3].size();
+			if (opts.uint64)
+				memcpy(&header[w * word], &v, 8);
+			else {
+				uint32_t v32 = (uint32_t)v;
+				memcpy(&header[w * word], &v32, 4);
+			}
+		}
+		put(&header[0], header.size());
+		at = a.offset + header.size();
+		// raw arrays go straight from the mesh
+		if (!compress)
+			put(a.data, a.nbytes);
+		at += compress ? 0 : a.nbytes;
+		for (size_t b = a.first_block; b < a.first_block + a.nblocks; b++) {
+			put(compressed[b].empty() ? NULL : &compressed[b][0], compressed[b].size());
+			at += compressed[b].size();
+		}
+	}
+	const char *tail = "\n  </AppendedData>\n</VTKFile>\n";
+	put(tail, strlen(tail));
+	if (failed || fflush(out) != 0) {
+		cerr << "Unable to write '" << name << "': " << strerror(errno) << endl;
+		return -1;
+	}
+	return 0;
+}
+
+// the PDataArray of each array of data that can be written, within element
+static void summary_arrays(ostream& xml, vtkDataSetAttributes *data, const char *element) {
+	ostringstream attributes, arrays;
+	for (int i = 0; i < data->GetNumberOfArrays(); i++) {
+		vtkDataArray *array = data->GetArray(i);
+		const char *type = array != NULL ? word_type(array->GetDataType(), array->GetDataTypeSize()) : NULL;
+		if (type == NULL)
+			continue;
+		string name = array->GetName() != NULL ? array->GetName() : "";
+		arrays << "    <PDataArray type=\"" << type << "\" Name=\"" << xml_escape(name) << "\"";
+		if (array->GetNumberOfComponents() != 1)
+			arrays << " NumberOfComponents=\"" << array->GetNumberOfComponents() << "\"";
+		arrays << "/>\n";
+		if (array == data->GetScalars() && array->GetName() != NULL)
+			attributes << " Scalars=\"" << xml_escape(name) << "\"";
+		if (array == data->GetNormals() && array->GetName() != NULL)
+			attributes << " Normals=\"" << xml_escape(name) << "\"";
+	}
+	xml << "    <" << element << attributes.str() << ">\n" << arrays.str() << "    </" << element << ">\n";
+}
+
+string pvtp_arrays(vtkPolyData *mesh) {
+	if (mesh == NULL || mesh->GetNumberOfPoints() == 0)
+		return "";
+	ostringstream xml;
+	summary_arrays(xml, mesh->GetPointData(), "PPointData");
+	summary_arrays(xml, mesh->GetCellData(), "PCellData");
+	vtkDataArray *points = mesh->GetPoints()->GetData();
+	const char *type = word_type(points->GetDataType(), points->GetDataTypeSize());
+	xml << "    <PPoints>\n      <PDataArray type=\"" << (type != NULL ? type : "Float32") << "\" Name=\"Points\" NumberOfComponents=\"3\"/>\n    </PPoints>\n";
+	return xml.str();
+}
+
+int pvtp_write(const string& fn, const vector<string>& pieces, const string& arrays) {
+	ostringstream xml;
+	xml << "<?xml version=\"1.0\"?>\n"
+		<< "<VTKFile type=\"PPolyData\" version=\"1.0\" byte_order=\"" << (host_is_little_endian() ? "LittleEndian" : "BigEndian") << "\">\n"
+		<< "  <PPolyData GhostLevel=\"0\">\n";
+	if (arrays.empty())
+		xml << "    <PPoints>\n      <PDataArray type=\"Float32\" Name=\"Points\" NumberOfComponents=\"3\"/>\n    </PPoints>\n";
+	else
+		xml << arrays;
+	for (size_t p = 0; p < pieces.size(); p++)
+		xml << "    <Piece Source=\"" << xml_escape(pieces[p]) << "\"/>\n";
+	xml << "  </PPolyData>\n</VTKFile>\n";
+	string text = xml.str();
+	FILE *out = fopen(fn.c_str(), "wb");
+	if (out == NULL) {
+		cerr << "Unable to write '" << fn << "': " << strerror(errno) << endl;
+		return -1;
+	}
+	int failed = fwrite(text.data(), 1, text.size(), out) != text.size();
+	if (fclose(out) != 0 || failed) {
+		cerr << "Unable to write '" << fn << "': " << strerror(errno) << endl;
+		return -1;
+	}
+	return 0;
+}
@@ -0,0 +1,52 @@
+/*
+ * vtp_writer
+ *
+ * VTK XML PolyData (.vtp) output with the arrays in a raw appended section,
+ * either written straight from the mesh or compressed in blocks by zlib, LZ4
+ * or LZMA on all threads at once
+ *
+ * License: Apache
+ */
+
+#ifndef MESHMAKER_VTP_WRITER_H
+#define MESHMAKER_VTP_WRITER_H
+
+// standard headers
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// VTK headers
+#include "vtkPolyData.h"
+
+struct vtp_options {
+	std::string compressor = "zlib"; // 'zlib', 'lz4', 'lzma' or 'none' (raw)
+	int level = 5; // compression level from 1 (fastest) to 9 (smallest)
+	size_t block_size = 32768; // bytes of uncompressed data per block
+	int uint64 = 0; // UInt64 rather than UInt32 array headers
+	int int32 = 0; // Int32 rather than Int64 connectivity and offsets
+	size_t align = 0; // start the data of each array at a multiple of this many bytes in the file (if > 1)
+};
+
+// write the points, cells, field data, point data and cell data of mesh to fn in the same layout as
+// vtkXMLPolyDataWriter in appended mode with the given compressor (any VTK reader since 6.1
+// reads it). Without a compressor the arrays are written from the mesh's own buffers (cell
+// arrays are converted only if their storage differs from the output id type). Returns 0 on
+// success, otherwise prints the reason and returns -1
+int vtp_write(vtkPolyData *mesh, const std::string& fn, const struct vtp_options& opts);
+
+// the same to the stream out, strictly in order (so out can be a pipe); out is flushed but left open and
+// name is only used in messages
+int vtp_write(vtkPolyData *mesh, FILE *out, const std::string& name, const struct vtp_options& opts);
+
+// the PPointData, PCellData and PPoints of a .pvtp whose pieces have the arrays of mesh (as written by
+// vtp_write() or vtkXMLPolyDataWriter), or an empty string if mesh has no points
+std::string pvtp_arrays(vtkPolyData *mesh);
+
+// write fn, a .pvtp of the VTP pieces (file names relative to fn's directory) with the arrays of
+// pvtp_arrays() (Float32 points alone if empty). Returns 0 on success, otherwise prints the reason and
+// returns -1
+int pvtp_write(const std::string& fn, const std::vector<std::string>& pieces, const std::string& arrays);
+
+#endif